@@ -0,0 +1,95 @@
+#include "BlockCache.hpp"
+
+#include "jit/X86Emitter.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace rvemu
+{
+    BlockCache::BlockCache(AddrType base, std::size_t size)
+      : base_(base), codePages_(((size - 1) >> PAGE_SHIFT) + 1, 0)
+    { }
+
+    TranslatedBlock *BlockCache::insert(std::unique_ptr<TranslatedBlock> block)
+    {
+        block->id              = nextId_++;
+        const std::size_t page = pageIndex(block->startPC);
+        codePages_[page]       = 1;
+
+        // A retranslation replaces the block, its pc is listed for the page already.
+        auto &slot = blocks_[block->startPC];
+        if (slot != nullptr)
+            drop(std::move(slot));
+        else
+            pageBlocks_[page].push_back(block->startPC);
+        slot = std::move(block);
+        return slot.get();
+    }
+
+    void BlockCache::link(BlockExit &exit, TranslatedBlock *target)
+    {
+        if (exit.linked != nullptr)
+            std::erase(exit.linked->incoming, &exit);
+
+        if (exit.kind == ExitKind::Indirect)
+            exit.target = target->startPC;
+        exit.linked = target;
+        target->incoming.push_back(&exit);
+    }
+
+    void BlockCache::unlinkExits(TranslatedBlock &block)
+    {
+        for (BlockExit &exit : block.exits)
+        {
+            if (exit.linked != nullptr)
+                std::erase(exit.linked->incoming, &exit);
+            exit.linked = nullptr;
+            exit.entry  = nullptr;
+        }
+    }
+
+    void BlockCache::drop(std::unique_ptr<TranslatedBlock> block)
+    {
+        unlinkExits(*block);
+
+        for (BlockExit *exit : block->incoming)
+        {
+            exit->linked = nullptr;
+            exit->entry  = nullptr;
+            if (exit->jump != nullptr)
+                X86Emitter::patch(exit->jump, exit->unchained);
+        }
+        block->incoming.clear();
+        dropped_.push_back(std::move(block));
+    }
+
+    void BlockCache::invalidatePages(std::size_t first, std::size_t last)
+    {
+        for (std::size_t page = first; page <= last && page < codePages_.size(); ++page)
+        {
+            if (!codePages_[page])
+                continue;
+
+            for (AddrType pc : pageBlocks_[page])
+            {
+                auto it = blocks_.find(pc);
+                if (it == blocks_.end())
+                    continue;
+                drop(std::move(it->second));
+                blocks_.erase(it);
+            }
+            pageBlocks_.erase(page);
+            codePages_[page] = 0;
+        }
+    }
+
+    void BlockCache::flush()
+    {
+        for (auto &[pc, block] : blocks_)
+            drop(std::move(block));
+        blocks_.clear();
+        pageBlocks_.clear();
+        codePages_.assign(codePages_.size(), 0);
+    }
+}    // namespace rvemu
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "Decoder.hpp"
+#include "RVEmu.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace rvemu
+{
+    class CPU;
+    struct JitContext;
+    struct ThreadedOp;
+    struct TranslatedBlock;
+
+    /// Handler of a translated instruction. It executes the op and jumps straight into the
+    /// handler of the following op, so a whole block runs without going back to a dispatch
+    /// loop. The value returned is the guest address execution continues at.
+    using ThreadedHandler = AddrType (*)(CPU &, const ThreadedOp *);
+
+    /// One translated instruction: the pre-bound handler with its operands baked in.
+    struct ThreadedOp
+    {
+        ThreadedHandler handler;
+        DecodedInst inst;
+        AddrType pc;
+    };
+
+    /// Entry point of a block compiled to host code by the JIT, returning the guest address
+    /// execution continues at.
+    using NativeBlock = AddrType (*)(JitContext *);
+
+    enum class ExitKind : u8 {
+        Direct,      // Fixed successor: jal, branch edges and falling off the block
+        Indirect,    // jalr, the link caches the last target
+        Return,      // Continuation after a call, reached through the return-address stack
+    };
+
+    /// An edge out of a block that can be chained to the block it leads to, so the next
+    /// transfer along it skips the block lookup. Compiled code reads target and entry.
+    struct BlockExit
+    {
+        ExitKind kind;
+        AddrType target;                      /// Successor address, the cached one if indirect.
+        TranslatedBlock *linked = nullptr;    /// Successor the exit is chained to.
+        const u8 *entry         = nullptr;    /// Host code of linked, for compiled code.
+        u8 *jump                = nullptr;    /// rel32 of the jump of a compiled direct exit.
+        const u8 *unchained     = nullptr;    /// Target of jump while the exit is not chained.
+    };
+
+    /// A translated basic block. The op array always ends with an exit op, so falling through
+    /// the last guest instruction leaves the block at its end address.
+    struct TranslatedBlock
+    {
+        /// Compiled code refers to exits by address, so exits is reserved up front.
+        static constexpr std::size_t MAX_EXITS = 2;
+
+        u64 id = 0;    /// Unique among the blocks a cache ever held.
+        AddrType startPC;
+        AddrType endPC;    /// Address past the last guest instruction of the block.
+        std::vector<ThreadedOp> ops;
+        NativeBlock native = nullptr;    /// Host code of the block, if the JIT compiled it.
+        /// Where chained compiled code enters the block, past the frame setup.
+        const u8 *chainEntry = nullptr;
+        /// Dispatches of the block, counted by the tiered engine until it is compiled.
+        u32 executions = 0;
+
+        std::vector<BlockExit> exits;
+        /// Exits of other blocks chained to this one, unchained when the block is dropped.
+        std::vector<BlockExit *> incoming;
+
+        /// Returns the exit leading to pc, or nullptr.
+        BlockExit *exitTo(AddrType pc)
+        {
+            for (BlockExit &exit : exits)
+            {
+                if (exit.kind == ExitKind::Indirect || exit.target == pc)
+                    return &exit;
+            }
+            return nullptr;
+        }
+    };
+
+    /// Translated blocks indexed by the address of their first instruction.
+    ///
+    /// A block never crosses a page, so the cache keeps one flag per page telling whether some
+    /// block was translated from it and a write to that page drops all of its blocks.
+    class BlockCache
+    {
+      public:
+        static constexpr u8 PAGE_SHIFT = 12;
+
+        /// @param base The lowest guest address that can hold code.
+        /// @param size The size in bytes of the cached address range.
+        BlockCache(AddrType base, std::size_t size);
+
+        /// Returns the block starting at pc, or nullptr if it was not translated yet.
+        TranslatedBlock *lookup(AddrType pc)
+        {
+            auto it = blocks_.find(pc);
+            return it != blocks_.end() ? it->second.get() : nullptr;
+        }
+
+        /// Takes ownership of a freshly translated block.
+        TranslatedBlock *insert(std::unique_ptr<TranslatedBlock> block);
+
+        /// Chains an exit to the block it led to. An indirect exit forgets its previous target.
+        /// Compiled code is patched by the caller, dropping target undoes both.
+        void link(BlockExit &exit, TranslatedBlock *target);
+
+        /// Unchains the exits of a block, before they are replaced.
+        void unlinkExits(TranslatedBlock &block);
+
+        /// Drops every block translated from the pages the written range touches.
+        /// @param addr The first written address.
+        /// @param size The number of written bytes.
+        /// @return True if some page held blocks.
+        bool invalidate(AddrType addr, DataSizeType size)
+        {
+            const std::size_t first = pageIndex(addr);
+            const std::size_t last  = pageIndex(addr + size - 1);
+            if ((first < codePages_.size() && codePages_[first])
+                || (last < codePages_.size() && codePages_[last]))
+            {
+                invalidatePages(first, last);
+                return true;
+            }
+            return false;
+        }
+
+        /// One byte per page, non-zero when some block was translated from the page. Translated
+        /// code checks it before writing to memory directly.
+        const u8 *codePageMap() const { return codePages_.data(); }
+
+        /// Drops every block.
+        void flush();
+
+        /// Whether a block was dropped since the last call to releaseDropped(). A running block
+        /// checks it after each store so it stops executing code that may have been rewritten.
+        bool hasDropped() const { return !dropped_.empty(); }
+
+        /// Frees the dropped blocks. Must only be called while no block is running.
+        void releaseDropped() { dropped_.clear(); }
+
+      private:
+        std::size_t pageIndex(AddrType addr) const { return (addr - base_) >> PAGE_SHIFT; }
+
+        void invalidatePages(std::size_t first, std::size_t last);
+
+        /// Unchains a block from its neighbours and moves it to the dropped list.
+        void drop(std::unique_ptr<TranslatedBlock> block);
+
+        /// Guest address of the first page.
+        AddrType base_;
+
+        /// Blocks by start address.
+        std::unordered_map<AddrType, std::unique_ptr<TranslatedBlock>> blocks_;
+
+        /// Pages some block was translated from.
+        std::vector<u8> codePages_;
+
+        /// Start addresses of the blocks translated from each code page.
+        std::unordered_map<std::size_t, std::vector<AddrType>> pageBlocks_;
+
+        /// Invalidated blocks, freed once no block is running.
+        std::vector<std::unique_ptr<TranslatedBlock>> dropped_;
+
+        /// Id of the next inserted block.
+        u64 nextId_ = 1;
+    };
+}    // namespace rvemu
@@ -0,0 +1,264 @@
+#include "BlockOptimizer.hpp"
+
+#include "Interpreter.hpp"
+
+#include <array>
+
+namespace rvemu
+{
+    namespace
+    {
+        using enum InstKind;
+
+        constexpr bool isBranch(InstKind kind) { return kind >= Beq && kind <= Bgeu; }
+        constexpr bool isImmOp(InstKind kind) { return kind >= Addi && kind <= Sraiw; }
+        constexpr bool isRegOp(InstKind kind) { return kind >= Add && kind <= Sraw; }
+
+        /// Writes of a constant, which read no register.
+        constexpr bool isConstant(InstKind kind)
+        {
+            return kind == Lui || kind == Auipc || kind == LuiAddi || kind == AuipcAddi;
+        }
+
+        /// Instructions whose only effect is writing rd.
+        constexpr bool isPure(InstKind kind)
+        {
+            return isConstant(kind) || isImmOp(kind) || isRegOp(kind) || kind == ZextW;
+        }
+
+        /// The immediate form of a register-register instruction, or Illegal.
+        constexpr InstKind immediateForm(InstKind kind)
+        {
+            switch (kind)
+            {
+                case Add:  return Addi;
+                case Slt:  return Slti;
+                case Sltu: return Sltiu;
+                case Xor:  return Xori;
+                case Or:   return Ori;
+                case And:  return Andi;
+                case Sll:  return Slli;
+                case Srl:  return Srli;
+                case Sra:  return Srai;
+                case Addw: return Addiw;
+                case Sllw: return Slliw;
+                case Srlw: return Srliw;
+                case Sraw: return Sraiw;
+
+                default: return Illegal;
+            }
+        }
+
+        constexpr bool isShift(InstKind kind)
+        {
+            return kind == Sll || kind == Srl || kind == Sra || kind == Sllw || kind == Srlw
+                   || kind == Sraw;
+        }
+
+        constexpr bool commutes(InstKind kind)
+        {
+            return kind == Add || kind == Xor || kind == Or || kind == And || kind == Addw;
+        }
+
+        /// Whether a value fits the 12-bit immediate of an I-type instruction.
+        constexpr bool fitsImm12(i64 value) { return value >= -2048 && value <= 2047; }
+
+        constexpr bool fitsInt32(i64 value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+        /// What a register is known to hold at some point of the block.
+        struct Value
+        {
+            enum class Kind : u8 {
+                Unknown,
+                Constant,    // value
+                Offset,      // base + value
+            };
+
+            Kind kind              = Kind::Unknown;
+            u8 base                = 0;
+            RegisterSizeType value = 0;
+
+            bool isConstant() const { return kind == Kind::Constant; }
+        };
+
+        /// The values of all the registers, x0 being the constant 0.
+        class ValueTable
+        {
+          public:
+            ValueTable() { values_[0] = {Value::Kind::Constant}; }
+
+            const Value &operator[] (u8 reg) const { return values_[reg]; }
+
+            /// Records a write to a register, forgetting the values based on its old content.
+            void write(u8 reg, const Value &value)
+            {
+                if (reg == 0)
+                    return;
+                for (Value &other : values_)
+                {
+                    if (other.kind == Value::Kind::Offset && other.base == reg)
+                        other = {};
+                }
+                values_[reg] = value.kind == Value::Kind::Offset && value.base == reg ? Value {}
+                                                                                      : value;
+            }
+
+            void writeConstant(u8 reg, RegisterSizeType value)
+            {
+                write(reg, {Value::Kind::Constant, 0, value});
+            }
+
+          private:
+            std::array<Value, RegistersNumber> values_ {};
+        };
+
+        /// Turns an instruction into rd = value.
+        void makeConstant(DecodedInst &inst, RegisterSizeType value)
+        {
+            // A fused pair stays one, covering both of its words.
+            inst = {isFused(inst.kind) ? LuiAddi : Lui, inst.rd, 0, 0, inst.raw, value};
+        }
+
+        /// Replaces a register operand by an immediate if the instruction has such a form.
+        void useImmediate(DecodedInst &inst, const ValueTable &values)
+        {
+            const Value &lhs = values[inst.rs1];
+            const Value &rhs = values[inst.rs2];
+
+            if (rhs.isConstant() && (inst.kind == Sub || inst.kind == Subw)
+                && fitsImm12(-static_cast<i64>(rhs.value)))
+            {
+                inst.kind = inst.kind == Sub ? Addi : Addiw;
+                inst.imm  = -rhs.value;
+            }
+            else if (rhs.isConstant() && immediateForm(inst.kind) != Illegal
+                     && (isShift(inst.kind) || fitsImm12(static_cast<i64>(rhs.value))))
+            {
+                const bool word = inst.kind == Sllw || inst.kind == Srlw || inst.kind == Sraw;
+                inst.imm  = isShift(inst.kind) ? rhs.value & (word ? 0x1f : 0x3f) : rhs.value;
+                inst.kind = immediateForm(inst.kind);
+            }
+            else if (lhs.isConstant() && commutes(inst.kind)
+                     && fitsImm12(static_cast<i64>(lhs.value)))
+            {
+                inst.kind = immediateForm(inst.kind);
+                inst.rs1  = inst.rs2;
+                inst.imm  = lhs.value;
+            }
+            else
+                return;
+            inst.rs2 = 0;
+        }
+    }    // namespace
+
+    void BlockOptimizer::optimize(std::vector<ThreadedOp> &ops)
+    {
+        propagateConstants(ops);
+        removeDeadWrites(ops);
+    }
+
+    void BlockOptimizer::propagateConstants(std::vector<ThreadedOp> &ops)
+    {
+        ValueTable values;
+        for (ThreadedOp &op : ops)
+        {
+            DecodedInst &inst = op.inst;
+            if (isRegOp(inst.kind))
+            {
+                if (values[inst.rs1].isConstant() && values[inst.rs2].isConstant())
+                    makeConstant(inst,
+                                 Interpreter::compute(
+                                     inst.kind, values[inst.rs1].value, values[inst.rs2].value));
+                else
+                    useImmediate(inst, values);
+            }
+
+            const Value base = values[inst.rs1];
+            if (inst.kind == LuiAddi)
+                makeConstant(inst, inst.imm);
+            else if (inst.kind == Auipc || inst.kind == AuipcAddi)
+                makeConstant(inst, op.pc + inst.imm);
+            else if ((isImmOp(inst.kind) || inst.kind == ZextW) && base.isConstant())
+                makeConstant(inst, Interpreter::compute(inst.kind, base.value, inst.imm));
+            else if (inst.kind == Addi || isLoad(inst.kind) || isStore(inst.kind))
+            {
+                // Address folding: use what the base register was computed from.
+                const RegisterSizeType offset = base.value + inst.imm;
+                if (base.isConstant() && inst.kind != Addi)
+                {
+                    inst.rs1 = 0;
+                    inst.imm = offset;
+                }
+                else if (base.kind == Value::Kind::Offset
+                         && (inst.kind == Addi ? fitsImm12(static_cast<i64>(offset))
+                                               : fitsInt32(static_cast<i64>(offset))))
+                {
+                    inst.rs1 = base.base;
+                    inst.imm = offset;
+                }
+            }
+            else if (isBranch(inst.kind) && base.isConstant() && values[inst.rs2].isConstant())
+            {
+                if (Interpreter::branchTaken(inst.kind, base.value, values[inst.rs2].value))
+                    inst = {Jal, 0, 0, 0, inst.raw, inst.imm};
+                else
+                    inst = {Addi, 0, 0, 0, inst.raw, 0};    // A nop, removed below.
+            }
+            else if (inst.kind == Jalr && base.isConstant())
+            {
+                const AddrType target = (base.value + inst.imm) & ~1ULL;
+                inst                  = {Jal, inst.rd, 0, 0, inst.raw, target - op.pc};
+            }
+
+            if (inst.kind == Lui || inst.kind == LuiAddi)
+                values.writeConstant(inst.rd, inst.imm);
+            else if (inst.kind == Jal)
+                values.writeConstant(inst.rd, op.pc + DataSizeType::Word);
+            else if (inst.kind == Addi)
+                values.write(inst.rd, {Value::Kind::Offset, inst.rs1, inst.imm});
+            else if (writesRd(inst.kind))
+                values.write(inst.rd, {});
+            if (inst.kind == AuipcJalr)
+                values.write(inst.rs1, {});
+        }
+    }
+
+    void BlockOptimizer::removeDeadWrites(std::vector<ThreadedOp> &ops)
+    {
+        constexpr u32 ALL_LIVE = ~0U;
+
+        // Registers whose value may still be read, walking the block backwards.
+        u32 live = ALL_LIVE;
+        std::vector<bool> dead(ops.size());
+        for (std::size_t i = ops.size(); i-- > 0;)
+        {
+            const DecodedInst &inst = ops[i].inst;
+            if (!isPure(inst.kind))
+            {
+                live = ALL_LIVE;
+                continue;
+            }
+
+            const u32 written = 1U << inst.rd;
+            if (inst.rd == 0 || (live & written) == 0)
+            {
+                dead[i] = true;
+                continue;
+            }
+
+            live &= ~written;
+            if (!isConstant(inst.kind))
+                live |= 1U << inst.rs1;
+            if (isRegOp(inst.kind))
+                live |= 1U << inst.rs2;
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < ops.size(); ++i)
+        {
+            if (!dead[i])
+                ops[kept++] = ops[i];
+        }
+        ops.resize(kept);
+    }
+}    // namespace rvemu
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "BlockCache.hpp"
+#include "RVEmu.hpp"
+
+#include <vector>
+
+namespace rvemu
+{
+    /// Rewrites the instructions of a basic block before it is translated, the threaded ops
+    /// and the compiled code of the JIT both execute the rewritten block.
+    ///
+    /// The forward pass gives every register an abstract value, valid until the register is
+    /// written again, like an SSA name within the block: unknown, a constant or another
+    /// register plus an offset. With it:
+    /// - lui, auipc and integer instructions whose operands are all known become a lui of
+    ///   the full 64-bit result, and a register-register instruction with one known operand
+    ///   its immediate form when the constant fits;
+    /// - a load or store whose base is known, or is another register plus an offset, takes
+    ///   the address from the constant or that register directly, and an addi of such a
+    ///   register is rebased the same way;
+    /// - a branch with known operands becomes a jal or disappears, a jalr with a known
+    ///   target becomes a jal, so the block gets a direct exit.
+    ///
+    /// The backward pass then removes the instructions without side effects whose result
+    /// is overwritten before being read, writes to x0 included. Every register is live at
+    /// the end of the block and before any instruction that may trap, leave the block early
+    /// or run in the interpreter instead (loads, stores, system instructions), so an
+    /// interrupted block always leaves the registers the original code would have.
+    ///
+    /// Ops keep the address of the instruction they come from, so removed ones simply leave
+    /// a gap in the addresses.
+    class BlockOptimizer
+    {
+      public:
+        /// Optimizes the ops of a block, whose handlers are not bound yet.
+        static void optimize(std::vector<ThreadedOp> &ops);
+
+      private:
+        static void propagateConstants(std::vector<ThreadedOp> &ops);
+        static void removeDeadWrites(std::vector<ThreadedOp> &ops);
+    };
+}    // namespace rvemu
@@ -2,7 +2,11 @@
 
 #include "BitsManipulation.hpp"
 #include "Csr.hpp"
+#include "Decoder.hpp"
+#include "Interpreter.hpp"
 #include "RVEmu.hpp"
+#include "ThreadedEngine.hpp"
+#include "TieredEngine.hpp"
 #include "instructions/Branch.hpp"
 #include "instructions/Fence.hpp"
 #include "instructions/Iformat.hpp"
@@ -13,20 +17,112 @@
 #include "instructions/Store.hpp"
 #include "instructions/System.hpp"
 #include "instructions/Uformat.hpp"
+#include "devices/Clint.hpp"
+#include "devices/Plic.hpp"
+#include "devices/Uart.hpp"
+#include "devices/VirtioBlk.hpp"
+#include "jit/JitEngine.hpp"
+#include "trace/TraceBuffer.hpp"
 
 #include <algorithm>
 #include <fmt/core.h>
+#include <iostream>
 #include <iterator>
 #include <memory>
 
 namespace rvemu
 {
-    CPU::CPU(const std::string &fileName) : pc_(DRAM_BASE), bus_ {fileName}
+    namespace
     {
-        lastInstAddr_ = bus_.getLastInstr();
+        constexpr u8 accessSize(InstKind kind)
+        {
+            switch (kind)
+            {
+                case InstKind::Lb:
+                case InstKind::Lbu:
+                case InstKind::Sb:  return Byte;
+                case InstKind::Lh:
+                case InstKind::Lhu:
+                case InstKind::Sh:  return HalfWord;
+                case InstKind::Lw:
+                case InstKind::Lwu:
+                case InstKind::Sw:  return Word;
+                default:            return DoubleWord;
+            }
+        }
+
+        constexpr TraceAccess atomicAccess(InstKind kind)
+        {
+            using enum InstKind;
+            if (kind == LrW || kind == LrD)
+                return TraceAccess::Load;
+            return kind == ScW || kind == ScD ? TraceAccess::Store : TraceAccess::Atomic;
+        }
+
+        AddrType stackTop(std::size_t dramSize, u64 hartId)
+        {
+            if (hartId >= dramSize / HART_STACK_SIZE)
+            {
+                std::cerr << "No stack for hart " << hartId << " in " << dramSize
+                          << " bytes of DRAM\n";
+                abort();
+            }
+            return DRAM_BASE + dramSize - 1 - hartId * HART_STACK_SIZE;
+        }
+    }    // namespace
+
+    CPU::CPU(const std::string &fileName, const RamConfig &ram)
+      : registers_ {DRAM_BASE + ram.size - 1}, pc_(DRAM_BASE), hartId_(0),
+        bus_ {std::make_shared<SystemInterface>(fileName, ram)}, mmu_ {bus_->getDRAM()},
+        decodeCache_ {DRAM_BASE, ram.size}, blockCache_ {DRAM_BASE, ram.size},
+        engine_ {ExecEngine::Interpreter}
+    {
+        pc_           = bus_->getEntry();
+        lastInstAddr_ = bus_->getLastInstr();
         mode_         = Machine;
+
+        events_    = std::make_shared<EventQueue>(TimeMode::Instructions, csrs_.getLines());
+        auto clint = std::make_unique<Clint>(*events_, csrs_.getLines());
+        clint_     = clint.get();
+        bus_->mapDevice(CLINT_BASE, CLINT_SIZE, std::move(clint));
+
+        auto plic = std::make_unique<Plic>(csrs_.getLines());
+        auto uart = std::make_unique<Uart>(*events_, *plic, UART_IRQ);
+        plic_     = plic.get();
+        uart_     = uart.get();
+        bus_->mapDevice(PLIC_BASE, PLIC_SIZE, std::move(plic));
+        bus_->mapDevice(UART_BASE, UART_SIZE, std::move(uart));
+    }
+
+    CPU::CPU(CPU &boot, u64 hartId)
+      : registers_ {stackTop(boot.getDRAM().size(), hartId)}, pc_(boot.bus_->getEntry()),
+        lastInstAddr_(boot.lastInstAddr_), hartId_(hartId), bus_(boot.bus_),
+        mmu_ {bus_->getDRAM()}, mode_(Machine), decodeCache_ {DRAM_BASE, bus_->getDRAM().size()},
+        blockCache_ {DRAM_BASE, bus_->getDRAM().size()}, engine_(boot.engine_),
+        tierConfig_(boot.tierConfig_), events_(boot.events_), clint_(boot.clint_),
+        plic_(boot.plic_), uart_(boot.uart_), disk_(boot.disk_)
+    {
+        csrs_.write(MHARTID, hartId);
+        registers_.write(A0, hartId);
+        clint_->addHart(csrs_.getLines());
+        events_->watch(csrs_.getLines());
     }
 
+    CPU::~CPU() = default;
+
+    void CPU::attachDisk(const DiskConfig &config)
+    {
+        DRAM &dram = bus_->getDRAM();
+        auto disk  = std::make_unique<VirtioBlk>(
+            dram.data(), dram.size(), std::make_unique<DiskImage>(config), *plic_, VIRTIO_IRQ);
+        disk_ = disk.get();
+        bus_->mapDevice(VIRTIO_BASE, VIRTIO_SIZE, std::move(disk));
+    }
+
+    CPU::CPU(CPU &&) = default;
+
+    CPU &CPU::operator= (CPU &&) = default;
+
     std::optional<u64> CPU::getRegValueByName(const std::string &name)
     {
         auto it = std::find(Registers::RVABI.cbegin(), Registers::RVABI.cend(), name);
@@ -43,9 +139,280 @@ namespace rvemu
         return std::nullopt;
     }
 
-    void CPU::steps()
+    StopReason CPU::run(u64 maxInstructions) { return runUntil(NO_STOP_PC, maxInstructions); }
+
+    StopReason CPU::runUntil(AddrType pc, u64 maxInstructions)
+    {
+        stopPC_    = pc;
+        budgetEnd_ = maxInstructions < NO_LIMIT - retired_ ? retired_ + maxInstructions : NO_LIMIT;
+
+        // Instruction time is that of the only hart.
+        StopReason reason = StopReason::Exception;
+        if (hartId_ == 0)
+            events_->attach(&retired_);
+        try
+        {
+            reason = runEngine();
+        }
+        catch (const char *exc)
+        {
+            std::cout << "Exception in execute stage: " << exc << std::endl;
+        }
+        if (hartId_ == 0)
+            events_->detach();
+        uart_->flush();
+
+        if (trace_ != nullptr)
+            trace_->publish();
+        stopPC_    = NO_STOP_PC;
+        budgetEnd_ = NO_LIMIT;
+        runEnd_    = NO_LIMIT;
+        return reason;
+    }
+
+    StopReason CPU::runEngine()
+    {
+        for (;;)
+        {
+            if (retired_ >= eventCheck_)
+                events_->runDue();
+
+            if (csrs_.getEpoch() != epoch_)
+            {
+                epoch_ = csrs_.getEpoch();
+                if (csrs_.getLines().takeStop())
+                    return StopReason::Stopped;
+                mmu_.configure(csrs_.read(SATP), csrs_.read(MSTATUS), mode_);
+                if (takeInterrupt())
+                    continue;
+            }
+
+            eventCheck_ = events_->nextCheck(retired_);
+            runEnd_     = std::min(budgetEnd_, eventCheck_);
+
+            const StopReason reason = runSelected();
+            if (reason == StopReason::Exception
+                || (csrs_.getEpoch() == epoch_ && retired_ < eventCheck_))
+                return reason;
+        }
+    }
+
+    bool CPU::takeInterrupt()
+    {
+        const u64 pending = csrs_.read(MIP) & csrs_.read(MIE);
+        if (pending == 0)
+            return false;
+
+        // Interrupts left to machine mode are masked by MIE in machine mode only, delegated
+        // ones by SIE in supervisor mode, and never taken in machine mode.
+        const u64 mstatus   = csrs_.read(MSTATUS);
+        const u64 delegated = csrs_.read(MIDELEG);
+        u64 enabled         = 0;
+        if (mode_ < Machine || (mstatus & MASK_MIE))
+            enabled |= pending & ~delegated;
+        if (mode_ < Supervisor || (mode_ == Supervisor && (mstatus & MASK_SIE)))
+            enabled |= pending & delegated;
+
+        // By priority: external, software then timer interrupts, machine ones first.
+        for (u64 cause : {11, 3, 7, 9, 1, 5})
+        {
+            if (enabled & (1ULL << cause))
+            {
+                trapInterrupt(cause, (delegated >> cause) & 1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void CPU::trapInterrupt(u64 cause, bool delegated)
+    {
+        constexpr u64 INTERRUPT = 1ULL << 63;
+
+        // A vectored trap vector (mode 1) has an entry per cause.
+        auto handler = [cause](u64 tvec) {
+            return (tvec & ~0b11ULL) + ((tvec & 0b11) == 1 ? 4 * cause : 0);
+        };
+
+        if (delegated)
+        {
+            u64 sstatus = csrs_.read(SSTATUS);
+            sstatus     = (sstatus & ~(MASK_SPIE | MASK_SPP | MASK_SIE))
+                      | ((sstatus & MASK_SIE) << 4) | (mode_ << 8);
+            csrs_.write(SEPC, pc_);
+            csrs_.write(SCAUSE, INTERRUPT | cause);
+            csrs_.write(STVAL, 0);
+            csrs_.write(SSTATUS, sstatus);
+            setMode(Supervisor);
+            pc_ = handler(csrs_.read(STVEC));
+        }
+        else
+        {
+            u64 mstatus = csrs_.read(MSTATUS);
+            mstatus     = (mstatus & ~(MASK_MPIE | MASK_MPP | MASK_MIE))
+                      | ((mstatus & MASK_MIE) << 4) | (mode_ << 11);
+            csrs_.write(MEPC, pc_);
+            csrs_.write(MCAUSE, INTERRUPT | cause);
+            csrs_.write(MTVAL, 0);
+            csrs_.write(MSTATUS, mstatus);
+            setMode(Machine);
+            pc_ = handler(csrs_.read(MTVEC));
+        }
+    }
+
+    void CPU::waitForInterrupt()
+    {
+        // A pending interrupt ends the wait even if mstatus masks it. The epoch comes first, a
+        // line raised after the check moves it.
+        const u64 epoch = csrs_.getEpoch();
+        if ((csrs_.read(MIP) & csrs_.read(MIE)) != 0)
+            return;
+
+        // The next event, or the device work in flight, may raise a line. Without either wfi
+        // does nothing, as it may.
+        events_->idle(csrs_.getLines(), epoch);
+        events_->runDue();
+    }
+
+    StopReason CPU::runSelected()
+    {
+        if (trace_ != nullptr)
+        {
+            runRecorded();
+            return stopReason();
+        }
+
+        const bool paging = mmu_.translatesFetch() || mmu_.translatesData();
+        switch (paging ? ExecEngine::Interpreter : engine_)
+        {
+            case ExecEngine::Interpreter:
+                if (tracing_)
+                    runInterpreter<true>();
+                else
+                    runInterpreter<false>();
+                break;
+            case ExecEngine::Pipeline: return runPipeline();
+            case ExecEngine::Threaded: ThreadedEngine::run(*this); break;
+            case ExecEngine::Jit:
+                if (jit_ == nullptr)
+                    jit_ = std::make_unique<JitEngine>();
+                jit_->run(*this);
+                break;
+            case ExecEngine::Tiered:
+                if (tiered_ == nullptr)
+                    tiered_ = std::make_unique<TieredEngine>(tierConfig_);
+                tiered_->run(*this);
+                break;
+        }
+        return stopReason();
+    }
+
+    StopReason CPU::stopReason() const
+    {
+        if (checkEndProgram())
+            return StopReason::ProgramEnd;
+        if (pc_ == stopPC_)
+            return StopReason::StopPC;
+        return StopReason::Budget;
+    }
+
+    const DecodedInst &CPU::fetchDecoded()
+    {
+        // Pairs never cross a page, so the second instruction of one is at the next virtual
+        // address too.
+        if (mmu_.translatesFetch()) [[unlikely]]
+            return decodeAt(mmu_.translate<AccessType::Fetch>(pc_));
+        return decodeAt(pc_);
+    }
+
+    DecodedInst CPU::step()
+    {
+        DecodedInst inst = fetchDecoded();
+        if (isFused(inst.kind) && (getBudget() < 2 || stopPC_ == pc_ + Word))
+            inst = decodeInst(inst.raw);
+
+        pc_ = Interpreter::execute(*this, inst, pc_);
+        retired_ += instLength(inst.kind) / Word;
+        return inst;
+    }
+
+    template <bool Trace>
+    void CPU::runInterpreter()
+    {
+        while (!shouldStop())
+        {
+            step();
+            if constexpr (Trace)
+                dumpState();
+        }
+    }
+
+    void CPU::runRecorded()
+    {
+        while (!shouldStop())
+        {
+            DecodedInst inst = fetchDecoded();
+            if (isFused(inst.kind))
+                inst = decodeInst(inst.raw);
+
+            TraceRecord &record = trace_->reserve();
+            record              = {pc_, inst.raw, 0, TraceAccess::None, 0, 0, 0, 0};
+            if (isLoad(inst.kind) || isStore(inst.kind))
+            {
+                record.access  = isLoad(inst.kind) ? TraceAccess::Load : TraceAccess::Store;
+                record.size    = accessSize(inst.kind);
+                record.address = registers_.read(inst.rs1) + inst.imm;
+                if (isStore(inst.kind))
+                {
+                    const u64 bits = record.size * 8;
+                    record.value   = registers_.read(inst.rs2) & (~0ULL >> (64 - bits));
+                }
+            }
+            else if (isAtomic(inst.kind))
+            {
+                record.access  = atomicAccess(inst.kind);
+                record.size    = inst.kind >= InstKind::LrD ? DoubleWord : Word;
+                record.address = registers_.read(inst.rs1);
+                if (record.access == TraceAccess::Store)
+                {
+                    const u64 bits = record.size * 8;
+                    record.value   = registers_.read(inst.rs2) & (~0ULL >> (64 - bits));
+                }
+            }
+
+            const Reservation reserved = reservation_;
+            pc_                        = Interpreter::execute(*this, inst, pc_);
+            ++retired_;
+
+            // A failed sc stores nothing. One writing x0 keeps no flag: it stored if it held
+            // the reservation and memory holds its value, which it would have left unchanged.
+            if (isAtomic(inst.kind) && record.access == TraceAccess::Store)
+            {
+                const bool stored =
+                    inst.rd != Zero
+                        ? registers_.read(inst.rd) == 0
+                        : reserved.addr == record.address && reserved.size == record.size
+                              && (record.size == Word ? readMemory<u32>(record.address)
+                                                      : readMemory<u64>(record.address))
+                                     == record.value;
+                if (!stored)
+                    record.access = TraceAccess::None;
+            }
+            if (writesRd(inst.kind) && inst.rd != Zero && record.access != TraceAccess::Store)
+            {
+                record.rd    = inst.rd;
+                record.value = registers_.read(inst.rd);
+            }
+            trace_->commit();
+
+            if (tracing_)
+                dumpState();
+        }
+    }
+
+    StopReason CPU::runPipeline()
     {
-        while (!checkEndProgram())
+        while (!shouldStop())
         {
             u32 inst = fetch();
 
@@ -57,7 +424,7 @@ namespace rvemu
             catch (const char *dec_exc)
             {
                 std::cout << "Exception in decoding stage: " << dec_exc << "\n";
-                break;
+                return StopReason::Exception;
             }
             assert(instFormat != nullptr);
 
@@ -68,7 +435,7 @@ namespace rvemu
             catch (const char *exec_exc)
             {
                 std::cout << "Exception in execute stage: " << exec_exc << std::endl;
-                break;
+                return StopReason::Exception;
             }
 
             try
@@ -78,7 +445,7 @@ namespace rvemu
             catch (const char *mem_exc)
             {
                 std::cout << "Exception in memory stage: " << mem_exc << std::endl;
-                break;
+                return StopReason::Exception;
             }
 
             writeBack(instFormat);
@@ -89,16 +456,22 @@ namespace rvemu
             catch (char *const wb_exception)
             {
                 std::cout << "Exception in write back stage: " << wb_exception << std::endl;
-                break;
+                return StopReason::Exception;
             }
 
-            dumpRegisters();
-            dumpCSRs();
-            dumpPC();
+            ++retired_;
+            if (tracing_)
+                dumpState();
         }
+        return stopReason();
     }
 
-    AddrType CPU::fetch() { return bus_.readData(pc_, DataSizeType::Word); }
+    AddrType CPU::fetch()
+    {
+        if (pc_ % DataSizeType::Word != 0)
+            throw("Instruction address misaligned\n");
+        return bus_->read<u32>(pc_);
+    }
 
     std::unique_ptr<InstructionFormat> CPU::decode(const InstSizeType inst)
     {
@@ -120,6 +493,8 @@ namespace rvemu
             case OpcodeType::Op:      instFormat = std::make_unique<Op>(inst, pc_); break;
             case OpcodeType::Op64:    instFormat = std::make_unique<Op64>(inst, pc_); break;
             case OpcodeType::Fence:   instFormat = std::make_unique<Fence>(inst, pc_); break;
+            // The A extension only runs on decoded instructions.
+            case OpcodeType::Amo:     throw("Illegal instruction\n");
             case OpcodeType::System:  {
                 u8 func3 = BitsManipulation::takeBits(inst, 12, 14);
                 u8 func7 = BitsManipulation::takeBits(inst, 25, 31);
@@ -159,7 +534,7 @@ namespace rvemu
 
     void CPU::memoryAccess(const std::unique_ptr<InstructionFormat> &instFormat)
     {
-        instFormat->accessMemory(bus_);
+        instFormat->accessMemory(*bus_);
         instFormat->writeCsr(csrs_);
     }
 
@@ -212,7 +587,7 @@ namespace rvemu
     void CPU::dumpPC() const
     {
         fmt::print("{:-^100}\n", "PC");
-        fmt::print("PC = {:#x}\n", pc_);
+        fmt::print("PC = {}\n", bus_->getSymbols().describe(pc_));
         fmt::print("{:-^100}\n", "");
     }
 
@@ -1,40 +1,322 @@
 #pragma once
 
+#include "BlockCache.hpp"
 #include "Csr.hpp"
+#include "DecodeCache.hpp"
 #include "Memory.hpp"
+#include "Mmu.hpp"
 #include "RVEmu.hpp"
 #include "Registers.hpp"
+#include "TieredEngine.hpp"
+#include "devices/EventQueue.hpp"
 
+#include <atomic>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 
 namespace rvemu
 {
+    class Clint;
     class InstructionFormat;
+    class JitEngine;
+    class Plic;
+    class TraceBuffer;
+    class Uart;
+    class VirtioBlk;
+    struct DiskConfig;
+
+    // Engines run() can execute a program with.
+    enum class ExecEngine : u8 {
+        Interpreter,    // Decoded instructions, one at a time
+        Threaded,       // Translated basic blocks with threaded dispatch
+        Pipeline,       // InstructionFormat pipeline, kept as the reference implementation
+        Jit,            // Translated basic blocks compiled to host code
+        Tiered,         // Interpreter, threaded blocks or host code depending on hotness
+    };
+
+    // Why run() returned.
+    enum class StopReason : u8 {
+        ProgramEnd,    // The pc reached the end of the program
+        Budget,        // The instruction budget ran out
+        StopPC,        // The pc reached the address given to runUntil()
+        Exception,     // An instruction raised an exception
+        Stopped,       // requestStop() was called
+    };
 
     class CPU
     {
       public:
-        CPU(const std::string &programPath);
+        // Loads the program at the start of a DRAM backed as configured, as hart 0.
+        CPU(const std::string &programPath, const RamConfig &ram = {});
+
+        // Another hart of the machine boot runs on, before any of them runs: it shares the
+        // memory, the devices and the time of boot, and starts at the entry of the program
+        // with its id in mhartid and a0, and sp HART_STACK_SIZE * hartId below that of boot.
+        // Code caches and engines are its own, fence.i only drops those of the hart running it.
+        CPU(CPU &boot, u64 hartId);
+        ~CPU();
+
+        CPU(CPU &&);
+        CPU &operator= (CPU &&);
+
+        // No limit on the number of instructions a run may execute.
+        static constexpr u64 NO_LIMIT = std::numeric_limits<u64>::max();
+
+        // Executes the program with the selected engine until it ends, or until it executed
+        // maxInstructions instructions. A fused pair counts as its two instructions.
+        StopReason run(u64 maxInstructions = NO_LIMIT);
+
+        // Same as run(), also stopping before the instruction at pc is executed.
+        StopReason runUntil(AddrType pc, u64 maxInstructions = NO_LIMIT);
+
+        // Makes the current run return StopReason::Stopped at its next check, from any thread,
+        // waking the hart from wfi. If the hart does not run, its next run stops at once.
+        void requestStop() { csrs_.getLines().requestStop(); }
+
+        u64 getHartId() const { return hartId_; }
+
+        // Selects the engine used by run().
+        void setEngine(ExecEngine engine) { engine_ = engine; }
+
+        // Dumps the registers after every instruction, or every block for the block engines.
+        void setTracing(bool tracing) { tracing_ = tracing; }
+
+        bool isTracing() const { return tracing_; }
+
+        // Records every instruction in a binary trace, or stops recording if trace is nullptr.
+        // The interpreter runs the program while recording, whatever the engine, and executes
+        // fused pairs as their two instructions so each gets its record.
+        void setTraceBuffer(TraceBuffer *trace) { trace_ = trace; }
+
+        // Returns how many instructions were executed so far.
+        u64 getRetired() const { return retired_; }
+
+        // Returns how many fused pairs were executed so far, each counting two instructions
+        // in getRetired().
+        u64 getFusedRetired() const { return fusedRetired_; }
+
+        // Sets the promotion thresholds of the tiered engine, before it first runs.
+        void setTierConfig(const TierConfig &config) { tierConfig_ = config; }
 
-        // Executes the instruction pipeline steps until the program ends.
-        void steps();
+        // Returns what the tiered engine did, or nullptr if it never ran.
+        const TierStats *getTierStats() const
+        {
+            return tiered_ != nullptr ? &tiered_->getStats() : nullptr;
+        }
 
         // Checks if the program has reached its end by comparing the program counter with the
-        // last instruction address.
-        bool checkEndProgram() const { return pc_ >= lastInstAddr_; }
+        // last instruction address. A translated pc is no physical address, a program that
+        // enables paging only ends when it returns to untranslated code.
+        bool checkEndProgram() const { return pc_ >= lastInstAddr_ && !mmu_.translatesFetch(); }
+
+        // Checks if the current run must stop before the instruction at pc. Engines also stop
+        // when a device event is due and when the hart state changes (address translation
+        // settings, interrupts), so the run goes on after the hart dealt with it.
+        bool shouldStop() const
+        {
+            return checkEndProgram() || pc_ == stopPC_ || retired_ >= runEnd_
+                   || csrs_.getEpoch() != epoch_;
+        }
+
+        // Returns how many instructions the engine may still execute before it has to stop.
+        u64 getBudget() const { return runEnd_ - retired_; }
+
+        // Whether the current run stops somewhere else than at the end of the program or of its
+        // budget.
+        bool hasStopPC() const { return stopPC_ != NO_STOP_PC; }
+
+        // Checks if a whole block can run without going over the budget or past the stop pc.
+        bool canRunBlock(AddrType startPC, AddrType endPC) const
+        {
+            return (endPC - startPC) / Word <= getBudget()
+                   && (stopPC_ <= startPC || stopPC_ >= endPC);
+        }
+
+        // Counts instructions executed by an engine.
+        void retire(u64 count) { retired_ += count; }
+
+        // Counts fused pairs executed by an engine, on top of retire().
+        void retireFused(u64 count) { fusedRetired_ += count; }
+
+        // Executes the instruction at pc with the interpreter. Only the first instruction of a
+        // fused pair is executed if the second one is past the budget or at the stop pc.
+        // Returns the instruction executed.
+        DecodedInst step();
 
         // Retrieves the current instruction pointed to by the program counter.
         u32 getCurrInst() const { return pc_; }
 
+        AddrType getPC() const { return pc_; }
+
+        void setPC(AddrType pc) { pc_ = pc; }
+
+        AddrType getLastInstAddr() const { return lastInstAddr_; }
+
         // Returns a constant reference to the CPU registers.
         const Registers &getRegs() const { return registers_; }
 
+        // Returns a reference to the CPU registers.
+        Registers &getRegs() { return registers_; }
+
+        // Returns a reference to the Control and Status Registers.
+        CSRInterface &getCSRs() { return csrs_; }
+
         // Fetches the value of a register by its name.
         std::optional<u64> getRegValueByName(const std::string &name);
 
-        void setMode(Mode mode) { mode_ = mode; }
+        void setMode(Mode mode)
+        {
+            mode_ = mode;
+            csrs_.signalChange();
+        }
+
+        Mode getMode() const { return mode_; }
+
+        // Reads a value of the width of T from the memory through the system bus, translating
+        // addr first if paging is on.
+        template <MemoryValue T>
+        T readMemory(AddrType addr)
+        {
+            if (mmu_.translatesData()) [[unlikely]]
+                return mmu_.read<T>(addr, *bus_);
+            return bus_->read<T>(addr);
+        }
+
+        // Writes a value of the width of T to the memory through the system bus, translating
+        // addr first if paging is on, and drops any decoded instruction the write overlaps.
+        template <MemoryValue T>
+        void writeMemory(AddrType addr, T value)
+        {
+            constexpr auto size = static_cast<DataSizeType>(sizeof(T));
+            if (mmu_.translatesData()) [[unlikely]]
+            {
+                if (Mmu::crossesPage(addr, size))
+                {
+                    // Both pages must be writable before either is written.
+                    mmu_.translate<AccessType::Store>(addr + size - 1);
+                    for (u8 i = 0; i < size; ++i)
+                        writeMemory<u8>(addr + i, static_cast<u8>(value >> (8 * i)));
+                    return;
+                }
+                addr = mmu_.write<T>(addr, value, *bus_);
+            }
+            else
+                bus_->write<T>(addr, value);
+            dropCodeAt(addr, size);
+        }
+
+        // Returns the DRAM location of an atomic access of the width of T at addr, translated
+        // as a load or a store (lr, or sc and the AMOs). Other harts see the operations made
+        // on it whole; a store drops the code it overlaps, as writeMemory() does.
+        // @throws const char * if addr is misaligned, faults or is outside of DRAM.
+        template <MemoryValue T, AccessType A>
+        std::atomic_ref<T> atomicAt(AddrType addr)
+        {
+            constexpr auto size = static_cast<DataSizeType>(sizeof(T));
+            if (addr % size != 0)
+                throw(A == AccessType::Load ? "Load address misaligned\n"
+                                            : "Store/AMO address misaligned\n");
+            if (mmu_.translatesData()) [[unlikely]]
+                addr = mmu_.translate<A>(addr);
+
+            std::byte *host = bus_->getDRAM().find(addr, size);
+            if (host == nullptr)
+                throw("Memory access outside of the memory\n");
+            if constexpr (A == AccessType::Store)
+                dropCodeAt(addr, size);
+            return std::atomic_ref<T>(*reinterpret_cast<T *>(host));
+        }
+
+        // Loads the value of the width of T at addr and reserves it for a store-conditional
+        // (lr). Harts hold a reservation each, which remembers the value loaded.
+        template <MemoryValue T>
+        T loadReserved(AddrType addr, std::memory_order order)
+        {
+            const T value = atomicAt<T, AccessType::Load>(addr).load(order);
+            reservation_  = {addr, value, sizeof(T)};
+            return value;
+        }
+
+        // Stores value at addr if this hart reserved it and it still holds the value loaded
+        // then, dropping the reservation either way (sc). The check and the store are one
+        // compare-exchange, so harts never wait on each other: a store of another hart
+        // changing the value makes this one fail, one writing the same value back does not.
+        // @return Whether value was stored.
+        template <MemoryValue T>
+        bool storeConditional(AddrType addr, T value, std::memory_order order)
+        {
+            const Reservation reserved = std::exchange(reservation_, {});
+            if (reserved.addr != addr || reserved.size != sizeof(T))
+                return false;
+            T expected = static_cast<T>(reserved.value);
+            return atomicAt<T, AccessType::Store>(addr).compare_exchange_strong(
+                expected, value, order, std::memory_order_relaxed);
+        }
+
+        // Returns the decoded instruction at pc.
+        const DecodedInst &decodeAt(AddrType pc)
+        {
+            // Past the program a 0, which is illegal, so no pair is fused across its end.
+            return decodeCache_.lookup(pc, [this](AddrType addr) -> InstSizeType {
+                return addr < lastInstAddr_ ? bus_->read<u32>(addr) : 0;
+            });
+        }
+
+        // Drops every decoded and translated instruction (fence.i).
+        void flushCodeCaches()
+        {
+            decodeCache_.flush();
+            blockCache_.flush();
+        }
+
+        // Selects what the virtual time of the devices follows, before the first run. Several
+        // harts always follow the host clock.
+        void setTimeMode(TimeMode mode) { events_->setMode(mode); }
+
+        // Returns the device events and the virtual time.
+        const EventQueue &getEvents() const { return *events_; }
+
+        // Waits until an interrupt is pending (wfi), letting the time pass until the next
+        // device event if none is.
+        void waitForInterrupt();
+
+        // Returns the console UART.
+        Uart &getUart() { return *uart_; }
+
+        // Maps a virtio block device serving the disk, aborting if the disk cannot be mapped.
+        void attachDisk(const DiskConfig &config);
+
+        // Returns the block device, nullptr without a disk.
+        VirtioBlk *getDisk() { return disk_; }
+
+        // Drops every cached address translation (sfence.vma).
+        void flushTlb() { mmu_.flush(); }
+
+        // Returns how the TLBs did.
+        const TlbStats &getTlbStats() const { return mmu_.getStats(); }
+
+        BlockCache &getBlockCache() { return blockCache_; }
+
+        // Returns how many instructions of each kind were decoded, fused pairs included.
+        const InstMix &getInstMix() const { return decodeCache_.getMix(); }
+
+        DRAM &getDRAM() { return bus_->getDRAM(); }
+
+        // Maps a device over size bytes from base, aborting if the range overlaps DRAM or
+        // another device. Returns the device, owned by the bus.
+        Device &mapDevice(AddrType base, AddrType size, std::unique_ptr<Device> device)
+        {
+            return bus_->mapDevice(base, size, std::move(device));
+        }
+
+        // Returns the symbols of the program, for reports and traces.
+        const SymbolTable &getSymbols() const { return bus_->getSymbols(); }
+
+        // Returns the size of the program and how long loading it took.
+        const LoadStats &getLoadStats() const { return bus_->getLoadStats(); }
 
         // Prints the contents of the CPU registers.
         void dumpRegisters();
@@ -45,34 +327,111 @@ namespace rvemu
         // Prints the current value of the program counter.
         void dumpPC() const;
 
+        // Prints the registers, the CSRs and the pc.
+        void dumpState()
+        {
+            dumpRegisters();
+            dumpCSRs();
+            dumpPC();
+        }
+
       private:
-        // Enum to represent the various opcodes in the RISC-V instruction set.
-        enum class OpcodeType : u8 {
-            Lui     = 0b011'0111,    // Load upper immediate
-            Auipc   = 0b001'0111,    // Add upper immediate to pc
-            Jal     = 0b110'1111,    // Jump and link
-            Jalr    = 0b110'0111,    // Jump and link register
-            Branch  = 0b110'0011,    // Conditional branch
-            Load    = 0b000'0011,    // Load from memory
-            Store   = 0b010'0011,    // Store to memory
-            Immop   = 0b001'0011,    // Immediate arithmetic operation
-            Immop64 = 0b001'1011,    // Immediate arithmetic operation(RV64)
-            Op      = 0b011'0011,    // Register-register arithmetic operation
-            Op64    = 0b011'1011,    // Register-register arithmetic operation(RV64)
-            Fence   = 0b000'1111,    // Memory fence operation
-            System  = 0b111'0011     // System instructions
+        static constexpr AddrType NO_RESERVATION = std::numeric_limits<AddrType>::max();
+
+        // The address and the value an lr reserved, for the sc that follows.
+        struct Reservation
+        {
+            AddrType addr = NO_RESERVATION;
+            u64 value     = 0;    // The value loaded
+            u8 size       = 0;    // Width of the access in bytes
         };
 
+        // Drops the decoded instructions written by size bytes at the physical address addr.
+        // Pages that lose their blocks lose their decoded instructions too: translated code
+        // only checks for writes to pages holding blocks.
+        void dropCodeAt(AddrType addr, DataSizeType size)
+        {
+            decodeCache_.invalidate(addr, size);
+            if (blockCache_.invalidate(addr, size))
+                decodeCache_.flushPages(addr, size);
+        }
+
         Registers registers_;        // CPU registers
         AddrType pc_;                // Program counter
         AddrType lastInstAddr_;      // Address of the last instruction in the program
+        u64 hartId_;                 // mhartid
         CSRInterface csrs_;          // Control and Status Registers interface
-        SystemInterface bus_;        // System bus interface
+        std::shared_ptr<SystemInterface> bus_;    // System bus interface, shared by the harts
+        Mmu mmu_;                    // Sv39 translation of the addresses the program uses
         Mode mode_;                  // The current privilege mode
+        DecodeCache decodeCache_;    // Decoded instructions indexed by pc
+        BlockCache blockCache_;      // Translated blocks of the threaded engine
+        ExecEngine engine_;          // Engine used by run()
+        TierConfig tierConfig_;      // Thresholds of the tiered engine
+        bool tracing_         = false;      // Dump the state as instructions execute
+        TraceBuffer *trace_   = nullptr;    // Binary trace of the executed instructions
+        u64 retired_          = 0;          // Instructions executed so far
+        u64 fusedRetired_     = 0;          // Fused pairs executed so far
+        u64 epoch_            = 0;          // Epoch of the hart state the engines run with
+        Reservation reservation_;           // Of the last lr, dropped by any sc
+
+        static constexpr AddrType NO_STOP_PC = std::numeric_limits<AddrType>::max();
+
+        // Limits of the current run.
+        AddrType stopPC_ = NO_STOP_PC;
+        u64 budgetEnd_   = NO_LIMIT;
+        u64 eventCheck_  = 0;           // Retired count at which the due events run
+        u64 runEnd_      = NO_LIMIT;    // The engines stop there: budget end or event check
+
+        // Engines holding state of their own, created the first time they run.
+        std::unique_ptr<JitEngine> jit_;
+        std::unique_ptr<TieredEngine> tiered_;
+
+        // Device events in virtual time, shared by the harts.
+        std::shared_ptr<EventQueue> events_;
+
+        // Devices owned by the bus.
+        Clint *clint_    = nullptr;
+        Plic *plic_      = nullptr;
+        Uart *uart_      = nullptr;    // The console
+        VirtioBlk *disk_ = nullptr;    // Only with a disk attached
 
         // Sets the last instruction address of the program.
         void setLastInstAddr(const AddrType lastInst) { lastInstAddr_ = lastInst; }
 
+        // Runs the selected engines until the run has to stop. Between engine runs the due
+        // device events run, the MMU takes new translation settings and interrupts are taken.
+        StopReason runEngine();
+
+        // Takes the highest priority interrupt that is pending and enabled, if any.
+        // Returns whether one was taken.
+        bool takeInterrupt();
+
+        // Enters the trap handler of an interrupt in machine mode, or in supervisor mode if
+        // it is delegated.
+        void trapInterrupt(u64 cause, bool delegated);
+
+        // Runs the selected engine until it has to stop. Translation falls back to the
+        // interpreter: blocks and translated code are keyed by physical pc and access memory
+        // without translation.
+        StopReason runSelected();
+
+        // Returns the decoded instruction at pc, translating it first if paging is on.
+        const DecodedInst &fetchDecoded();
+
+        // Runs decoded instructions out of the decode cache one at a time.
+        template <bool Trace>
+        void runInterpreter();
+
+        // Runs the interpreter, recording each instruction in the binary trace.
+        void runRecorded();
+
+        // Runs the per-instruction InstructionFormat pipeline.
+        StopReason runPipeline();
+
+        // Why the engine stopped, when it did not raise an exception.
+        StopReason stopReason() const;
+
         // 5-stages pipeline methods:
         AddrType fetch();
         std::unique_ptr<InstructionFormat> decode(InstSizeType);
@@ -25,14 +25,34 @@ namespace rvemu
             case SIE:
                 csrs_[MIE] = (csrs_[MIE] & ~csrs_[MIDELEG]) | (what & csrs_[MIDELEG]);
                 break;
-            case SIP:
-                csrs_[MIP] = (csrs_[MIE] & ~csrs_[MIDELEG]) | (what & csrs_[MIDELEG]);
+            // A read-modify-write reads the raised lines back, they must not stick.
+            case MIP: csrs_[MIP] = what & ~MASK_LINES_IP; break;
+            case SIP: {
+                const u64 writable = csrs_[MIDELEG] & ~MASK_LINES_IP;
+                csrs_[MIP]         = (csrs_[MIP] & ~writable) | (what & writable);
                 break;
+            }
             case SSTATUS:
                 csrs_[MSTATUS] = (csrs_[MSTATUS] & ~MASK_SSTATUS) | (what & MASK_SSTATUS);
                 break;
             default: csrs_[dest] = what;
         }
+
+        // The MMU takes the new settings and pending interrupts are looked at before the next
+        // instruction.
+        switch (dest)
+        {
+            case SATP:
+            case MSTATUS:
+            case SSTATUS:
+            case MIE:
+            case SIE:
+            case MIP:
+            case SIP:
+            case MIDELEG: signalChange(); break;
+
+            default: break;
+        }
     }
 
     /**
@@ -48,7 +68,8 @@ namespace rvemu
         switch (where)
         {
             case SIE:     return csrs_[MIE] & csrs_[MIDELEG];
-            case SIP:     return csrs_[MIP] & csrs_[MIDELEG];
+            case MIP:     return csrs_[MIP] | lines_->pending();
+            case SIP:     return (csrs_[MIP] | lines_->pending()) & csrs_[MIDELEG];
             case SSTATUS: return csrs_[MSTATUS] & MASK_SSTATUS;
             default:      return csrs_[where];
         }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "RVEmu.hpp"
+#include "devices/InterruptLines.hpp"
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -10,11 +12,23 @@ namespace rvemu
     class CSRInterface
     {
       public:
-        CSRInterface() : csrs_ {0} { }
+        CSRInterface() : csrs_ {0}, lines_ {std::make_unique<InterruptLines>()} { }
 
         void write(AddrType, RegisterSizeType);
         RegisterSizeType read(AddrType) const;
 
+        // Changes whenever the hart has to look at its state again before going on: a CSR
+        // address translation or interrupts depend on is written, the privilege mode changes
+        // or a device drives an interrupt line.
+        u64 getEpoch() const { return lines_->getEpoch(); }
+
+        // Records a change of the hart state that is not a CSR write, like a mode change.
+        void signalChange() { lines_->notify(); }
+
+        // The interrupt lines devices drive, read as part of mip. They stay at the same
+        // address when the interface is moved.
+        InterruptLines &getLines() { return *lines_; }
+
         void dumpCSRs() const;
 
       public:
@@ -28,6 +42,7 @@ namespace rvemu
 
       private:
         std::array<CSRRegisterSizeType, NUM_CSRS> csrs_;
+        std::unique_ptr<InterruptLines> lines_;
     };
 
 }    // namespace rvemu
@@ -0,0 +1,47 @@
+#include "DecodeCache.hpp"
+
+namespace rvemu
+{
+    DecodeCache::DecodeCache(AddrType base, std::size_t size)
+      : base_(base), pages_((size + PAGE_SIZE - 1) / PAGE_SIZE)
+    { }
+
+    DecodedInst &DecodeCache::slotFor(AddrType pc)
+    {
+        // Without the C extension jumps to a pc that is 2 mod 4 fault, instead of running
+        // the slot of the aligned word.
+        if (pc % DataSizeType::Word != 0)
+            throw("Instruction address misaligned\n");
+
+        const AddrType offset = pc - base_;
+        const std::size_t idx = offset >> PAGE_SHIFT;
+        if (idx >= pages_.size())
+            throw("Instruction fetch outside of the memory\n");
+
+        auto &page = pages_[idx];
+        if (page == nullptr)
+            page = std::make_unique<Page>();
+
+        return (*page)[(offset % PAGE_SIZE) / DataSizeType::Word];
+    }
+
+    void DecodeCache::flushPages(AddrType addr, DataSizeType size)
+    {
+        const std::size_t first = (addr - base_) >> PAGE_SHIFT;
+        const std::size_t last  = (addr + size - 1 - base_) >> PAGE_SHIFT;
+        for (std::size_t idx = first; idx <= last && idx < pages_.size(); ++idx)
+        {
+            if (pages_[idx] != nullptr)
+                pages_[idx]->fill(DecodedInst {});
+        }
+    }
+
+    void DecodeCache::flush()
+    {
+        for (auto &page : pages_)
+        {
+            if (page != nullptr)
+                page->fill(DecodedInst {});
+        }
+    }
+}    // namespace rvemu
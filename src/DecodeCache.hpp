@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Decoder.hpp"
+#include "RVEmu.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace rvemu
+{
+    /// Number of decoded instructions of each kind.
+    using InstMix = std::array<u64, INST_KIND_COUNT>;
+
+    /// Per-page cache of decoded instructions indexed by guest PC.
+    ///
+    /// Pages are allocated the first time an instruction inside them is fetched, after that a
+    /// lookup is an index computation plus a load. Every slot holds the DecodedInst of the
+    /// 32-bit word at its address, or of the fused pair starting there, so a store only needs
+    /// to drop the slots it overlaps and the one before them. Pairs never cross a page.
+    class DecodeCache
+    {
+      public:
+        static constexpr u8 PAGE_SHIFT              = 12;
+        static constexpr std::size_t PAGE_SIZE      = 1 << PAGE_SHIFT;
+        static constexpr std::size_t INSTS_PER_PAGE = PAGE_SIZE / DataSizeType::Word;
+
+        /// @param base The lowest guest address that can hold code.
+        /// @param size The size in bytes of the cached address range.
+        DecodeCache(AddrType base, std::size_t size);
+
+        /// Returns the decoded instruction at pc, decoding it on a miss. A pc that is not word
+        /// aligned faults.
+        /// @param pc The address of the instruction.
+        /// @param fetch Callable returning the raw instruction at a given address, one that
+        /// decodes as illegal past the end of the code.
+        template <typename Fetch>
+        const DecodedInst &lookup(AddrType pc, Fetch &&fetch)
+        {
+            DecodedInst &slot = slotFor(pc);
+            if (slot.kind == InstKind::Undecoded)
+            {
+                slot = decodeInst(fetch(pc));
+                if (mayStartPair(slot.kind) && (pc - base_ + Word) % PAGE_SIZE != 0)
+                    slot = fuseInsts(slot, decodeInst(fetch(pc + Word)));
+                ++mix_[static_cast<std::size_t>(slot.kind)];
+            }
+            return slot;
+        }
+
+        /// Kinds of the instructions decoded so far, fused pairs counting as one.
+        const InstMix &getMix() const { return mix_; }
+
+        /// Drops every decoded instruction overlapping the written range.
+        /// @param addr The first written address.
+        /// @param size The number of written bytes.
+        void invalidate(AddrType addr, DataSizeType size)
+        {
+            // An unaligned doubleword spans three words.
+            for (AddrType word = addr & ~AddrType {Word - 1}; word < addr + size; word += Word)
+                invalidateSlot(word);
+        }
+
+        /// Drops every decoded instruction of the pages the written range touches.
+        /// @param addr The first written address.
+        /// @param size The number of written bytes.
+        void flushPages(AddrType addr, DataSizeType size);
+
+        /// Drops every decoded instruction, used by fence.i.
+        void flush();
+
+      private:
+        using Page = std::array<DecodedInst, INSTS_PER_PAGE>;
+
+        DecodedInst &slotFor(AddrType pc);
+
+        void invalidateSlot(AddrType addr)
+        {
+            const AddrType offset = addr - base_;
+            const std::size_t idx = offset >> PAGE_SHIFT;
+            if (idx >= pages_.size() || pages_[idx] == nullptr)
+                return;
+
+            Page &page            = *pages_[idx];
+            const std::size_t pos = (offset % PAGE_SIZE) / Word;
+            page[pos].kind        = InstKind::Undecoded;
+            // A pair starting at the previous word covers this one too.
+            if (pos > 0 && isFused(page[pos - 1].kind))
+                page[pos - 1].kind = InstKind::Undecoded;
+        }
+
+        AddrType base_;                               /// Guest address of the first page.
+        std::vector<std::unique_ptr<Page>> pages_;    /// Lazily allocated pages.
+        InstMix mix_ {};
+    };
+}    // namespace rvemu
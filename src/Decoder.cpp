@@ -0,0 +1,479 @@
+#include "Decoder.hpp"
+
+#include "RVEmu.hpp"
+
+#include <iterator>
+#include <limits>
+
+namespace rvemu
+{
+    namespace
+    {
+        using enum InstKind;
+
+        /// Bits [hi:lo] of an instruction.
+        template <unsigned Hi, unsigned Lo>
+        constexpr InstSizeType takeBits(InstSizeType inst)
+        {
+            static_assert(Hi >= Lo && Hi < 32, "bad bit range");
+            return (inst >> Lo) & (~0U >> (31 - Hi + Lo));
+        }
+
+        /// How the immediate of an instruction is encoded.
+        enum class ImmFormat : u8 {
+            None,
+            I,
+            S,
+            B,
+            U,
+            J,
+            Shamt6,    // shifts of RV64I
+            Shamt5,    // shifts of the 32-bit words
+            Csr,       // unsigned bits [31:20]
+        };
+
+        template <ImmFormat Format>
+        constexpr RegisterSizeType takeImm(InstSizeType inst)
+        {
+            using enum ImmFormat;
+
+            // Arithmetic shifts of the signed instruction spread bit 31 over the upper bits.
+            const auto sign = static_cast<i64>(static_cast<int32_t>(inst));
+            if constexpr (Format == None)
+                return 0;
+            else if constexpr (Format == I)
+                return sign >> 20;
+            else if constexpr (Format == S)
+                return (sign >> 20 & ~0x1fLL) | takeBits<11, 7>(inst);
+            else if constexpr (Format == B)
+                return (sign >> 19 & ~0xfffLL) | takeBits<7, 7>(inst) << 11
+                       | takeBits<30, 25>(inst) << 5 | takeBits<11, 8>(inst) << 1;
+            else if constexpr (Format == U)
+                return sign & ~0xfffLL;
+            else if constexpr (Format == J)
+                return (sign >> 11 & ~0xf'ffffLL) | takeBits<19, 12>(inst) << 12
+                       | takeBits<20, 20>(inst) << 11 | takeBits<30, 21>(inst) << 1;
+            else if constexpr (Format == Shamt6)
+                return takeBits<25, 20>(inst);
+            else if constexpr (Format == Shamt5)
+                return takeBits<24, 20>(inst);
+            else
+                return takeBits<31, 20>(inst);
+        }
+
+        /// One instruction of the table: an instruction belongs to it if the bits selected by
+        /// mask equal match.
+        struct Encoding
+        {
+            InstKind kind;
+            InstSizeType mask;
+            InstSizeType match;
+            RegisterSizeType (*takeImm)(InstSizeType);
+        };
+
+        constexpr InstSizeType OPCODE = 0x0000'007f;
+        constexpr InstSizeType FUNCT3 = 0x0000'707f;    // opcode and funct3
+        constexpr InstSizeType FUNCT6 = 0xfc00'707f;    // plus the upper bits of a 6-bit shamt
+        constexpr InstSizeType FUNCT7 = 0xfe00'707f;    // plus funct7
+        constexpr InstSizeType NO_RD  = 0xfe00'7fff;    // plus funct7 and rd
+        constexpr InstSizeType FUNCT5 = 0xf800'707f;    // funct3 and funct5, not aq and rl
+        constexpr InstSizeType NO_RS2 = 0xf9f0'707f;    // plus rs2
+        constexpr InstSizeType EXACT  = 0xffff'ffff;
+
+        constexpr InstSizeType fields(OpcodeType opcode, u32 funct3 = 0, u32 funct7 = 0)
+        {
+            return static_cast<u32>(opcode) | funct3 << 12 | funct7 << 25;
+        }
+
+        /// An instruction of the A extension, funct3 giving the width. The aq and rl bits
+        /// (26 and 25) only order the access, they are left out of the match.
+        constexpr InstSizeType atomic(u32 funct3, u32 funct5)
+        {
+            return fields(OpcodeType::Amo, funct3, funct5 << 2);
+        }
+
+        /// A system instruction without operands, told apart by bits [31:20].
+        constexpr InstSizeType system(u32 funct12)
+        {
+            return fields(OpcodeType::System) | funct12 << 20;
+        }
+
+        constexpr auto NoImm  = &takeImm<ImmFormat::None>;
+        constexpr auto ImmI   = &takeImm<ImmFormat::I>;
+        constexpr auto ImmS   = &takeImm<ImmFormat::S>;
+        constexpr auto ImmB   = &takeImm<ImmFormat::B>;
+        constexpr auto ImmU   = &takeImm<ImmFormat::U>;
+        constexpr auto ImmJ   = &takeImm<ImmFormat::J>;
+        constexpr auto Shamt6 = &takeImm<ImmFormat::Shamt6>;
+        constexpr auto Shamt5 = &takeImm<ImmFormat::Shamt5>;
+        constexpr auto Csr    = &takeImm<ImmFormat::Csr>;
+
+        /// Every instruction the decoder knows, supporting another one is adding it here.
+        constexpr Encoding ENCODINGS[] = {
+          // clang-format off
+          {Lui,       OPCODE, fields(OpcodeType::Lui),                          ImmU},
+          {Auipc,     OPCODE, fields(OpcodeType::Auipc),                        ImmU},
+          {Jal,       OPCODE, fields(OpcodeType::Jal),                          ImmJ},
+          {Jalr,      FUNCT3, fields(OpcodeType::Jalr, 0b000),                  ImmI},
+
+          {Beq,       FUNCT3, fields(OpcodeType::Branch, 0b000),                ImmB},
+          {Bne,       FUNCT3, fields(OpcodeType::Branch, 0b001),                ImmB},
+          {Blt,       FUNCT3, fields(OpcodeType::Branch, 0b100),                ImmB},
+          {Bge,       FUNCT3, fields(OpcodeType::Branch, 0b101),                ImmB},
+          {Bltu,      FUNCT3, fields(OpcodeType::Branch, 0b110),                ImmB},
+          {Bgeu,      FUNCT3, fields(OpcodeType::Branch, 0b111),                ImmB},
+
+          {Lb,        FUNCT3, fields(OpcodeType::Load, 0b000),                  ImmI},
+          {Lh,        FUNCT3, fields(OpcodeType::Load, 0b001),                  ImmI},
+          {Lw,        FUNCT3, fields(OpcodeType::Load, 0b010),                  ImmI},
+          {Ld,        FUNCT3, fields(OpcodeType::Load, 0b011),                  ImmI},
+          {Lbu,       FUNCT3, fields(OpcodeType::Load, 0b100),                  ImmI},
+          {Lhu,       FUNCT3, fields(OpcodeType::Load, 0b101),                  ImmI},
+          {Lwu,       FUNCT3, fields(OpcodeType::Load, 0b110),                  ImmI},
+
+          {Sb,        FUNCT3, fields(OpcodeType::Store, 0b000),                 ImmS},
+          {Sh,        FUNCT3, fields(OpcodeType::Store, 0b001),                 ImmS},
+          {Sw,        FUNCT3, fields(OpcodeType::Store, 0b010),                 ImmS},
+          {Sd,        FUNCT3, fields(OpcodeType::Store, 0b011),                 ImmS},
+
+          {Addi,      FUNCT3, fields(OpcodeType::Immop, 0b000),                 ImmI},
+          {Slti,      FUNCT3, fields(OpcodeType::Immop, 0b010),                 ImmI},
+          {Sltiu,     FUNCT3, fields(OpcodeType::Immop, 0b011),                 ImmI},
+          {Xori,      FUNCT3, fields(OpcodeType::Immop, 0b100),                 ImmI},
+          {Ori,       FUNCT3, fields(OpcodeType::Immop, 0b110),                 ImmI},
+          {Andi,      FUNCT3, fields(OpcodeType::Immop, 0b111),                 ImmI},
+          {Slli,      FUNCT6, fields(OpcodeType::Immop, 0b001, 0b0000000),      Shamt6},
+          {Srli,      FUNCT6, fields(OpcodeType::Immop, 0b101, 0b0000000),      Shamt6},
+          {Srai,      FUNCT6, fields(OpcodeType::Immop, 0b101, 0b0100000),      Shamt6},
+
+          {Addiw,     FUNCT3, fields(OpcodeType::Immop64, 0b000),               ImmI},
+          {Slliw,     FUNCT7, fields(OpcodeType::Immop64, 0b001, 0b0000000),    Shamt5},
+          {Srliw,     FUNCT7, fields(OpcodeType::Immop64, 0b101, 0b0000000),    Shamt5},
+          {Sraiw,     FUNCT7, fields(OpcodeType::Immop64, 0b101, 0b0100000),    Shamt5},
+
+          {Add,       FUNCT7, fields(OpcodeType::Op, 0b000, 0b0000000),         NoImm},
+          {Sub,       FUNCT7, fields(OpcodeType::Op, 0b000, 0b0100000),         NoImm},
+          {Sll,       FUNCT7, fields(OpcodeType::Op, 0b001, 0b0000000),         NoImm},
+          {Slt,       FUNCT7, fields(OpcodeType::Op, 0b010, 0b0000000),         NoImm},
+          {Sltu,      FUNCT7, fields(OpcodeType::Op, 0b011, 0b0000000),         NoImm},
+          {Xor,       FUNCT7, fields(OpcodeType::Op, 0b100, 0b0000000),         NoImm},
+          {Srl,       FUNCT7, fields(OpcodeType::Op, 0b101, 0b0000000),         NoImm},
+          {Sra,       FUNCT7, fields(OpcodeType::Op, 0b101, 0b0100000),         NoImm},
+          {Or,        FUNCT7, fields(OpcodeType::Op, 0b110, 0b0000000),         NoImm},
+          {And,       FUNCT7, fields(OpcodeType::Op, 0b111, 0b0000000),         NoImm},
+          {Mul,       FUNCT7, fields(OpcodeType::Op, 0b000, 0b0000001),         NoImm},
+
+          {Addw,      FUNCT7, fields(OpcodeType::Op64, 0b000, 0b0000000),       NoImm},
+          {Subw,      FUNCT7, fields(OpcodeType::Op64, 0b000, 0b0100000),       NoImm},
+          {Sllw,      FUNCT7, fields(OpcodeType::Op64, 0b001, 0b0000000),       NoImm},
+          {Srlw,      FUNCT7, fields(OpcodeType::Op64, 0b101, 0b0000000),       NoImm},
+          {Sraw,      FUNCT7, fields(OpcodeType::Op64, 0b101, 0b0100000),       NoImm},
+
+          {LrW,       NO_RS2, atomic(0b010, 0b00010),                           NoImm},
+          {ScW,       FUNCT5, atomic(0b010, 0b00011),                           NoImm},
+          {AmoswapW,  FUNCT5, atomic(0b010, 0b00001),                           NoImm},
+          {AmoaddW,   FUNCT5, atomic(0b010, 0b00000),                           NoImm},
+          {AmoxorW,   FUNCT5, atomic(0b010, 0b00100),                           NoImm},
+          {AmoandW,   FUNCT5, atomic(0b010, 0b01100),                           NoImm},
+          {AmoorW,    FUNCT5, atomic(0b010, 0b01000),                           NoImm},
+          {AmominW,   FUNCT5, atomic(0b010, 0b10000),                           NoImm},
+          {AmomaxW,   FUNCT5, atomic(0b010, 0b10100),                           NoImm},
+          {AmominuW,  FUNCT5, atomic(0b010, 0b11000),                           NoImm},
+          {AmomaxuW,  FUNCT5, atomic(0b010, 0b11100),                           NoImm},
+
+          {LrD,       NO_RS2, atomic(0b011, 0b00010),                           NoImm},
+          {ScD,       FUNCT5, atomic(0b011, 0b00011),                           NoImm},
+          {AmoswapD,  FUNCT5, atomic(0b011, 0b00001),                           NoImm},
+          {AmoaddD,   FUNCT5, atomic(0b011, 0b00000),                           NoImm},
+          {AmoxorD,   FUNCT5, atomic(0b011, 0b00100),                           NoImm},
+          {AmoandD,   FUNCT5, atomic(0b011, 0b01100),                           NoImm},
+          {AmoorD,    FUNCT5, atomic(0b011, 0b01000),                           NoImm},
+          {AmominD,   FUNCT5, atomic(0b011, 0b10000),                           NoImm},
+          {AmomaxD,   FUNCT5, atomic(0b011, 0b10100),                           NoImm},
+          {AmominuD,  FUNCT5, atomic(0b011, 0b11000),                           NoImm},
+          {AmomaxuD,  FUNCT5, atomic(0b011, 0b11100),                           NoImm},
+
+          {Fence,     FUNCT3, fields(OpcodeType::Fence, 0b000),                 NoImm},
+          {FenceI,    FUNCT3, fields(OpcodeType::Fence, 0b001),                 NoImm},
+
+          {Ecall,     EXACT,  system(0x000),                                    Csr},
+          {Ebreak,    EXACT,  system(0x001),                                    Csr},
+          {Sret,      EXACT,  system(0x102),                                    Csr},
+          {Mret,      EXACT,  system(0x302),                                    Csr},
+          {Wfi,       EXACT,  system(0x105),                                    Csr},
+          {SfenceVma, NO_RD,  fields(OpcodeType::System, 0b000, 0b0001001),     Csr},
+          {Csrrw,     FUNCT3, fields(OpcodeType::System, 0b001),                Csr},
+          {Csrrs,     FUNCT3, fields(OpcodeType::System, 0b010),                Csr},
+          {Csrrc,     FUNCT3, fields(OpcodeType::System, 0b011),                Csr},
+          {Csrrwi,    FUNCT3, fields(OpcodeType::System, 0b101),                Csr},
+          {Csrrsi,    FUNCT3, fields(OpcodeType::System, 0b110),                Csr},
+          {Csrrci,    FUNCT3, fields(OpcodeType::System, 0b111),                Csr},
+          // clang-format on
+        };
+
+        constexpr std::size_t ENCODING_COUNT = std::size(ENCODINGS);
+
+        /// Index of an encoding in the dispatch tables, NO_ENCODING ending a candidate list.
+        using EncodingIndex = u8;
+
+        constexpr EncodingIndex NO_ENCODING = std::numeric_limits<EncodingIndex>::max();
+        static_assert(ENCODING_COUNT < NO_ENCODING, "EncodingIndex is too small");
+
+        // The first level of the dispatch is indexed by the opcode, the second one by funct3
+        // and, for the opcodes that need it, funct7: index = base + funct3 + 8 * funct7.
+        constexpr std::size_t OPCODE_COUNT  = 1U << OPCODE_LEN;
+        constexpr std::size_t NARROW_GROUP  = 1U << 3;
+        constexpr std::size_t WIDE_GROUP    = 1U << 10;
+        constexpr InstSizeType FUNCT7_FIELD = 0xfe00'0000;
+
+        /// Where the second-level entries of an opcode start and whether funct7 indexes them.
+        struct OpcodeGroup
+        {
+            u16 base          = 0;    // The first 8 entries are empty, for unknown opcodes.
+            u16 funct7KeyMask = 0;
+        };
+
+        constexpr bool hasOpcode(const Encoding &encoding, std::size_t opcode)
+        {
+            return (encoding.match & OPCODE) == opcode;
+        }
+
+        constexpr bool isWide(std::size_t opcode)
+        {
+            for (const Encoding &encoding : ENCODINGS)
+            {
+                if (hasOpcode(encoding, opcode) && (encoding.mask & FUNCT7_FIELD) != 0)
+                    return true;
+            }
+            return false;
+        }
+
+        constexpr bool isUsed(std::size_t opcode)
+        {
+            for (const Encoding &encoding : ENCODINGS)
+            {
+                if (hasOpcode(encoding, opcode))
+                    return true;
+            }
+            return false;
+        }
+
+        constexpr std::size_t countSlots()
+        {
+            std::size_t slots = NARROW_GROUP;
+            for (std::size_t opcode = 0; opcode < OPCODE_COUNT; ++opcode)
+            {
+                if (isUsed(opcode))
+                    slots += isWide(opcode) ? WIDE_GROUP : NARROW_GROUP;
+            }
+            return slots;
+        }
+
+        constexpr std::size_t SLOT_COUNT = countSlots();
+        static_assert(SLOT_COUNT <= std::numeric_limits<u16>::max(), "too many entries");
+
+        constexpr std::array<OpcodeGroup, OPCODE_COUNT> makeGroups()
+        {
+            std::array<OpcodeGroup, OPCODE_COUNT> groups {};
+            std::size_t next = NARROW_GROUP;
+            for (std::size_t opcode = 0; opcode < OPCODE_COUNT; ++opcode)
+            {
+                if (!isUsed(opcode))
+                    continue;
+                const bool wide = isWide(opcode);
+                groups[opcode]  = {static_cast<u16>(next),
+                                   static_cast<u16>(wide ? (WIDE_GROUP - 1) & ~7U : 0)};
+                next += wide ? WIDE_GROUP : NARROW_GROUP;
+            }
+            return groups;
+        }
+
+        constexpr std::array<OpcodeGroup, OPCODE_COUNT> GROUPS = makeGroups();
+
+        /// The key of an instruction in the second level of its opcode.
+        constexpr std::size_t takeKey(InstSizeType inst, const OpcodeGroup &group)
+        {
+            return takeBits<14, 12>(inst) | (takeBits<31, 22>(inst) & group.funct7KeyMask);
+        }
+
+        /// The first encoding each second-level entry may be, the others follow in NEXT.
+        constexpr std::array<EncodingIndex, SLOT_COUNT> makeSlots()
+        {
+            std::array<EncodingIndex, SLOT_COUNT> slots {};
+            slots.fill(NO_ENCODING);
+            for (std::size_t opcode = 0; opcode < OPCODE_COUNT; ++opcode)
+            {
+                if (!isUsed(opcode))
+                    continue;
+                const OpcodeGroup &group = GROUPS[opcode];
+                const std::size_t size   = group.funct7KeyMask != 0 ? WIDE_GROUP : NARROW_GROUP;
+                for (std::size_t key = 0; key < size; ++key)
+                {
+                    // The instruction bits the key stands for, and which bits these are.
+                    const InstSizeType bits  = opcode | (key & 7) << 12 | (key >> 3) << 25;
+                    const InstSizeType keyed = size == WIDE_GROUP ? FUNCT7 : FUNCT3;
+                    for (std::size_t index = ENCODING_COUNT; index-- > 0;)
+                    {
+                        const Encoding &encoding = ENCODINGS[index];
+                        if (((bits ^ encoding.match) & encoding.mask & keyed) == 0)
+                            slots[group.base + key] = static_cast<EncodingIndex>(index);
+                    }
+                }
+            }
+            return slots;
+        }
+
+        /// The next encoding of the same opcode, tried when the mask of one does not match.
+        constexpr std::array<EncodingIndex, ENCODING_COUNT> makeNext()
+        {
+            std::array<EncodingIndex, ENCODING_COUNT> next {};
+            for (std::size_t index = 0; index < ENCODING_COUNT; ++index)
+            {
+                next[index] = NO_ENCODING;
+                for (std::size_t other = index + 1; other < ENCODING_COUNT; ++other)
+                {
+                    if (hasOpcode(ENCODINGS[other], ENCODINGS[index].match & OPCODE))
+                    {
+                        next[index] = static_cast<EncodingIndex>(other);
+                        break;
+                    }
+                }
+            }
+            return next;
+        }
+
+        constexpr std::array<EncodingIndex, SLOT_COUNT> SLOTS    = makeSlots();
+        constexpr std::array<EncodingIndex, ENCODING_COUNT> NEXT = makeNext();
+
+        constexpr DecodedInst decode(InstSizeType inst)
+        {
+            const OpcodeGroup &group = GROUPS[takeBits<6, 0>(inst)];
+            EncodingIndex index      = SLOTS[group.base + takeKey(inst, group)];
+            while (index != NO_ENCODING
+                   && (inst & ENCODINGS[index].mask) != ENCODINGS[index].match)
+                index = NEXT[index];
+
+            DecodedInst dec;
+            dec.raw = inst;
+            dec.rd  = takeBits<11, 7>(inst);
+            dec.rs1 = takeBits<19, 15>(inst);
+            dec.rs2 = takeBits<24, 20>(inst);
+            if (index == NO_ENCODING)
+                dec.kind = Illegal;
+            else
+            {
+                dec.kind = ENCODINGS[index].kind;
+                dec.imm  = ENCODINGS[index].takeImm(inst);
+            }
+            return dec;
+        }
+
+        // Every encoding decodes to itself, with the immediates where the formats put them.
+        constexpr bool decodesAll()
+        {
+            for (const Encoding &encoding : ENCODINGS)
+            {
+                if (decode(encoding.match).kind != encoding.kind)
+                    return false;
+            }
+            return true;
+        }
+
+        static_assert(decodesAll());
+        static_assert(decode(0xfff0'0513).imm == ~0ULL);                  // addi a0, zero, -1
+        static_assert(decode(0xfea5'bc23).imm == static_cast<u64>(-8));    // sd a0, -8(a1)
+        static_assert(decode(0xfe00'0ee3).imm == static_cast<u64>(-4));    // beqz zero, -4
+        static_assert(decode(0x8000'00b7).imm == 0xffff'ffff'8000'0000);   // lui ra, 0x80000
+        static_assert(decode(0x0100'00ef).imm == 16);                      // jal ra, 16
+        static_assert(decode(0x43f5'5513).kind == Srai);                   // srai a0, a0, 63
+        static_assert(decode(0x43f5'5513).imm == 63);
+        static_assert(decode(0x1050'0073).kind == Wfi);
+        static_assert(decode(0x1050'0873).kind == Illegal);                // wfi with rs1
+        static_assert(decode(0x0000'0000).kind == Illegal);
+        static_assert(decode(0x1005'25af).kind == LrW);                    // lr.w a1, (a0)
+        static_assert(decode(0x1605'35af).kind == LrD);                    // lr.d.aqrl a1, (a0)
+        static_assert(decode(0x10c5'25af).kind == Illegal);                // lr.w with rs2
+        static_assert(decode(0x04c5'b5af).kind == AmoaddD);                // amoadd.d.aq
+        static_assert(decode(0xe2c5'25af).kind == AmomaxuW);               // amomaxu.w.rl
+    }    // namespace
+
+    DecodedInst decodeInst(const InstSizeType inst) { return decode(inst); }
+
+    DecodedInst fuseInsts(const DecodedInst &first, const DecodedInst &second)
+    {
+        using enum InstKind;
+
+        DecodedInst fused = first;
+        const u8 rd       = first.rd;
+        // The second instruction updates the register the first one wrote.
+        const bool inPlace = rd != 0 && second.rd == rd && second.rs1 == rd;
+
+        if (first.kind == Lui && inPlace && (second.kind == Addi || second.kind == Addiw))
+        {
+            fused.kind = LuiAddi;
+            fused.imm  = first.imm + second.imm;
+            if (second.kind == Addiw)
+                fused.imm = static_cast<i64>(static_cast<int32_t>(fused.imm));
+        }
+        else if (first.kind == Auipc && inPlace && second.kind == Addi)
+        {
+            fused.kind = AuipcAddi;
+            fused.imm  = first.imm + second.imm;
+        }
+        else if (first.kind == Auipc && rd != 0 && second.kind == Jalr && second.rs1 == rd)
+        {
+            // The auipc offset is a multiple of 4 KiB and the jalr one fits 12 bits, so
+            // (imm + 0x800) & ~0xfff gives the auipc part back.
+            fused.kind = AuipcJalr;
+            fused.rd   = second.rd;
+            fused.rs1  = rd;
+            fused.imm  = first.imm + second.imm;
+        }
+        else if (first.kind == Slli && first.imm == 32 && inPlace && second.kind == Srli
+                 && second.imm == 32)
+        {
+            fused.kind = ZextW;
+            fused.imm  = 0;
+        }
+        else if ((first.kind == Slt || first.kind == Sltu) && rd != 0
+                 && (second.kind == Bne || second.kind == Beq) && second.rs1 == rd
+                 && second.rs2 == 0)
+        {
+            const bool isNotZero = second.kind == Bne;
+            if (first.kind == Slt)
+                fused.kind = isNotZero ? SltBnez : SltBeqz;
+            else
+                fused.kind = isNotZero ? SltuBnez : SltuBeqz;
+            fused.imm = DataSizeType::Word + second.imm;
+        }
+        return fused;
+    }
+
+    const char *instKindName(InstKind kind)
+    {
+        static constexpr const char *names[] = {
+          // clang-format off
+          "undecoded", "illegal",
+          "lui", "auipc", "jal", "jalr",
+          "beq", "bne", "blt", "bge", "bltu", "bgeu",
+          "lb", "lh", "lw", "ld", "lbu", "lhu", "lwu",
+          "sb", "sh", "sw", "sd",
+          "addi", "slti", "sltiu", "xori", "ori", "andi", "slli", "srli", "srai",
+          "addiw", "slliw", "srliw", "sraiw",
+          "add", "sub", "sll", "slt", "sltu", "xor", "srl", "sra", "or", "and", "mul",
+          "addw", "subw", "sllw", "srlw", "sraw",
+          "lr.w", "sc.w", "amoswap.w", "amoadd.w", "amoxor.w", "amoand.w", "amoor.w", "amomin.w",
+          "amomax.w", "amominu.w", "amomaxu.w",
+          "lr.d", "sc.d", "amoswap.d", "amoadd.d", "amoxor.d", "amoand.d", "amoor.d", "amomin.d",
+          "amomax.d", "amominu.d", "amomaxu.d",
+          "fence", "fence.i",
+          "ecall", "ebreak", "csrrw", "csrrs", "csrrc", "csrrwi", "csrrsi", "csrrci", "sret",
+          "mret", "wfi", "sfence.vma",
+          "lui+addi", "auipc+addi", "auipc+jalr", "slli+srli", "slt+bnez", "slt+beqz",
+          "sltu+bnez", "sltu+beqz",
+          // clang-format on
+        };
+        static_assert(std::size(names) == INST_KIND_COUNT, "a kind has no name");
+        return names[static_cast<std::size_t>(kind)];
+    }
+}    // namespace rvemu
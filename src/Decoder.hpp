@@ -0,0 +1,219 @@
+#pragma once
+
+#include "RVEmu.hpp"
+
+namespace rvemu
+{
+    // Enum to represent the various opcodes in the RISC-V instruction set.
+    enum class OpcodeType : u8 {
+        Lui     = 0b011'0111,    // Load upper immediate
+        Auipc   = 0b001'0111,    // Add upper immediate to pc
+        Jal     = 0b110'1111,    // Jump and link
+        Jalr    = 0b110'0111,    // Jump and link register
+        Branch  = 0b110'0011,    // Conditional branch
+        Load    = 0b000'0011,    // Load from memory
+        Store   = 0b010'0011,    // Store to memory
+        Immop   = 0b001'0011,    // Immediate arithmetic operation
+        Immop64 = 0b001'1011,    // Immediate arithmetic operation(RV64)
+        Op      = 0b011'0011,    // Register-register arithmetic operation
+        Op64    = 0b011'1011,    // Register-register arithmetic operation(RV64)
+        Amo     = 0b010'1111,    // Atomic memory operation
+        Fence   = 0b000'1111,    // Memory fence operation
+        System  = 0b111'0011     // System instructions
+    };
+
+    /// Every operation the emulator knows how to execute. `Undecoded` marks an empty slot of
+    /// the decode cache and must stay the first enumerator (value 0).
+    enum class InstKind : u8 {
+        Undecoded,
+        Illegal,
+
+        // U/J-type
+        Lui,
+        Auipc,
+        Jal,
+        Jalr,
+
+        // Branch
+        Beq,
+        Bne,
+        Blt,
+        Bge,
+        Bltu,
+        Bgeu,
+
+        // Load
+        Lb,
+        Lh,
+        Lw,
+        Ld,
+        Lbu,
+        Lhu,
+        Lwu,
+
+        // Store
+        Sb,
+        Sh,
+        Sw,
+        Sd,
+
+        // Immop
+        Addi,
+        Slti,
+        Sltiu,
+        Xori,
+        Ori,
+        Andi,
+        Slli,
+        Srli,
+        Srai,
+
+        // Immop64
+        Addiw,
+        Slliw,
+        Srliw,
+        Sraiw,
+
+        // Op
+        Add,
+        Sub,
+        Sll,
+        Slt,
+        Sltu,
+        Xor,
+        Srl,
+        Sra,
+        Or,
+        And,
+        Mul,
+
+        // Op64
+        Addw,
+        Subw,
+        Sllw,
+        Srlw,
+        Sraw,
+
+        // Amo
+        LrW,
+        ScW,
+        AmoswapW,
+        AmoaddW,
+        AmoxorW,
+        AmoandW,
+        AmoorW,
+        AmominW,
+        AmomaxW,
+        AmominuW,
+        AmomaxuW,
+        LrD,
+        ScD,
+        AmoswapD,
+        AmoaddD,
+        AmoxorD,
+        AmoandD,
+        AmoorD,
+        AmominD,
+        AmomaxD,
+        AmominuD,
+        AmomaxuD,
+
+        // Fence
+        Fence,
+        FenceI,
+
+        // System
+        Ecall,
+        Ebreak,
+        Csrrw,
+        Csrrs,
+        Csrrc,
+        Csrrwi,
+        Csrrsi,
+        Csrrci,
+        Sret,
+        Mret,
+        Wfi,
+        SfenceVma,
+
+        // Fused pairs, executed as one operation spanning two instructions
+        LuiAddi,      // lui+addi(w) of one register, imm holds the value
+        AuipcAddi,    // auipc+addi of one register, imm holds the offset from pc
+        AuipcJalr,    // auipc rs1 + jalr rd through rs1, imm holds the target offset from pc
+        ZextW,        // slli+srli by 32 of one register
+        SltBnez,      // slt rd + bnez rd, imm holds the target offset from pc
+        SltBeqz,      // slt rd + beqz rd
+        SltuBnez,     // sltu rd + bnez rd
+        SltuBeqz,     // sltu rd + beqz rd
+
+        Count
+    };
+
+    constexpr std::size_t INST_KIND_COUNT = static_cast<std::size_t>(InstKind::Count);
+
+    /// Whether an instruction of the given kind is a fused pair.
+    constexpr bool isFused(InstKind kind) { return kind >= InstKind::LuiAddi; }
+
+    /// Number of bytes of guest code an instruction of the given kind covers.
+    constexpr AddrType instLength(InstKind kind)
+    {
+        return isFused(kind) ? 2 * DataSizeType::Word : DataSizeType::Word;
+    }
+
+    constexpr bool isLoad(InstKind kind) { return kind >= InstKind::Lb && kind <= InstKind::Lwu; }
+
+    constexpr bool isStore(InstKind kind) { return kind >= InstKind::Sb && kind <= InstKind::Sd; }
+
+    /// Whether an instruction of the given kind is a load-reserved, a store-conditional or an
+    /// AMO of the A extension.
+    constexpr bool isAtomic(InstKind kind)
+    {
+        return kind >= InstKind::LrW && kind <= InstKind::AmomaxuD;
+    }
+
+    /// Whether an instruction of the given kind writes its rd register.
+    constexpr bool writesRd(InstKind kind)
+    {
+        using enum InstKind;
+        return (kind >= Lui && kind <= Jalr) || isLoad(kind) || (kind >= Addi && kind <= Sraw)
+               || isAtomic(kind) || (kind >= Csrrw && kind <= Csrrci) || isFused(kind);
+    }
+
+    /// Whether an instruction of the given kind may be the first of a fused pair.
+    constexpr bool mayStartPair(InstKind kind)
+    {
+        return kind == InstKind::Lui || kind == InstKind::Auipc || kind == InstKind::Slli
+               || kind == InstKind::Slt || kind == InstKind::Sltu;
+    }
+
+    /// Compact, allocation-free form of a decoded instruction. All the fields are extracted
+    /// once at decode time so executing it never has to look at the raw encoding again.
+    ///
+    /// `imm` holds the sign-extended immediate, the shift amount for shifts and the CSR address
+    /// for Zicsr instructions (whose immediate forms keep the 5-bit uimm in `rs1`).
+    struct DecodedInst
+    {
+        InstKind kind = InstKind::Undecoded;
+        u8 rd         = 0;
+        u8 rs1        = 0;
+        u8 rs2        = 0;
+        InstSizeType raw     = 0;
+        RegisterSizeType imm = 0;
+    };
+
+    static_assert(sizeof(DecodedInst) == 16, "DecodedInst must stay compact");
+
+    /// Decodes a raw 32-bit instruction. Unknown encodings decode to InstKind::Illegal.
+    ///
+    /// Decoding is driven by a table of mask/match encodings, from which the dispatch tables
+    /// indexed by opcode, then funct3 and funct7, are generated at compile time.
+    DecodedInst decodeInst(InstSizeType inst);
+
+    /// Fuses two consecutive instructions forming one of the idioms compilers emit for
+    /// constants, addresses, far calls, zero extension and branches on a comparison.
+    /// @return The fused pair, or first if the two do not form an idiom.
+    DecodedInst fuseInsts(const DecodedInst &first, const DecodedInst &second);
+
+    /// The mnemonic of an instruction kind, fused pairs joining their two mnemonics with '+'.
+    const char *instKindName(InstKind kind);
+}    // namespace rvemu
@@ -0,0 +1,198 @@
+#include "ElfLoader.hpp"
+
+#include "Memory.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/core.h>
+#include <iostream>
+#include <numeric>
+
+#include <elf.h>
+
+namespace rvemu
+{
+    namespace
+    {
+        [[noreturn]] void invalid(const std::string &name, const char *why)
+        {
+            std::cerr << "Invalid ELF file " << name << ": " << why << "\n";
+            abort();
+        }
+
+        /// Whether size bytes at offset are inside the file.
+        bool contains(std::span<const std::byte> file, u64 offset, u64 size)
+        {
+            return offset <= file.size() && size <= file.size() - offset;
+        }
+
+        /// Reads the header of type T at offset, which must be inside the file.
+        template <typename T>
+        T readAt(std::span<const std::byte> file, u64 offset)
+        {
+            T value;
+            std::memcpy(&value, file.data() + offset, sizeof(T));
+            return value;
+        }
+    }    // namespace
+
+    void SymbolTable::add(AddrType addr, u64 size, std::string_view name)
+    {
+        addrs_.push_back(addr);
+        entries_.push_back(
+            {size, static_cast<u32>(names_.size()), static_cast<u32>(name.size())});
+        names_ += name;
+    }
+
+    void SymbolTable::sort()
+    {
+        std::vector<u32> order(addrs_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, {}, [this](u32 idx) { return addrs_[idx]; });
+
+        std::vector<AddrType> addrs;
+        std::vector<Entry> entries;
+        addrs.reserve(order.size());
+        entries.reserve(order.size());
+        for (u32 idx : order)
+        {
+            addrs.push_back(addrs_[idx]);
+            entries.push_back(entries_[idx]);
+        }
+        addrs_   = std::move(addrs);
+        entries_ = std::move(entries);
+    }
+
+    std::optional<Symbol> SymbolTable::lookup(AddrType addr) const
+    {
+        auto it = std::ranges::upper_bound(addrs_, addr);
+        if (it == addrs_.begin())
+            return std::nullopt;
+
+        const std::size_t idx = std::distance(addrs_.begin(), it) - 1;
+        const Entry &entry    = entries_[idx];
+        if (entry.size != 0 && addr - addrs_[idx] >= entry.size)
+            return std::nullopt;
+        return Symbol {addrs_[idx], entry.size, nameOf(idx)};
+    }
+
+    std::optional<AddrType> SymbolTable::find(std::string_view name) const
+    {
+        for (std::size_t idx = 0; idx < entries_.size(); ++idx)
+        {
+            if (nameOf(idx) == name)
+                return addrs_[idx];
+        }
+        return std::nullopt;
+    }
+
+    std::string_view SymbolTable::nameOf(std::size_t idx) const
+    {
+        return std::string_view(names_).substr(entries_[idx].nameOffset, entries_[idx].nameLength);
+    }
+
+    std::string SymbolTable::describe(AddrType addr) const
+    {
+        const std::optional<Symbol> symbol = lookup(addr);
+        if (!symbol)
+            return fmt::format("{:#x}", addr);
+        if (symbol->addr == addr)
+            return fmt::format("{:#x} <{}>", addr, symbol->name);
+        return fmt::format("{:#x} <{}+{:#x}>", addr, symbol->name, addr - symbol->addr);
+    }
+
+    bool ElfLoader::isElf(std::span<const std::byte> file)
+    {
+        return file.size() >= SELFMAG && std::memcmp(file.data(), ELFMAG, SELFMAG) == 0;
+    }
+
+    ElfProgram
+    ElfLoader::load(std::span<const std::byte> file, DRAM &dram, const std::string &name)
+    {
+        if (!contains(file, 0, sizeof(Elf64_Ehdr)))
+            invalid(name, "truncated header");
+        const auto header = readAt<Elf64_Ehdr>(file, 0);
+        if (header.e_ident[EI_CLASS] != ELFCLASS64 || header.e_ident[EI_DATA] != ELFDATA2LSB)
+            invalid(name, "not a little-endian ELF64 file");
+        if (header.e_machine != EM_RISCV)
+            invalid(name, "not a RISC-V file");
+        if (header.e_type != ET_EXEC)
+            invalid(name, "not an executable");
+        if (header.e_phentsize != sizeof(Elf64_Phdr)
+            || !contains(file, header.e_phoff, u64 {header.e_phnum} * sizeof(Elf64_Phdr)))
+            invalid(name, "truncated program headers");
+
+        ElfProgram program {header.e_entry, DRAM_BASE, readSymbols(file)};
+        for (u16 idx = 0; idx < header.e_phnum; ++idx)
+        {
+            const auto segment =
+                readAt<Elf64_Phdr>(file, header.e_phoff + idx * sizeof(Elf64_Phdr));
+            if (segment.p_type != PT_LOAD || segment.p_memsz == 0)
+                continue;
+
+            // Physical addresses: the program runs without translation from its entry.
+            const AddrType offset = segment.p_paddr - DRAM_BASE;
+            if (segment.p_filesz > segment.p_memsz || segment.p_paddr < DRAM_BASE
+                || offset > dram.size() || segment.p_memsz > dram.size() - offset)
+                invalid(name, "segment outside of DRAM");
+            if (!contains(file, segment.p_offset, segment.p_filesz))
+                invalid(name, "truncated segment");
+
+            std::memcpy(dram.data() + offset, file.data() + segment.p_offset, segment.p_filesz);
+            if (!dram.startsZeroed())
+                std::memset(dram.data() + offset + segment.p_filesz,
+                            0,
+                            segment.p_memsz - segment.p_filesz);
+
+            if (segment.p_flags & PF_X)
+                program.codeEnd =
+                    std::max(program.codeEnd, segment.p_paddr + segment.p_filesz);
+        }
+        return program;
+    }
+
+    SymbolTable ElfLoader::readSymbols(std::span<const std::byte> file)
+    {
+        SymbolTable symbols;
+        if (!contains(file, 0, sizeof(Elf64_Ehdr)))
+            return symbols;
+        const auto header = readAt<Elf64_Ehdr>(file, 0);
+        if (header.e_shentsize != sizeof(Elf64_Shdr)
+            || !contains(file, header.e_shoff, u64 {header.e_shnum} * sizeof(Elf64_Shdr)))
+            return symbols;
+
+        auto section = [&](u32 idx) {
+            return readAt<Elf64_Shdr>(file, header.e_shoff + idx * sizeof(Elf64_Shdr));
+        };
+        for (u16 idx = 0; idx < header.e_shnum; ++idx)
+        {
+            const Elf64_Shdr table = section(idx);
+            if (table.sh_type != SHT_SYMTAB || table.sh_link >= header.e_shnum
+                || !contains(file, table.sh_offset, table.sh_size))
+                continue;
+            const Elf64_Shdr strings = section(table.sh_link);
+            if (!contains(file, strings.sh_offset, strings.sh_size))
+                continue;
+            const std::string_view names(reinterpret_cast<const char *>(file.data())
+                                             + strings.sh_offset,
+                                         strings.sh_size);
+
+            for (u64 offset = 0; offset + sizeof(Elf64_Sym) <= table.sh_size;
+                 offset += sizeof(Elf64_Sym))
+            {
+                const auto symbol = readAt<Elf64_Sym>(file, table.sh_offset + offset);
+                const u8 type     = ELF64_ST_TYPE(symbol.st_info);
+                if (symbol.st_shndx == SHN_UNDEF || symbol.st_name >= names.size()
+                    || (type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE))
+                    continue;
+
+                std::string_view name = names.substr(symbol.st_name);
+                name                  = name.substr(0, name.find('\0'));
+                if (!name.empty())
+                    symbols.add(symbol.st_value, symbol.st_size, name);
+            }
+        }
+        symbols.sort();
+        return symbols;
+    }
+}    // namespace rvemu
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "RVEmu.hpp"
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rvemu
+{
+    class DRAM;
+
+    /// A function or label of the program.
+    struct Symbol
+    {
+        AddrType addr;            /// Address of the symbol.
+        u64 size;                 /// Size in bytes, 0 if unknown.
+        std::string_view name;    /// Valid as long as the table is.
+    };
+
+    /// Address to symbol index of a program, built once and then only looked up.
+    ///
+    /// The start addresses are searched in an array of their own, so a lookup only walks a
+    /// few cache lines, the sizes and names are fetched for the symbol found.
+    class SymbolTable
+    {
+      public:
+        /// Adds a symbol, the table must be sorted before the next lookup.
+        void add(AddrType addr, u64 size, std::string_view name);
+
+        /// Sorts the symbols by address.
+        void sort();
+
+        /// Returns the symbol addr falls in: the last one starting at or before it, unless its
+        /// size is known and addr is past its end.
+        std::optional<Symbol> lookup(AddrType addr) const;
+
+        /// Returns the address of the first symbol with the given name.
+        std::optional<AddrType> find(std::string_view name) const;
+
+        std::size_t size() const { return addrs_.size(); }
+
+        /// Formats addr as symbol+offset, or as a bare address if no symbol holds it.
+        std::string describe(AddrType addr) const;
+
+      private:
+        std::string_view nameOf(std::size_t idx) const;
+
+        struct Entry
+        {
+            u64 size;
+            u32 nameOffset;    /// Offset of the name in names_.
+            u32 nameLength;
+        };
+
+        std::vector<AddrType> addrs_;    /// Start addresses, sorted.
+        std::vector<Entry> entries_;     /// The rest of the symbol at the same index.
+        std::string names_;              /// All the names back to back.
+    };
+
+    /// What loading an ELF executable produced.
+    struct ElfProgram
+    {
+        AddrType entry;         /// e_entry, where the program starts.
+        AddrType codeEnd;       /// End of the executable segments.
+        SymbolTable symbols;    /// Functions, objects and labels of the symbol table.
+    };
+
+    /// Loads RISC-V ELF64 executables.
+    class ElfLoader
+    {
+      public:
+        /// Whether a file starts with the ELF magic number.
+        static bool isElf(std::span<const std::byte> file);
+
+        /// Copies the PT_LOAD segments of an executable to DRAM at their physical address,
+        /// clearing the part of each segment that is not in the file (.bss) unless DRAM is
+        /// known to hold zeros there already. Aborts on a file that is not a little-endian
+        /// RISC-V ELF64 executable fitting in DRAM.
+        /// @param name The path of the file, for error messages.
+        static ElfProgram
+        load(std::span<const std::byte> file, DRAM &dram, const std::string &name);
+
+        /// Reads the symbol table of an ELF64 file, empty if it has none.
+        static SymbolTable readSymbols(std::span<const std::byte> file);
+    };
+}    // namespace rvemu
@@ -1,5 +1,77 @@
 #include "Emulator.hpp"
 
-rvemu::Emulator::Emulator(const std::string &fileName) : cpu_(fileName) { }
+#include "trace/TraceWriter.hpp"
 
-void rvemu::Emulator::runEmulator() { cpu_.steps(); }
+rvemu::Emulator::Emulator(const std::string &fileName,
+                          ExecEngine engine,
+                          const RamConfig &ram,
+                          u32 harts)
+  : cpu_(fileName, ram)
+{
+    cpu_.setEngine(engine);
+    for (u32 hart = 1; hart < harts; ++hart)
+        others_.push_back(std::make_unique<CPU>(cpu_, hart));
+}
+
+rvemu::Emulator::~Emulator()
+{
+    if (!threads_.empty())
+    {
+        stop();
+        join();
+    }
+}
+
+void rvemu::Emulator::runEmulator() { run(); }
+
+void rvemu::Emulator::traceTo(const std::string &path)
+{
+    for (u32 hart = 0; hart < getHartCount(); ++hart)
+        getCPU(hart).setTraceBuffer(nullptr);
+    trace_ = std::make_unique<TraceWriter>(path, getHartCount());
+    for (u32 hart = 0; hart < getHartCount(); ++hart)
+        getCPU(hart).setTraceBuffer(&trace_->getBuffer(hart));
+}
+
+rvemu::StopReason rvemu::Emulator::run(u64 maxInstructions)
+{
+    if (others_.empty())
+        return cpu_.run(maxInstructions);
+
+    start(maxInstructions);
+    threads_.front().join();
+    stop();
+    return join().front();
+}
+
+void rvemu::Emulator::start(u64 maxInstructions)
+{
+    reasons_.assign(getHartCount(), StopReason::Exception);
+    for (u32 hart = 0; hart < getHartCount(); ++hart)
+    {
+        threads_.emplace_back([this, hart, maxInstructions] {
+            reasons_[hart] = getCPU(hart).run(maxInstructions);
+        });
+    }
+}
+
+void rvemu::Emulator::stop()
+{
+    for (u32 hart = 0; hart < getHartCount(); ++hart)
+        getCPU(hart).requestStop();
+}
+
+std::vector<rvemu::StopReason> rvemu::Emulator::join()
+{
+    for (std::thread &thread : threads_)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    threads_.clear();
+
+    // A stop asked for once a hart was done is not kept for its next run.
+    for (u32 hart = 0; hart < getHartCount(); ++hart)
+        getCPU(hart).getCSRs().getLines().takeStop();
+    return reasons_;
+}
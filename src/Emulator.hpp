@@ -2,17 +2,62 @@
 
 #include "Cpu.hpp"
 
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
 namespace rvemu
 {
+    class TraceWriter;
+
     class Emulator
     {
       public:
-        Emulator(const std::string &);
+        // A machine of harts harts sharing one DRAM and the devices, with ids from 0.
+        Emulator(const std::string &,
+                 ExecEngine engine    = ExecEngine::Interpreter,
+                 const RamConfig &ram = {},
+                 u32 harts            = 1);
+        ~Emulator();
+
         void runEmulator();
 
-        const CPU &getCPU() { return cpu_; }
+        // Records the instructions the program executes to a binary trace file, written by a
+        // background thread. The file is complete once the emulator is destroyed.
+        void traceTo(const std::string &path);
+
+        // Runs the program until it ends or executed maxInstructions instructions. With several
+        // harts each runs on a thread of its own, the others are stopped once hart 0 is done.
+        // Returns why hart 0 stopped.
+        StopReason run(u64 maxInstructions = CPU::NO_LIMIT);
+
+        // Same as run() on hart 0 alone, also stopping before the instruction at pc is
+        // executed.
+        StopReason runUntil(AddrType pc, u64 maxInstructions = CPU::NO_LIMIT)
+        {
+            return cpu_.runUntil(pc, maxInstructions);
+        }
+
+        // Starts every hart on a thread of its own, each running like run() does on its own
+        // until it ends, or executed maxInstructions instructions, or is stopped.
+        void start(u64 maxInstructions = CPU::NO_LIMIT);
+
+        // Asks every hart to stop at its next check, waking the ones waiting in wfi.
+        void stop();
+
+        // Waits for the harts started by start() to end. Returns why each one did, by id.
+        std::vector<StopReason> join();
+
+        CPU &getCPU(u32 hart = 0) { return hart == 0 ? cpu_ : *others_[hart - 1]; }
+
+        u32 getHartCount() const { return others_.size() + 1; }
 
       private:
         CPU cpu_;
+        std::vector<std::unique_ptr<CPU>> others_;    // Harts 1 and up
+        std::vector<std::thread> threads_;            // By hart id, while started
+        std::vector<StopReason> reasons_;
+        std::unique_ptr<TraceWriter> trace_;
     };
 }    // namespace rvemu
@@ -0,0 +1,19 @@
+#include "Interpreter.hpp"
+
+#include <utility>
+
+namespace rvemu
+{
+    namespace
+    {
+        template <std::size_t... Kinds>
+        constexpr std::array<Interpreter::Handler, INST_KIND_COUNT>
+        makeHandlers(std::index_sequence<Kinds...>)
+        {
+            return {&Interpreter::execute<static_cast<InstKind>(Kinds)>...};
+        }
+    }    // namespace
+
+    const std::array<Interpreter::Handler, INST_KIND_COUNT> Interpreter::handlers_ =
+        makeHandlers(std::make_index_sequence<INST_KIND_COUNT> {});
+}    // namespace rvemu
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "Cpu.hpp"
+#include "Decoder.hpp"
+#include "RVEmu.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+
+namespace rvemu
+{
+    /// Executes DecodedInst records on a CPU.
+    ///
+    /// The semantics of every InstKind live in execute<K>(), the non-template execute()
+    /// dispatches through a table of those instantiations indexed by the kind.
+    class Interpreter
+    {
+      public:
+        using Handler = AddrType (*)(CPU &, const DecodedInst &, AddrType);
+
+        /// Executes an instruction.
+        /// @param cpu The hart executing the instruction.
+        /// @param inst The decoded instruction.
+        /// @param pc The address of the instruction.
+        /// @return The address of the next instruction.
+        static AddrType execute(CPU &cpu, const DecodedInst &inst, AddrType pc)
+        {
+            return handlers_[static_cast<std::size_t>(inst.kind)](cpu, inst, pc);
+        }
+
+        template <InstKind K>
+        static AddrType execute(CPU &cpu, const DecodedInst &inst, AddrType pc);
+
+        /// Computes the result of an integer instruction of the Immop, Immop64, Op or Op64
+        /// groups, or of zext.w, rhs being the immediate or rs2. The block optimizer folds
+        /// constants with it.
+        static constexpr RegisterSizeType compute(InstKind kind,
+                                                  RegisterSizeType lhs,
+                                                  RegisterSizeType rhs)
+        {
+            using enum InstKind;
+
+            switch (kind)
+            {
+                case Addi:
+                case Add:   return lhs + rhs;
+                case Sub:   return lhs - rhs;
+                case Slti:
+                case Slt:   return static_cast<i64>(lhs) < static_cast<i64>(rhs) ? 1 : 0;
+                case Sltiu:
+                case Sltu:  return lhs < rhs ? 1 : 0;
+                case Xori:
+                case Xor:   return lhs ^ rhs;
+                case Ori:
+                case Or:    return lhs | rhs;
+                case Andi:
+                case And:   return lhs & rhs;
+                case Slli:
+                case Sll:   return lhs << (rhs & 0x3f);
+                case Srli:
+                case Srl:   return lhs >> (rhs & 0x3f);
+                case Srai:
+                case Sra:   return static_cast<i64>(lhs) >> (rhs & 0x3f);
+                case Mul:   return lhs * rhs;
+                case Addiw:
+                case Addw:  return sextWord(lhs + rhs);
+                case Subw:  return sextWord(lhs - rhs);
+                case Slliw:
+                case Sllw:  return sextWord(lhs << (rhs & 0x1f));
+                case Srliw:
+                case Srlw:  return sextWord(static_cast<u32>(lhs) >> (rhs & 0x1f));
+                case Sraiw:
+                case Sraw:  return sextWord(static_cast<int32_t>(lhs) >> (rhs & 0x1f));
+                case ZextW: return lhs & 0xffff'ffff;
+
+                default: return 0;
+            }
+        }
+
+        /// Whether a conditional branch is taken.
+        static constexpr bool branchTaken(InstKind kind, RegisterSizeType lhs, RegisterSizeType rhs)
+        {
+            using enum InstKind;
+
+            switch (kind)
+            {
+                case Beq:  return lhs == rhs;
+                case Bne:  return lhs != rhs;
+                case Blt:  return static_cast<i64>(lhs) < static_cast<i64>(rhs);
+                case Bge:  return static_cast<i64>(lhs) >= static_cast<i64>(rhs);
+                case Bltu: return lhs < rhs;
+                case Bgeu: return lhs >= rhs;
+
+                default: return false;
+            }
+        }
+
+        /// The host ordering of an instruction of the A extension, from its aq and rl bits:
+        /// aq orders the accesses that follow it after it, rl the ones before it first.
+        static constexpr std::memory_order atomicOrder(InstSizeType raw)
+        {
+            const bool aq = raw >> 26 & 1;
+            const bool rl = raw >> 25 & 1;
+            if (aq && rl)
+                return std::memory_order_seq_cst;
+            if (aq)
+                return std::memory_order_acquire;
+            return rl ? std::memory_order_release : std::memory_order_relaxed;
+        }
+
+      private:
+        /// Runs an AMO on a host atomic, returning the value it replaced. The minimum and the
+        /// maximum have no host instruction, they retry a compare-exchange.
+        template <InstKind K, typename T>
+        static T amo(std::atomic_ref<T> target, T operand, std::memory_order order)
+        {
+            using enum InstKind;
+            using Signed = std::make_signed_t<T>;
+
+            if constexpr (K == AmoswapW || K == AmoswapD)
+                return target.exchange(operand, order);
+            else if constexpr (K == AmoaddW || K == AmoaddD)
+                return target.fetch_add(operand, order);
+            else if constexpr (K == AmoxorW || K == AmoxorD)
+                return target.fetch_xor(operand, order);
+            else if constexpr (K == AmoandW || K == AmoandD)
+                return target.fetch_and(operand, order);
+            else if constexpr (K == AmoorW || K == AmoorD)
+                return target.fetch_or(operand, order);
+            else
+            {
+                auto pick = [operand](T old) -> T {
+                    if constexpr (K == AmominW || K == AmominD)
+                        return static_cast<Signed>(operand) < static_cast<Signed>(old) ? operand
+                                                                                       : old;
+                    else if constexpr (K == AmomaxW || K == AmomaxD)
+                        return static_cast<Signed>(operand) > static_cast<Signed>(old) ? operand
+                                                                                       : old;
+                    else if constexpr (K == AmominuW || K == AmominuD)
+                        return operand < old ? operand : old;
+                    else
+                        return operand > old ? operand : old;
+                };
+                T old = target.load(std::memory_order_relaxed);
+                while (
+                    !target.compare_exchange_weak(old, pick(old), order, std::memory_order_relaxed))
+                { }
+                return old;
+            }
+        }
+
+        static constexpr RegisterSizeType sextWord(RegisterSizeType value)
+        {
+            return static_cast<i64>(static_cast<int32_t>(value));
+        }
+
+        static const std::array<Handler, INST_KIND_COUNT> handlers_;
+    };
+
+    template <InstKind K>
+    AddrType Interpreter::execute(CPU &cpu, const DecodedInst &inst, AddrType pc)
+    {
+        using enum InstKind;
+
+        Registers &regs            = cpu.getRegs();
+        const RegisterSizeType rs1 = regs.read(inst.rs1);
+        const RegisterSizeType rs2 = regs.read(inst.rs2);
+        const RegisterSizeType imm = inst.imm;
+        const AddrType next        = pc + instLength(K);
+        if constexpr (isFused(K))
+            cpu.retireFused(1);
+
+        // U/J-type
+        if constexpr (K == Lui)
+            regs.write(inst.rd, imm);
+        else if constexpr (K == Auipc)
+            regs.write(inst.rd, pc + imm);
+        else if constexpr (K == Jal)
+        {
+            regs.write(inst.rd, next);
+            return pc + imm;
+        }
+        else if constexpr (K == Jalr)
+        {
+            regs.write(inst.rd, next);
+            return (rs1 + imm) & ~1ULL;
+        }
+
+        // Branch
+        else if constexpr (K >= Beq && K <= Bgeu)
+            return branchTaken(K, rs1, rs2) ? pc + imm : next;
+
+        // Load
+        else if constexpr (K == Lb)
+            regs.write(inst.rd, static_cast<int8_t>(cpu.readMemory<u8>(rs1 + imm)));
+        else if constexpr (K == Lh)
+            regs.write(inst.rd, static_cast<int16_t>(cpu.readMemory<u16>(rs1 + imm)));
+        else if constexpr (K == Lw)
+            regs.write(inst.rd, static_cast<int32_t>(cpu.readMemory<u32>(rs1 + imm)));
+        else if constexpr (K == Ld)
+            regs.write(inst.rd, cpu.readMemory<u64>(rs1 + imm));
+        else if constexpr (K == Lbu)
+            regs.write(inst.rd, cpu.readMemory<u8>(rs1 + imm));
+        else if constexpr (K == Lhu)
+            regs.write(inst.rd, cpu.readMemory<u16>(rs1 + imm));
+        else if constexpr (K == Lwu)
+            regs.write(inst.rd, cpu.readMemory<u32>(rs1 + imm));
+
+        // Store
+        else if constexpr (K == Sb)
+            cpu.writeMemory<u8>(rs1 + imm, rs2);
+        else if constexpr (K == Sh)
+            cpu.writeMemory<u16>(rs1 + imm, rs2);
+        else if constexpr (K == Sw)
+            cpu.writeMemory<u32>(rs1 + imm, rs2);
+        else if constexpr (K == Sd)
+            cpu.writeMemory<u64>(rs1 + imm, rs2);
+
+        // Immop, Immop64, Op and Op64
+        else if constexpr (K >= Addi && K <= Sraw)
+            regs.write(inst.rd, compute(K, rs1, K <= Sraiw ? imm : rs2));
+
+        // Amo
+        else if constexpr (isAtomic(K))
+        {
+            using T                       = std::conditional_t<(K >= LrD), u64, u32>;
+            const std::memory_order order = atomicOrder(inst.raw);
+            T old;
+            if constexpr (K == LrW || K == LrD)
+            {
+                // A host load cannot release, an lr.rl is sequentially consistent instead.
+                const bool release = order == std::memory_order_release;
+                old = cpu.loadReserved<T>(rs1, release ? std::memory_order_seq_cst : order);
+            }
+            else if constexpr (K == ScW || K == ScD)
+                old = cpu.storeConditional<T>(rs1, static_cast<T>(rs2), order) ? 0 : 1;
+            else
+                old = amo<K>(cpu.atomicAt<T, AccessType::Store>(rs1), static_cast<T>(rs2), order);
+            regs.write(inst.rd, static_cast<i64>(static_cast<std::make_signed_t<T>>(old)));
+        }
+
+        // Fence
+        else if constexpr (K == Fence)
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        else if constexpr (K == FenceI)
+            cpu.flushCodeCaches();
+
+        // System
+        else if constexpr (K == Ecall || K == Ebreak)
+            std::cout << "Calling to operative system\n";
+        else if constexpr (K >= Csrrw && K <= Csrrci)
+        {
+            CSRInterface &csrs            = cpu.getCSRs();
+            constexpr bool isImm          = K >= Csrrwi;
+            const RegisterSizeType source = isImm ? inst.rs1 : rs1;
+            const RegisterSizeType old    = csrs.read(imm);
+
+            if constexpr (K == Csrrw || K == Csrrwi)
+                csrs.write(imm, source);
+            else if constexpr (K == Csrrs || K == Csrrsi)
+            {
+                if (inst.rs1 != 0)
+                    csrs.write(imm, old | source);
+            }
+            else
+            {
+                if (inst.rs1 != 0)
+                    csrs.write(imm, old & ~source);
+            }
+            regs.write(inst.rd, old);
+        }
+        else if constexpr (K == Sret)
+        {
+            CSRInterface &csrs = cpu.getCSRs();
+            u64 sstatus        = csrs.read(SSTATUS);
+            cpu.setMode((sstatus & MASK_SPP) >> 8);
+            u64 spie = (sstatus & MASK_SPIE) >> 5;
+            sstatus  = (sstatus & ~MASK_SIE) | (spie << 1);
+            sstatus |= MASK_SPIE;
+            sstatus &= ~MASK_SPP;
+            csrs.write(SSTATUS, sstatus);
+            return csrs.read(SEPC) & ~0b11ULL;
+        }
+        else if constexpr (K == Mret)
+        {
+            CSRInterface &csrs = cpu.getCSRs();
+            u64 mstatus        = csrs.read(MSTATUS);
+            Mode mode          = (mstatus & MASK_MPP) >> 11;
+            cpu.setMode(mode);
+            u64 mpie = (mstatus & MASK_MPIE) >> 7;
+            mstatus  = (mstatus & ~MASK_MIE) | (mpie << 3);
+            mstatus |= MASK_MPIE;
+            mstatus &= ~MASK_MPP;
+            if (mode != Machine)
+                mstatus &= ~MASK_MPRV;
+            csrs.write(MSTATUS, mstatus);
+            return csrs.read(MEPC) & ~0b11ULL;
+        }
+        else if constexpr (K == Wfi)
+            cpu.waitForInterrupt();
+        else if constexpr (K == SfenceVma)
+            cpu.flushTlb();
+
+        // Fused pairs
+        else if constexpr (K == LuiAddi)
+            regs.write(inst.rd, imm);
+        else if constexpr (K == AuipcAddi)
+            regs.write(inst.rd, pc + imm);
+        else if constexpr (K == AuipcJalr)
+        {
+            regs.write(inst.rs1, pc + ((imm + 0x800) & ~0xfffULL));
+            regs.write(inst.rd, next);
+            return (pc + imm) & ~1ULL;
+        }
+        else if constexpr (K == ZextW)
+            regs.write(inst.rd, compute(K, rs1, 0));
+        else if constexpr (K >= SltBnez && K <= SltuBeqz)
+        {
+            const RegisterSizeType less = compute(K <= SltBeqz ? Slt : Sltu, rs1, rs2);
+            regs.write(inst.rd, less);
+            return (less != 0) == (K == SltBnez || K == SltuBnez) ? pc + imm : next;
+        }
+
+        else
+            throw("Illegal instruction\n");
+
+        return next;
+    }
+}    // namespace rvemu
@@ -1,132 +1,99 @@
 #include "Memory.hpp"
 
+#include "ElfLoader.hpp"
 #include "RVEmu.hpp"
 
 #include <bitset>
-#include <cassert>
+#include <chrono>
 #include <cstddef>
-#include <fstream>
+#include <cstring>
+#include <span>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // LITTLE ENDIAN: the lew significant bit is stored in the lower address.
 // Therefore 1100-0001 is stored as 0x0: 0001 0x1: 1100
 namespace rvemu
 {
-    SystemInterface::SystemInterface(const std::string &fileName) : lastInst_ {0}
+    DRAM::DRAM(const RamConfig &config)
+      : backend_(RamBackend::create(config)), data_(backend_->data()), size_(backend_->size())
+    { }
+
+    SystemInterface::SystemInterface(const std::string &fileName, const RamConfig &ram)
+      : memory_(ram), lastInst_ {0}, entry_ {DRAM_BASE}
     {
         loadCode(fileName);
     }
 
     void SystemInterface::loadCode(const std::string &file_name)
     {
-        std::ifstream inputFile;
+        const auto start = std::chrono::steady_clock::now();
 
-        inputFile.open(file_name, std::ios::binary);
-        if (inputFile.is_open() == false)
+        const int fd = open(file_name.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
         {
             std::cerr << "Invalid file name: " << file_name << "\n";
             abort();
         }
 
-        AddrType instAddr = DRAM_BASE;
-        unsigned char b;
-        while (inputFile.read(reinterpret_cast<char *>(&b), Byte))
+        // Copied rather than mapped over DRAM, the program file may be rewritten while the
+        // emulator runs, and DRAM may be backed by a file or huge pages.
+        const std::size_t size = st.st_size;
+        void *mapping          = size != 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+                                           : nullptr;
+        close(fd);
+        if (mapping == MAP_FAILED)
         {
-            memory_.write(instAddr, b, Byte);
-            instAddr += Byte;
+            std::cerr << "Cannot map " << file_name << "\n";
+            abort();
         }
-        lastInst_ = instAddr;
-    }
-
-    std::ostream &operator<< (std::ostream &os, std::byte b)
-    {
-        return os << std::bitset<8>(std::to_integer<unsigned char>(b));
-    }
+        const std::span file(static_cast<const std::byte *>(mapping), size);
 
-    inline bool isAlign(AddrType ad, DataSizeType sz) { return ad % sz == 0; }
-
-    inline void handleAlignmentEx() { std::cout << "Access to misaligned data\t"; }
-
-    RegisterSizeType
-    readFromMemory(MemoryType &mem, AddrType base, AddrType readFrom, DataSizeType dataSize)
-    {
-        RegisterSizeType dataToTake = 0;
-        assert(readFrom >= base);
-        const size_t index = readFrom - base;
-        assert(index < mem.size());
-
-        for (size_t i = 0; i < dataSize; ++i)
+        if (ElfLoader::isElf(file))
         {
-            dataToTake |= std::to_integer<decltype(dataToTake)>(mem[index + i]) << (8 * i);
+            ElfProgram program = ElfLoader::load(file, memory_, file_name);
+            entry_             = program.entry;
+            lastInst_          = program.codeEnd;
+            symbols_           = std::move(program.symbols);
         }
-        return dataToTake;
-    }
-
-    bool SystemInterface::checkLimit(AddrType a)
-    {
-        size_t index = a - DRAM_BASE;
-        return (a >= DRAM_BASE) && index < DRAM_BASE;
-    }
-
-    void writeToMemory(MemoryType &mem,
-                       AddrType base,
-                       AddrType whereToWrite,
-                       RegisterSizeType whatToWrite,
-                       DataSizeType size)
-    {
-#ifdef DEB_BIN_INS
-        std::bitset<64> whs_b(what_to_write);
-        std::cout << "what_to_store_binary = " << whs_b << std::endl;
-#endif
-        assert(whereToWrite >= base);
-        size_t indx = whereToWrite - base;
-        assert(indx < mem.size());
-
-        for (size_t i = 0; i < size; ++i)
-        {
-            std::byte byteToStore = std::byte(whatToWrite >> (8 * i));
-#ifdef DEB_BIN_INS
-            std::cout << "byte_to_store = " << byte_to_store << "\n";
-#endif
-            mem[indx + i] = byteToStore;
-        }
-    }
-
-    RegisterSizeType SystemInterface::readData(AddrType readFrom, DataSizeType sz)
-    {
-        assert(checkLimit(readFrom));
-        if (isAlign(readFrom, sz) == false)
+        else
         {
-            handleAlignmentEx();
+            // A flat binary, code from the start of DRAM to the end of the file.
+            if (size > memory_.size())
+            {
+                std::cerr << "Program does not fit in DRAM: " << file_name << "\n";
+                abort();
+            }
+            std::memcpy(memory_.data(), file.data(), size);
+            entry_    = DRAM_BASE;
+            lastInst_ = DRAM_BASE + size;
         }
-        return memory_.read(readFrom, sz);
-        throw("Invalid read location\n");
-        abort();
-    }
+        if (size != 0)
+            munmap(mapping, size);
 
-    bool SystemInterface::validWrite(AddrType writeTo)
-    {
-        return lastInst_ <= writeTo && writeTo < (DRAM_BASE + DRAM_SIZE);
+        loadStats_ = {size,
+                      static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::steady_clock::now() - start)
+                                           .count())};
     }
 
-    void SystemInterface::writeData(AddrType writeTo, RegisterSizeType whatWrite, DataSizeType sz)
+    Device &
+    SystemInterface::mapDevice(AddrType base, AddrType size, std::unique_ptr<Device> device)
     {
-        assert(checkLimit(writeTo));
-        if (isAlign(writeTo, sz) == false)
+        if (base - DRAM_BASE < memory_.size() || DRAM_BASE - base < size)
         {
-            handleAlignmentEx();
+            std::cerr << "Cannot map " << device->name() << ": the range overlaps DRAM\n";
+            abort();
         }
-        return memory_.write(writeTo, whatWrite, sz);
-        throw("Invalid write location\n");
-        abort();
-    }
-
-    void DRAM::write(AddrType whereToWrite, RegisterSizeType whatToWrite, DataSizeType size)
-    {
-        writeToMemory(dram_, DRAM_BASE, whereToWrite, whatToWrite, size);
+        return mmio_.map(base, size, std::move(device));
     }
 
-    RegisterSizeType DRAM::read(AddrType readFrom, DataSizeType dataSize)
+    std::ostream &operator<< (std::ostream &os, std::byte b)
     {
-        return readFromMemory(dram_, DRAM_BASE, readFrom, dataSize);
+        return os << std::bitset<8>(std::to_integer<unsigned char>(b));
     }
 }    // namespace rvemu
@@ -1,38 +1,110 @@
 #pragma once
 
+#include "ElfLoader.hpp"
 #include "RVEmu.hpp"
+#include "RamBackend.hpp"
+#include "devices/MmioBus.hpp"
 
+#include <bit>
+#include <concepts>
 #include <cstddef>
+#include <cstring>
 #include <iostream>
-#include <vector>
+#include <memory>
 
 namespace rvemu
 {
-    using MemoryType = std::vector<std::byte>;
-
-    RegisterSizeType readFromMemory(MemoryType &, RegisterSizeType, AddrType, DataSizeType);
-    void writeToMemory(MemoryType &, AddrType base, AddrType, RegisterSizeType, DataSizeType);
     std::ostream &operator<< (std::ostream &os, std::byte b);
 
+    /// Guest memory is little endian and accessed with plain host loads and stores.
+    static_assert(std::endian::native == std::endian::little, "rvemu needs a little-endian host");
+
+    /// The widths of a guest memory access.
+    template <typename T>
+    concept MemoryValue = std::same_as<T, u8> || std::same_as<T, u16> || std::same_as<T, u32>
+                          || std::same_as<T, u64>;
+
+    /// Guest RAM, held by a RamBackend. By default an anonymous mapping the host kernel fills
+    /// with zero pages on first touch: an emulator only pays for the pages its guest uses,
+    /// however large DRAM is.
     class DRAM
     {
       public:
-        DRAM() : dram_ {DRAM_SIZE, std::byte {0}} { }
+        /// Maps guest RAM as configured, aborting if the host cannot.
+        explicit DRAM(const RamConfig &config = {});
 
-        /// Writes data to a specified address in DRAM.
+        /// Writes a value to a specified address in DRAM, aligned or not.
         /// @param addr The memory address to write to.
-        /// @param value The data to write.
-        /// @param size The size of the data to write.
-        void write(AddrType addr, RegisterSizeType value, DataSizeType size);
-
-        /// Reads data from a specified address in DRAM.
+        /// @param value The data to write, as wide as the access.
+        template <MemoryValue T>
+        void write(AddrType addr, T value)
+        {
+            std::memcpy(at(addr, sizeof(T)), &value, sizeof(T));
+        }
+
+        /// Reads a value from a specified address in DRAM, aligned or not.
         /// @param addr The memory address to read from.
-        /// @param size The size of the data to read.
         /// @return The data read from the memory.
-        RegisterSizeType read(AddrType addr, DataSizeType size);
+        template <MemoryValue T>
+        T read(AddrType addr) const
+        {
+            T value;
+            std::memcpy(&value, at(addr, sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        /// Host address of the first DRAM byte.
+        std::byte *data() { return data_; }
+
+        /// Size of DRAM in bytes.
+        std::size_t size() const { return size_; }
+
+        /// What DRAM ended up backed by.
+        const char *describe() const { return backend_->describe(); }
+
+        /// Whether DRAM reads as zeros until written.
+        bool startsZeroed() const { return backend_->startsZeroed(); }
+
+        /// Host address of an access of size bytes at addr, nullptr if any of the bytes is
+        /// outside of DRAM.
+        std::byte *find(AddrType addr, std::size_t size)
+        {
+            // Addresses below DRAM_BASE wrap around to huge offsets.
+            const AddrType offset = addr - DRAM_BASE;
+            return offset <= size_ - size ? data_ + offset : nullptr;
+        }
+
+        const std::byte *find(AddrType addr, std::size_t size) const
+        {
+            return const_cast<DRAM *>(this)->find(addr, size);
+        }
 
       private:
-        MemoryType dram_;    /// The underlying storage for DRAM.
+        /// Host address of an access of size bytes at addr.
+        /// @throws const char * if any of the bytes is outside of DRAM.
+        std::byte *at(AddrType addr, std::size_t size)
+        {
+            std::byte *host = find(addr, size);
+            if (host == nullptr)
+                throw("Memory access outside of the memory\n");
+            return host;
+        }
+
+        const std::byte *at(AddrType addr, std::size_t size) const
+        {
+            return const_cast<DRAM *>(this)->at(addr, size);
+        }
+
+        std::unique_ptr<RamBackend> backend_;
+        std::byte *data_  = nullptr;    /// backend_->data(), read on every access.
+        std::size_t size_ = 0;          /// backend_->size().
+    };
+
+    /// How loading the program went.
+    struct LoadStats
+    {
+        u64 bytes = 0;    /// Size of the program.
+        u64 nanos = 0;    /// Time spent opening, mapping and copying it.
     };
 
     class SystemInterface
@@ -40,41 +112,69 @@ namespace rvemu
       public:
         /// Constructs a system interface and initializes the DRAM.
         /// @param codePath The file path to the binary code to load into memory.
-        SystemInterface(const std::string &codePath);
+        /// @param ram How to back the DRAM.
+        SystemInterface(const std::string &codePath, const RamConfig &ram);
 
-        /// Reads data from the system memory.
+        /// Reads a value from DRAM, or from the device mapped at addr.
         /// @param addr The memory address to read from.
-        /// @param size The size of the data to read.
         /// @return The data read from the memory.
-        RegisterSizeType readData(AddrType addr, DataSizeType size);
-
-        /// Writes data to the system memory.
+        template <MemoryValue T>
+        T read(AddrType addr) const
+        {
+            if (const std::byte *host = memory_.find(addr, sizeof(T))) [[likely]]
+            {
+                T value;
+                std::memcpy(&value, host, sizeof(T));
+                return value;
+            }
+            return static_cast<T>(mmio_.read(addr, sizeof(T)));
+        }
+
+        /// Writes a value to DRAM, or to the device mapped at addr.
         /// @param addr The memory address to write to.
-        /// @param value The data to write.
-        /// @param size The size of the data to write.
-        void writeData(AddrType addr, RegisterSizeType value, DataSizeType size);
+        /// @param value The data to write, as wide as the access.
+        template <MemoryValue T>
+        void write(AddrType addr, T value)
+        {
+            if (std::byte *host = memory_.find(addr, sizeof(T))) [[likely]]
+                std::memcpy(host, &value, sizeof(T));
+            else
+                mmio_.write(addr, sizeof(T), value);
+        }
+
+        /// Maps a device over size bytes from base, aborting if the range overlaps DRAM or
+        /// another device.
+        /// @return The device, owned by the bus.
+        Device &mapDevice(AddrType base, AddrType size, std::unique_ptr<Device> device);
 
         /// Retrieves the last executed instruction address.
         /// @return The address of the last executed instruction.
         RegisterSizeType getLastInstr() { return lastInst_; }
 
+        /// Retrieves the address the program starts at.
+        AddrType getEntry() const { return entry_; }
+
+        /// Retrieves the symbols of the program, empty for a flat binary.
+        const SymbolTable &getSymbols() const { return symbols_; }
+
+        /// Retrieves the DRAM backing the system memory.
+        DRAM &getDRAM() { return memory_; }
+
+        const LoadStats &getLoadStats() const { return loadStats_; }
+
       private:
-        /// Loads binary code into memory from a specified file path.
+        /// Loads binary code into memory from a specified file path, mapping the file and
+        /// copying it to DRAM in one go: the segments of an ELF executable, or a flat binary
+        /// to the start of DRAM.
         /// @param codePath The file path to the binary code to load.
         void loadCode(const std::string &codePath);
 
-        /// Checks if the given memory address is within the valid address space.
-        /// @param addr The memory address to check.
-        /// @return True if the address is within the limit; false otherwise.
-        bool checkLimit(AddrType addr);
-
-        /// Validates if writing to the given memory address is permitted.
-        /// @param addr The memory address to validate.
-        /// @return True if writing is valid; false otherwise.
-        bool validWrite(AddrType addr);
-
       private:
-        DRAM memory_;          /// The DRAM instance used by the system interface.
-        AddrType lastInst_;    /// The address of the last executed instruction.
+        DRAM memory_;            /// The DRAM instance used by the system interface.
+        AddrType lastInst_;      /// The address of the last executed instruction.
+        AddrType entry_;         /// The address of the first instruction.
+        SymbolTable symbols_;    /// The symbols of an ELF program.
+        LoadStats loadStats_;    /// How loading the program went.
+        MmioBus mmio_;           /// The devices, reached by the accesses outside of DRAM.
     };
 }    // namespace rvemu
@@ -0,0 +1,140 @@
+#include "Mmu.hpp"
+
+#include <atomic>
+
+namespace rvemu
+{
+    namespace
+    {
+        constexpr u64 SATP_MODE_SV39 = 8;
+
+        constexpr u8 SV39_LEVELS      = 3;
+        constexpr u8 VPN_BITS         = 9;    // Of each level
+        constexpr u64 PPN_MASK        = (1ULL << 44) - 1;
+        constexpr AddrType PTE_SIZE   = DoubleWord;
+        constexpr std::size_t PPN_LSB = 10;    // Of a page table entry
+
+        // Page table entry flags.
+        constexpr u64 PTE_V = 1 << 0;
+        constexpr u64 PTE_R = 1 << 1;
+        constexpr u64 PTE_W = 1 << 2;
+        constexpr u64 PTE_X = 1 << 3;
+        constexpr u64 PTE_U = 1 << 4;
+        constexpr u64 PTE_A = 1 << 6;
+        constexpr u64 PTE_D = 1 << 7;
+
+        constexpr const char *pageFault(AccessType type)
+        {
+            switch (type)
+            {
+                case AccessType::Fetch: return "Instruction page fault\n";
+                case AccessType::Load:  return "Load page fault\n";
+                case AccessType::Store: return "Store/AMO page fault\n";
+            }
+            return nullptr;
+        }
+    }    // namespace
+
+    void Mmu::configure(u64 satp, u64 mstatus, Mode mode)
+    {
+        mstatus &= MASK_MPRV | MASK_MPP | MASK_SUM | MASK_MXR;
+        if (satp == satp_ && mstatus == mstatus_ && mode == mode_)
+            return;
+        satp_    = satp;
+        mstatus_ = mstatus;
+        mode_    = mode;
+
+        const bool sv39 = satp >> 60 == SATP_MODE_SV39;
+        const bool mprv = mode == Machine && (mstatus & MASK_MPRV);
+        rootTable_      = (satp & PPN_MASK) << PAGE_SHIFT;
+        fetchMode_      = mode;
+        dataMode_       = mprv ? (mstatus & MASK_MPP) >> 11 : mode;
+        sum_            = mstatus & MASK_SUM;
+        mxr_            = mstatus & MASK_MXR;
+        translateFetch_ = sv39 && fetchMode_ != Machine;
+        translateData_  = sv39 && dataMode_ != Machine;
+        flush();
+    }
+
+    void Mmu::flush()
+    {
+        for (Tlb &tlb : tlbs_)
+            tlb.fill({});
+        ++stats_.flushes;
+    }
+
+    AddrType Mmu::walk(AddrType vaddr, AccessType type)
+    {
+        // Bits 63 to 39 must all be copies of bit 38.
+        if (static_cast<i64>(vaddr << 25) >> 25 != static_cast<i64>(vaddr))
+            throw(pageFault(type));
+
+        AddrType table = rootTable_;
+        for (int level = SV39_LEVELS - 1; level >= 0; --level)
+        {
+            const u64 vpn   = (vaddr >> (PAGE_SHIFT + level * VPN_BITS)) & ((1 << VPN_BITS) - 1);
+            std::byte *slot = hostAddress(table + vpn * PTE_SIZE, PTE_SIZE);
+            // Entries are aligned, and other harts may set their A and D bits meanwhile.
+            std::atomic_ref<u64> entry(*reinterpret_cast<u64 *>(slot));
+            u64 pte = entry.load(std::memory_order_relaxed);
+
+            if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W)))
+                throw(pageFault(type));
+
+            const u64 ppn = (pte >> PPN_LSB) & PPN_MASK;
+            if (!(pte & (PTE_R | PTE_X)))
+            {
+                table = ppn << PAGE_SHIFT;
+                continue;
+            }
+
+            // A leaf, a superpage above the last level: its low page numbers come from vaddr.
+            const u64 lowPages = (1ULL << (level * VPN_BITS)) - 1;
+            if (!allows(pte, type) || (ppn & lowPages) != 0)
+                throw(pageFault(type));
+
+            const u64 used = PTE_A | (type == AccessType::Store ? PTE_D : 0);
+            if ((pte & used) != used)
+                entry.fetch_or(used, std::memory_order_relaxed);
+            return (ppn | ((vaddr >> PAGE_SHIFT) & lowPages)) << PAGE_SHIFT;
+        }
+        throw(pageFault(type));
+    }
+
+    bool Mmu::allows(u64 pte, AccessType type) const
+    {
+        const Mode mode = type == AccessType::Fetch ? fetchMode_ : dataMode_;
+        if (pte & PTE_U)
+        {
+            // Supervisor code never runs from user pages, and only touches them if SUM is set.
+            if (mode == Supervisor && (type == AccessType::Fetch || !sum_))
+                return false;
+        }
+        else if (mode == User)
+            return false;
+
+        switch (type)
+        {
+            case AccessType::Fetch: return pte & PTE_X;
+            case AccessType::Load:  return (pte & PTE_R) || (mxr_ && (pte & PTE_X));
+            case AccessType::Store: return pte & PTE_W;
+        }
+        return false;
+    }
+
+    std::byte *Mmu::hostPage(AddrType page) const
+    {
+        const AddrType offset = page - DRAM_BASE;
+        return offset < memorySize_ && PAGE_SIZE <= memorySize_ - offset ? memory_ + offset
+                                                                         : nullptr;
+    }
+
+    std::byte *Mmu::hostAddress(AddrType paddr, std::size_t size) const
+    {
+        // Addresses below DRAM_BASE wrap around to huge offsets.
+        const AddrType offset = paddr - DRAM_BASE;
+        if (offset > memorySize_ || size > memorySize_ - offset)
+            throw("Memory access outside of the memory\n");
+        return memory_ + offset;
+    }
+}    // namespace rvemu
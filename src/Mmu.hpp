@@ -0,0 +1,182 @@
+#pragma once
+
+#include "Memory.hpp"
+#include "RVEmu.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+namespace rvemu
+{
+    /// Why the guest accesses memory. Each type has a TLB of its own.
+    enum class AccessType : u8 {
+        Fetch,
+        Load,
+        Store,
+    };
+
+    constexpr std::size_t ACCESS_TYPE_COUNT = 3;
+
+    /// What the TLBs of an Mmu did, indexed by AccessType.
+    struct TlbStats
+    {
+        std::array<u64, ACCESS_TYPE_COUNT> hits {};
+        std::array<u64, ACCESS_TYPE_COUNT> misses {};    /// Each one walked the page table.
+        u64 flushes = 0;
+    };
+
+    /// Sv39 address translation of a hart, with a direct-mapped software TLB per access type.
+    ///
+    /// An entry maps a virtual page to the host address of the physical page behind it, so
+    /// a hit is a tag compare away from a plain host load or store. Entries are only filled
+    /// once the page table allowed the access in the current privilege mode, hits skip every
+    /// check: whatever may change that outcome (satp, mstatus, the privilege mode or an
+    /// sfence.vma) drops them all. Superpages are cached one 4 KiB page at a time. Pages outside
+    /// of DRAM have no host address, their accesses go through the bus.
+    class Mmu
+    {
+      public:
+        static constexpr u8 PAGE_SHIFT           = 12;
+        static constexpr AddrType PAGE_SIZE      = 1 << PAGE_SHIFT;
+        static constexpr std::size_t TLB_ENTRIES = 256;    /// Entries of each TLB.
+
+        /// Physical pages have to be in DRAM.
+        explicit Mmu(DRAM &dram) : memory_(dram.data()), memorySize_(dram.size()) { }
+
+        /// Takes the translation settings of satp and mstatus for a hart running in mode,
+        /// dropping every cached translation if they changed. After a page table change
+        /// only sfence.vma drops them.
+        void configure(u64 satp, u64 mstatus, Mode mode);
+
+        /// Drops every cached translation (sfence.vma).
+        void flush();
+
+        /// Whether instruction fetches go through the page table.
+        bool translatesFetch() const { return translateFetch_; }
+
+        /// Whether loads and stores go through the page table.
+        bool translatesData() const { return translateData_; }
+
+        /// Whether an access of size bytes at addr spans two pages.
+        static constexpr bool crossesPage(AddrType addr, std::size_t size)
+        {
+            return (addr & (PAGE_SIZE - 1)) + size > PAGE_SIZE;
+        }
+
+        /// Returns the physical address of a virtual one.
+        /// @throws const char * on a page fault.
+        template <AccessType A>
+        AddrType translate(AddrType vaddr)
+        {
+            return lookup<A>(vaddr).page + (vaddr & (PAGE_SIZE - 1));
+        }
+
+        /// Reads a value at a virtual address, the access may span two pages. Pages of
+        /// devices are read through the bus.
+        /// @throws const char * on a page fault, or if no device holds the access.
+        template <MemoryValue T>
+        T read(AddrType vaddr, const SystemInterface &bus)
+        {
+            T value;
+            if (crossesPage(vaddr, sizeof(T))) [[unlikely]]
+            {
+                std::array<u8, sizeof(T)> bytes;
+                for (std::size_t i = 0; i < sizeof(T); ++i)
+                    bytes[i] = read<u8>(vaddr + i, bus);
+                std::memcpy(&value, bytes.data(), sizeof(T));
+                return value;
+            }
+
+            const TlbEntry &entry = lookup<AccessType::Load>(vaddr);
+            const AddrType offset = vaddr & (PAGE_SIZE - 1);
+            if (entry.host == nullptr) [[unlikely]]
+                return bus.read<T>(entry.page + offset);
+            std::memcpy(&value, entry.host + offset, sizeof(T));
+            return value;
+        }
+
+        /// Writes a value at a virtual address inside one page. Pages of devices are written
+        /// through the bus.
+        /// @return The physical address written.
+        /// @throws const char * on a page fault, or if no device holds the access.
+        template <MemoryValue T>
+        AddrType write(AddrType vaddr, T value, SystemInterface &bus)
+        {
+            const TlbEntry &entry = lookup<AccessType::Store>(vaddr);
+            const AddrType offset = vaddr & (PAGE_SIZE - 1);
+            if (entry.host == nullptr) [[unlikely]]
+                bus.write<T>(entry.page + offset, value);
+            else
+                std::memcpy(entry.host + offset, &value, sizeof(T));
+            return entry.page + offset;
+        }
+
+        const TlbStats &getStats() const { return stats_; }
+
+      private:
+        static constexpr AddrType INVALID_VPN = ~0ULL;    /// No virtual page number is that high.
+
+        struct TlbEntry
+        {
+            AddrType vpn    = INVALID_VPN;    /// Virtual page number, the tag.
+            AddrType page   = 0;              /// Physical address of the page.
+            std::byte *host = nullptr;        /// Host address of the page, nullptr for devices.
+        };
+
+        using Tlb = std::array<TlbEntry, TLB_ENTRIES>;
+
+        /// Returns the TLB entry of the page holding vaddr, walking the page table on a miss.
+        template <AccessType A>
+        const TlbEntry &lookup(AddrType vaddr)
+        {
+            constexpr auto type = static_cast<std::size_t>(A);
+
+            const AddrType vpn = vaddr >> PAGE_SHIFT;
+            TlbEntry &entry    = tlbs_[type][vpn % TLB_ENTRIES];
+            if (entry.vpn == vpn) [[likely]]
+            {
+                ++stats_.hits[type];
+                return entry;
+            }
+
+            ++stats_.misses[type];
+            const AddrType page = walk(vaddr, A);
+            entry               = {vpn, page, hostPage(page)};
+            return entry;
+        }
+
+        /// Walks the page table, setting the accessed and dirty bits of the leaf as needed.
+        /// @return The physical address of the page holding vaddr.
+        /// @throws const char * on a page fault.
+        AddrType walk(AddrType vaddr, AccessType type);
+
+        /// Whether a leaf entry allows the access.
+        bool allows(u64 pte, AccessType type) const;
+
+        /// Host address of a physical page, nullptr if it is not all in DRAM.
+        std::byte *hostPage(AddrType page) const;
+
+        /// Host address of size bytes of physical memory.
+        /// @throws const char * if any of them is outside of DRAM.
+        std::byte *hostAddress(AddrType paddr, std::size_t size) const;
+
+        std::byte *memory_;         /// Host address of DRAM.
+        std::size_t memorySize_;    /// Size of DRAM in bytes.
+
+        std::array<Tlb, ACCESS_TYPE_COUNT> tlbs_ {};
+        TlbStats stats_;
+
+        // The translation settings, as configure() found them.
+        u64 satp_            = 0;
+        u64 mstatus_         = 0;          /// Only the bits translation depends on.
+        Mode mode_           = Machine;
+        AddrType rootTable_  = 0;          /// Physical address of the root page table.
+        Mode fetchMode_      = Machine;    /// Privilege of instruction fetches.
+        Mode dataMode_       = Machine;    /// Privilege of loads and stores, MPRV applied.
+        bool sum_            = false;      /// Supervisor may access user pages.
+        bool mxr_            = false;      /// Executable pages are readable.
+        bool translateFetch_ = false;
+        bool translateData_  = false;
+    };
+}    // namespace rvemu
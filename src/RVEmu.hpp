@@ -8,10 +8,27 @@ namespace rvemu
 {
     constexpr std::size_t DRAM_BASE = 0x8000'0000;
 
-    // define the size of DRAM => 128MB
-    constexpr std::size_t DRAM_SIZE = 1024 * 1024 * 128;
+    // Core-local interruptor: msip, mtimecmp and mtime.
+    constexpr std::size_t CLINT_BASE = 0x200'0000;
+    constexpr std::size_t CLINT_SIZE = 0x1'0000;
 
-    constexpr std::size_t DRAM_END = DRAM_BASE + DRAM_SIZE - 1;
+    // Platform-level interrupt controller, and the console UART behind its source UART_IRQ.
+    constexpr std::size_t PLIC_BASE = 0xc00'0000;
+    constexpr std::size_t PLIC_SIZE = 0x400'0000;
+    constexpr std::size_t UART_BASE = 0x1000'0000;
+    constexpr std::size_t UART_SIZE = 0x100;
+    constexpr uint32_t UART_IRQ     = 10;
+
+    // virtio-mmio block device, if the emulator is given a disk.
+    constexpr std::size_t VIRTIO_BASE = 0x1000'1000;
+    constexpr std::size_t VIRTIO_SIZE = 0x1000;
+    constexpr uint32_t VIRTIO_IRQ     = 1;
+
+    // Size of DRAM unless the emulator is given another one => 128MB
+    constexpr std::size_t DEFAULT_DRAM_SIZE = 1024 * 1024 * 128;
+
+    // Stack of each hart at the top of DRAM: hart n starts with sp n stacks below hart 0 => 64KB
+    constexpr std::size_t HART_STACK_SIZE = 1024 * 64;
 
     constexpr uint16_t NUM_CSRS = 4096;
 
@@ -41,7 +58,7 @@ namespace rvemu
     using CSRRegisterSizeType = uint64_t;
     using RegType             = std::array<RegisterSizeType, RegistersNumber>;
 
-    enum RegisterIndex : std::size_t { Zero = 0, RA = 1, SP = 2 };
+    enum RegisterIndex : std::size_t { Zero = 0, RA = 1, SP = 2, A0 = 10 };
 
     enum DataSizeType { Byte = 1, HalfWord = 2, Word = 4, DoubleWord = 8 };
 
@@ -123,5 +140,7 @@ namespace rvemu
     constexpr uint64_t MASK_MTIP = 1 << 7;
     constexpr uint64_t MASK_SEIP = 1 << 9;
     constexpr uint64_t MASK_MEIP = 1 << 11;
+    // Driven by the CLINT and the PLIC through the interrupt lines, read-only to csr writes
+    constexpr uint64_t MASK_LINES_IP = MASK_MSIP | MASK_MTIP | MASK_SEIP | MASK_MEIP;
 
 }    // namespace rvemu
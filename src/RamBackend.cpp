@@ -0,0 +1,206 @@
+#include "RamBackend.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rvemu
+{
+    namespace
+    {
+        constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+        constexpr std::size_t roundUp(std::size_t value, std::size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        [[noreturn]] void fail(const std::string &what)
+        {
+            std::cerr << "Cannot back DRAM: " << what << ": " << std::strerror(errno) << "\n";
+            abort();
+        }
+
+        /// Maps length bytes of zero pages, committed on first touch.
+        /// @param flags By default MAP_NORESERVE: untouched pages cost neither memory nor swap.
+        void *mapAnonymous(std::size_t length, int flags = MAP_NORESERVE)
+        {
+            return mmap(nullptr,
+                        length,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | flags,
+                        -1,
+                        0);
+        }
+
+        class AnonymousRam : public RamBackend
+        {
+          public:
+            explicit AnonymousRam(std::size_t size) : RamBackend(size)
+            {
+                void *mapping = mapAnonymous(size);
+                if (mapping == MAP_FAILED)
+                    fail("mmap");
+                adopt(mapping, size);
+            }
+
+            const char *describe() const override { return "anonymous"; }
+        };
+
+        class HugePageRam : public RamBackend
+        {
+          public:
+            explicit HugePageRam(std::size_t size) : RamBackend(size)
+            {
+                // Reserving the huge pages up front fails now rather than faulting on a touch
+                // when the pool runs out.
+                const std::size_t length = roundUp(size, HUGE_PAGE_SIZE);
+                void *mapping            = mapAnonymous(length, MAP_HUGETLB);
+                if (mapping != MAP_FAILED)
+                {
+                    reserved_ = true;
+                    adopt(mapping, length);
+                    return;
+                }
+
+                // No huge page reserved: align ordinary pages so the kernel can merge them.
+                auto *reserve = static_cast<std::byte *>(mapAnonymous(length + HUGE_PAGE_SIZE));
+                if (reserve == MAP_FAILED)
+                    fail("mmap");
+                auto *start = reinterpret_cast<std::byte *>(
+                    roundUp(reinterpret_cast<std::uintptr_t>(reserve), HUGE_PAGE_SIZE));
+                if (start != reserve)
+                    munmap(reserve, start - reserve);
+                munmap(start + length, reserve + HUGE_PAGE_SIZE - start);
+                madvise(start, length, MADV_HUGEPAGE);
+                adopt(start, length);
+            }
+
+            const char *describe() const override
+            {
+                return reserved_ ? "reserved huge pages" : "transparent huge pages";
+            }
+
+          private:
+            bool reserved_ = false;
+        };
+
+        /// Opens a file, aborting if it cannot be.
+        class FileDescriptor
+        {
+          public:
+            FileDescriptor(const std::string &path, int flags)
+              : fd_(open(path.c_str(), flags, 0644))
+            {
+                if (fd_ < 0)
+                    fail(path);
+            }
+
+            ~FileDescriptor() { close(fd_); }
+
+            FileDescriptor(const FileDescriptor &)             = delete;
+            FileDescriptor &operator= (const FileDescriptor &) = delete;
+
+            operator int () const { return fd_; }
+
+            std::size_t size(const std::string &path) const
+            {
+                struct stat st;
+                if (fstat(fd_, &st) != 0)
+                    fail(path);
+                return st.st_size;
+            }
+
+          private:
+            int fd_;
+        };
+
+        class FileRam : public RamBackend
+        {
+          public:
+            explicit FileRam(const RamConfig &config) : RamBackend(config.size)
+            {
+                FileDescriptor fd(config.path, O_RDWR | O_CREAT);
+                // A sparse extension, pages never written take no space in the file either.
+                if (fd.size(config.path) < config.size && ftruncate(fd, config.size) != 0)
+                    fail(config.path);
+
+                void *mapping =
+                    mmap(nullptr, config.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (mapping == MAP_FAILED)
+                    fail(config.path);
+                adopt(mapping, config.size);
+            }
+
+            const char *describe() const override { return "file"; }
+
+            bool startsZeroed() const override { return false; }
+        };
+
+        class ImageRam : public RamBackend
+        {
+          public:
+            explicit ImageRam(const RamConfig &config) : RamBackend(config.size)
+            {
+                FileDescriptor fd(config.path, O_RDONLY);
+                const std::size_t imageSize = fd.size(config.path);
+                if (imageSize > config.size)
+                {
+                    std::cerr << "Cannot back DRAM: " << config.path << " is larger than DRAM\n";
+                    abort();
+                }
+
+                // Zero pages past the image, which is copied page by page as the guest writes.
+                void *mapping = mapAnonymous(config.size);
+                if (mapping == MAP_FAILED)
+                    fail("mmap");
+                adopt(mapping, config.size);
+
+                constexpr int flags = MAP_PRIVATE | MAP_FIXED;
+                if (imageSize != 0
+                    && mmap(mapping, imageSize, PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED)
+                    fail(config.path);
+            }
+
+            const char *describe() const override { return "image"; }
+
+            bool startsZeroed() const override { return false; }
+        };
+    }    // namespace
+
+    std::unique_ptr<RamBackend> RamBackend::create(const RamConfig &config)
+    {
+        if (config.size < DoubleWord)
+        {
+            std::cerr << "Cannot back DRAM: " << config.size << " bytes is too small\n";
+            abort();
+        }
+
+        switch (config.kind)
+        {
+            case RamKind::Anonymous: return std::make_unique<AnonymousRam>(config.size);
+            case RamKind::HugePages: return std::make_unique<HugePageRam>(config.size);
+            case RamKind::File:      return std::make_unique<FileRam>(config);
+            case RamKind::Image:     return std::make_unique<ImageRam>(config);
+        }
+        return nullptr;
+    }
+
+    RamBackend::~RamBackend()
+    {
+        if (data_ != nullptr)
+            munmap(data_, length_);
+    }
+
+    void RamBackend::adopt(void *mapping, std::size_t length)
+    {
+        data_   = static_cast<std::byte *>(mapping);
+        length_ = length;
+    }
+}    // namespace rvemu
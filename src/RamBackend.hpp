@@ -0,0 +1,65 @@
+#pragma once
+
+#include "RVEmu.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace rvemu
+{
+    /// Where the host memory behind DRAM comes from.
+    enum class RamKind : u8 {
+        Anonymous,    // Zero pages mapped on first touch
+        HugePages,    // The same with huge pages: reserved ones if any, transparent otherwise
+        File,         // A file mapped shared, which keeps the final memory of the run
+        Image,        // A prepared memory image mapped private, the file is never written
+    };
+
+    /// How DRAM is backed.
+    struct RamConfig
+    {
+        RamKind kind     = RamKind::Anonymous;
+        std::size_t size = DEFAULT_DRAM_SIZE;    /// Size of DRAM in bytes, at least 8.
+        std::string path;                        /// The file of the File and Image kinds.
+    };
+
+    /// Host memory holding DRAM.
+    ///
+    /// Backends only differ in how the memory is mapped: DRAM accesses all of them through
+    /// the same pointer, the mapping is released with the backend.
+    class RamBackend
+    {
+      public:
+        /// Maps the memory a configuration describes, aborting if the host cannot.
+        static std::unique_ptr<RamBackend> create(const RamConfig &config);
+
+        virtual ~RamBackend();
+
+        RamBackend(const RamBackend &)             = delete;
+        RamBackend &operator= (const RamBackend &) = delete;
+
+        /// Host address of the first DRAM byte.
+        std::byte *data() const { return data_; }
+
+        /// Size of DRAM in bytes.
+        std::size_t size() const { return size_; }
+
+        /// What the memory ended up backed by.
+        virtual const char *describe() const = 0;
+
+        /// Whether DRAM reads as zeros until written, so loading needs no clearing.
+        virtual bool startsZeroed() const { return true; }
+
+      protected:
+        explicit RamBackend(std::size_t size) : size_(size) { }
+
+        /// Takes ownership of a mapping of length bytes, DRAM starting at its first byte.
+        void adopt(void *mapping, std::size_t length);
+
+      private:
+        std::byte *data_    = nullptr;
+        std::size_t size_   = 0;
+        std::size_t length_ = 0;    /// Length of the mapping, which may exceed size_.
+    };
+}    // namespace rvemu
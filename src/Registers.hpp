@@ -19,10 +19,11 @@ namespace rvemu
         static std::string getABIName(std::size_t index);
 
       public:
-        Registers() : registers_ {0}
+        /// @param stackTop The initial value of sp.
+        explicit Registers(AddrType stackTop) : registers_ {0}
         {
             registers_[RegisterIndex::Zero] = 0;
-            registers_[RegisterIndex::SP]   = DRAM_END;
+            registers_[RegisterIndex::SP]   = stackTop;
         }
 
         void write(std::size_t regIdx, RegisterSizeType what)
@@ -34,6 +35,9 @@ namespace rvemu
 
         RegisterSizeType read(std::size_t regIdx) const { return registers_[regIdx]; }
 
+        /// The register file as an array, x0 must never be written through it.
+        RegisterSizeType *data() { return registers_.data(); }
+
       private:
         RegType registers_;
     };
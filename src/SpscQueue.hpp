@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace rvemu
+{
+    /// Bounded lock-free queue between exactly one producer thread and one consumer thread.
+    ///
+    /// head_ is only written by the consumer and tail_ only by the producer, each side
+    /// publishes its slot with a release store the other side reads with an acquire load.
+    template <typename T, std::size_t N>
+    class SpscQueue
+    {
+        static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+
+      public:
+        /// Appends a value, producer side.
+        /// @return False if the queue is full, value is left untouched then.
+        bool push(T &&value)
+        {
+            const std::size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == N)
+                return false;
+
+            slots_[tail % N] = std::move(value);
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /// Removes the oldest value, consumer side.
+        std::optional<T> pop()
+        {
+            const std::size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return std::nullopt;
+
+            std::optional<T> value {std::move(slots_[head % N])};
+            head_.store(head + 1, std::memory_order_release);
+            return value;
+        }
+
+        /// Number of queued values, exact only on the consumer or producer thread.
+        std::size_t size() const
+        {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+
+      private:
+        std::array<T, N> slots_ {};
+
+        // Separate cache lines, so the two sides do not bounce one line between them.
+        alignas(64) std::atomic<std::size_t> head_ {0};
+        alignas(64) std::atomic<std::size_t> tail_ {0};
+    };
+}    // namespace rvemu
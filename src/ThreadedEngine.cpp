@@ -0,0 +1,162 @@
+#include "ThreadedEngine.hpp"
+
+#include "BlockOptimizer.hpp"
+#include "Cpu.hpp"
+#include "DecodeCache.hpp"
+#include "Interpreter.hpp"
+
+#include <array>
+#include <utility>
+
+namespace rvemu
+{
+    namespace
+    {
+        template <InstKind K>
+        AddrType threadedOp(CPU &cpu, const ThreadedOp *op)
+        {
+            AddrType next;
+            try
+            {
+                next = Interpreter::execute<K>(cpu, op->inst, op->pc);
+            }
+            catch (const char *)
+            {
+                // The hart stops at the instruction that raised the exception.
+                cpu.setPC(op->pc);
+                throw;
+            }
+            if constexpr (ThreadedEngine::endsBlock(K))
+                return next;
+
+            // The store may have rewritten the rest of this block.
+            if constexpr (isStore(K) || isAtomic(K))
+            {
+                if (cpu.getBlockCache().hasDropped())
+                    return next;
+            }
+
+            return op[1].handler(cpu, op + 1);
+        }
+
+        AddrType exitOp(CPU &, const ThreadedOp *op) { return op->pc; }
+
+        template <std::size_t... Kinds>
+        constexpr std::array<ThreadedHandler, INST_KIND_COUNT>
+        makeHandlers(std::index_sequence<Kinds...>)
+        {
+            return {&threadedOp<static_cast<InstKind>(Kinds)>...};
+        }
+
+        constexpr std::array<ThreadedHandler, INST_KIND_COUNT> handlers =
+            makeHandlers(std::make_index_sequence<INST_KIND_COUNT> {});
+    }    // namespace
+
+    std::unique_ptr<TranslatedBlock> ThreadedEngine::translate(CPU &cpu, AddrType pc)
+    {
+        auto block     = std::make_unique<TranslatedBlock>();
+        block->startPC = pc;
+
+        const AddrType pageEnd = (pc | (DecodeCache::PAGE_SIZE - 1)) + 1;
+        AddrType addr          = pc;
+        while (block->ops.size() < MAX_BLOCK_INSTS && addr < pageEnd
+               && addr < cpu.getLastInstAddr())
+        {
+            const DecodedInst inst = cpu.decodeAt(addr);
+            block->ops.push_back({nullptr, inst, addr});
+            addr += instLength(inst.kind);
+
+            if (endsBlock(inst.kind))
+                break;
+        }
+
+        BlockOptimizer::optimize(block->ops);
+        for (ThreadedOp &op : block->ops)
+            op.handler = handlers[static_cast<std::size_t>(op.inst.kind)];
+
+        block->endPC = addr;
+        block->ops.push_back({exitOp, {}, addr});
+
+        block->exits.reserve(TranslatedBlock::MAX_EXITS);
+        // The optimizer may have removed every instruction, a branch never taken included.
+        const ThreadedOp *last =
+            block->ops.size() > 1 ? &block->ops[block->ops.size() - 2] : nullptr;
+        if (last == nullptr || !endsBlock(last->inst.kind))
+            block->exits.push_back({ExitKind::Direct, addr});
+        else if (last->inst.kind == InstKind::Jal)
+            block->exits.push_back({ExitKind::Direct, last->pc + last->inst.imm});
+        else if (last->inst.kind == InstKind::AuipcJalr)
+            block->exits.push_back({ExitKind::Direct, (last->pc + last->inst.imm) & ~1ULL});
+        else if (last->inst.kind == InstKind::Jalr)
+            block->exits.push_back({ExitKind::Indirect, 0});
+        else if ((last->inst.kind >= InstKind::Beq && last->inst.kind <= InstKind::Bgeu)
+                 || (last->inst.kind >= InstKind::SltBnez && last->inst.kind <= InstKind::SltuBeqz))
+        {
+            block->exits.push_back({ExitKind::Direct, last->pc + last->inst.imm});
+            block->exits.push_back({ExitKind::Direct, addr});
+        }
+        return block;
+    }
+
+    void ThreadedEngine::run(CPU &cpu)
+    {
+        BlockCache &cache = cpu.getBlockCache();
+        // Exit of the previous block that led to pc, if it can be chained.
+        BlockExit *taken = nullptr;
+        while (!cpu.shouldStop())
+        {
+            const AddrType pc      = cpu.getPC();
+            TranslatedBlock *block = nullptr;
+            if (taken != nullptr && taken->linked != nullptr && taken->linked->startPC == pc)
+                block = taken->linked;
+            else
+            {
+                block = cache.lookup(pc);
+                if (block == nullptr)
+                    block = cache.insert(translate(cpu, pc));
+                if (taken != nullptr)
+                    cache.link(*taken, block);
+            }
+
+            if (!cpu.canRunBlock(block->startPC, block->endPC))
+            {
+                // The run stops inside the block.
+                cpu.step();
+                taken = nullptr;
+            }
+            else
+            {
+                const AddrType next = runOps(cpu, *block);
+                taken               = cache.hasDropped() ? nullptr : block->exitTo(next);
+            }
+            cache.releaseDropped();
+
+            if (cpu.isTracing())
+                cpu.dumpState();
+        }
+    }
+
+    AddrType ThreadedEngine::runOps(CPU &cpu, const TranslatedBlock &block)
+    {
+        AddrType next;
+        try
+        {
+            next = block.ops.front().handler(cpu, block.ops.data());
+        }
+        catch (const char *)
+        {
+            // The op raising the exception set the pc to its own, the ones before it ran.
+            cpu.retire((cpu.getPC() - block.startPC) / DataSizeType::Word);
+            throw;
+        }
+        cpu.setPC(next);
+        cpu.retire(executedInsts(block, next, cpu.getBlockCache().hasDropped()));
+        return next;
+    }
+
+    u64 ThreadedEngine::executedInsts(const TranslatedBlock &block, AddrType next, bool dropped)
+    {
+        // A store dropping the block stops it right after the store.
+        return ((dropped ? next : block.endPC) - block.startPC) / DataSizeType::Word;
+    }
+}    // namespace rvemu
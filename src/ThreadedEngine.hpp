@@ -0,0 +1,88 @@
+#pragma once
+
+#include "BlockCache.hpp"
+#include "Decoder.hpp"
+#include "RVEmu.hpp"
+
+#include <memory>
+
+namespace rvemu
+{
+    class CPU;
+
+    /// Execution engine running translated basic blocks with direct-threaded dispatch.
+    ///
+    /// A block is discovered from the decode cache, it ends at the first control transfer or
+    /// trap-like instruction (branch, jal, jalr, ecall/ebreak, sret/mret, fence.i, a CSR access
+    /// since it may turn address translation on, or a fused pair ending with one of them), at
+    /// a page boundary or at the end of the program. Each instruction becomes a ThreadedOp
+    /// whose handler tail-calls the next one, so the dispatch loop only runs once per block.
+    ///
+    /// Block exits are chained to the block they led to the first time they are taken, and a
+    /// jalr exit remembers its last target, so hot transfers skip the block lookup.
+    class ThreadedEngine
+    {
+      public:
+        /// Maximum number of ops in a block.
+        static constexpr std::size_t MAX_BLOCK_INSTS = 64;
+        /// Maximum number of guest instructions in a block, counting both halves of fused pairs.
+        static constexpr std::size_t MAX_BLOCK_WORDS = 2 * MAX_BLOCK_INSTS;
+
+        /// Runs the program on the given hart until the run has to stop. A block is only
+        /// dispatched if it cannot go over the instruction budget or past the stop pc, the
+        /// interpreter steps through it otherwise.
+        static void run(CPU &cpu);
+
+        /// Whether a block ends after an instruction of the given kind.
+        static constexpr bool endsBlock(InstKind kind)
+        {
+            switch (kind)
+            {
+                case InstKind::Jal:
+                case InstKind::Jalr:
+                case InstKind::Beq:
+                case InstKind::Bne:
+                case InstKind::Blt:
+                case InstKind::Bge:
+                case InstKind::Bltu:
+                case InstKind::Bgeu:
+                case InstKind::FenceI:
+                case InstKind::Ecall:
+                case InstKind::Ebreak:
+                case InstKind::Sret:
+                case InstKind::Mret:
+                case InstKind::Wfi:
+                case InstKind::Csrrw:
+                case InstKind::Csrrs:
+                case InstKind::Csrrc:
+                case InstKind::Csrrwi:
+                case InstKind::Csrrsi:
+                case InstKind::Csrrci:
+                case InstKind::Illegal:
+                case InstKind::Undecoded:
+                case InstKind::AuipcJalr:
+                case InstKind::SltBnez:
+                case InstKind::SltBeqz:
+                case InstKind::SltuBnez:
+                case InstKind::SltuBeqz:  return true;
+
+                default: return false;
+            }
+        }
+
+        /// Translates the block starting at pc.
+        static std::unique_ptr<TranslatedBlock> translate(CPU &cpu, AddrType pc);
+
+        /// Runs the threaded ops of a block, then sets the pc to where they went and retires
+        /// what they executed. An op raising an exception leaves the pc at its instruction,
+        /// with the ones before it retired, as the interpreter would.
+        /// @return The address the ops returned.
+        /// @throws const char * as the ops do.
+        static AddrType runOps(CPU &cpu, const TranslatedBlock &block);
+
+        /// Number of guest instructions a run of the threaded ops of a block executed.
+        /// @param next The address the ops returned.
+        /// @param dropped Whether a block was dropped meanwhile.
+        static u64 executedInsts(const TranslatedBlock &block, AddrType next, bool dropped);
+    };
+}    // namespace rvemu
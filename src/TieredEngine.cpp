@@ -0,0 +1,195 @@
+#include "TieredEngine.hpp"
+
+#include "Cpu.hpp"
+#include "DecodeCache.hpp"
+#include "ThreadedEngine.hpp"
+#include "jit/BackgroundCompiler.hpp"
+#include "jit/JitEngine.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace rvemu
+{
+    TieredEngine::TieredEngine(const TierConfig &config) : config_(config) { }
+
+    TieredEngine::~TieredEngine() = default;
+
+    void TieredEngine::run(CPU &cpu)
+    {
+        BlockCache &cache = cpu.getBlockCache();
+        if (jit_ != nullptr)
+            jit_->attach(cpu);
+
+        // Exit of the previous block that led to pc, if it can be chained.
+        BlockExit *taken = nullptr;
+        while (!cpu.shouldStop())
+        {
+            if (compiler_ != nullptr && installCompiled(cpu))
+                taken = nullptr;
+
+            const AddrType pc      = cpu.getPC();
+            TranslatedBlock *block = JitEngine::follow(taken, pc);
+            if (block == nullptr)
+            {
+                block = cache.lookup(pc);
+                if (block == nullptr && ++hotness_[pc] >= config_.warmThreshold)
+                {
+                    hotness_.erase(pc);
+                    block = cache.insert(ThreadedEngine::translate(cpu, pc));
+                    ++stats_.translated;
+                }
+                if (block != nullptr && taken != nullptr)
+                    JitEngine::link(cache, *taken, block);
+            }
+
+            if (block == nullptr || !cpu.canRunBlock(block->startPC, block->endPC))
+            {
+                interpretBlock(cpu);
+                taken = nullptr;
+            }
+            else
+            {
+                if (block->native == nullptr && block->executions++ == config_.hotThreshold
+                    && !promote(cpu, *block))
+                {
+                    // Making room for the code dropped every block, block included.
+                    taken = nullptr;
+                    continue;
+                }
+
+                if (block->native != nullptr)
+                {
+                    taken = jit_->execute(cpu, *block);
+                    ++stats_.nativeRuns;
+                }
+                else
+                {
+                    const AddrType next = ThreadedEngine::runOps(cpu, *block);
+                    taken               = block->exitTo(next);
+                    ++stats_.threadedRuns;
+                }
+            }
+
+            if (cache.hasDropped())
+            {
+                taken = nullptr;
+                if (jit_ != nullptr)
+                    jit_->blocksDropped();
+                cache.releaseDropped();
+            }
+
+            if (cpu.isTracing())
+                cpu.dumpState();
+        }
+    }
+
+    void TieredEngine::interpretBlock(CPU &cpu)
+    {
+        const AddrType pageEnd = (cpu.getPC() | (DecodeCache::PAGE_SIZE - 1)) + 1;
+        for (std::size_t count = 0; count < ThreadedEngine::MAX_BLOCK_INSTS; ++count)
+        {
+            const DecodedInst inst = cpu.step();
+            stats_.interpretedInsts += instLength(inst.kind) / DataSizeType::Word;
+
+            if (ThreadedEngine::endsBlock(inst.kind) || cpu.getPC() >= pageEnd
+                || cpu.shouldStop())
+                break;
+        }
+    }
+
+    bool TieredEngine::promote(CPU &cpu, TranslatedBlock &block)
+    {
+        if (jit_ == nullptr)
+        {
+            jit_ = std::make_unique<JitEngine>();
+            jit_->attach(cpu);
+            if (config_.backgroundCompile)
+                compiler_ = std::make_unique<BackgroundCompiler>(*jit_);
+        }
+
+        if (compiler_ != nullptr)
+        {
+            // Retried once the block is as hot again if the compiler is swamped.
+            if (!compiler_->submit(block))
+                block.executions = 0;
+            stats_.maxQueueDepth = std::max(stats_.maxQueueDepth, compiler_->pending());
+            return true;
+        }
+
+        if (!jit_->hasRoom())
+        {
+            recycle(cpu);
+            return false;
+        }
+
+        cpu.getBlockCache().unlinkExits(block);
+        const auto start = std::chrono::steady_clock::now();
+        block.native     = jit_->compile(block);
+        recordCompile(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count());
+        if (block.native != nullptr)
+            ++stats_.compiled;
+        return true;
+    }
+
+    bool TieredEngine::installCompiled(CPU &cpu)
+    {
+        BlockCache &cache = cpu.getBlockCache();
+        bool changed      = false;
+        bool full         = false;
+        while (auto job = compiler_->poll())
+        {
+            recordCompile(job->compileNanos);
+            if (job->noRoom)
+            {
+                full = true;
+                continue;
+            }
+
+            // The block may have been dropped, and its start translated again, meanwhile.
+            TranslatedBlock *block = cache.lookup(job->block.startPC);
+            if (block == nullptr || block->id != job->blockId || block->native != nullptr)
+            {
+                ++stats_.staleCompiles;
+                continue;
+            }
+            if (job->block.native == nullptr)
+                continue;
+
+            cache.unlinkExits(*block);
+            block->exits      = std::move(job->block.exits);
+            block->native     = job->block.native;
+            block->chainEntry = job->block.chainEntry;
+            ++stats_.compiled;
+            changed = true;
+        }
+
+        if (full)
+        {
+            recycle(cpu);
+            changed = true;
+        }
+        return changed;
+    }
+
+    void TieredEngine::recycle(CPU &cpu)
+    {
+        if (compiler_ != nullptr)
+        {
+            // Code finished meanwhile lives in the arena about to be emptied.
+            compiler_->quiesce();
+            while (auto job = compiler_->poll())
+                recordCompile(job->compileNanos);
+        }
+        jit_->recycle(cpu);
+        hotness_.clear();
+    }
+
+    void TieredEngine::recordCompile(u64 nanos)
+    {
+        stats_.compileNanos    += nanos;
+        stats_.maxCompileNanos  = std::max(stats_.maxCompileNanos, nanos);
+    }
+}    // namespace rvemu
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "BlockCache.hpp"
+#include "RVEmu.hpp"
+
+#include <memory>
+#include <unordered_map>
+
+namespace rvemu
+{
+    class BackgroundCompiler;
+    class CPU;
+    class JitEngine;
+
+    /// Promotion thresholds of the tiered engine.
+    struct TierConfig
+    {
+        /// Times a block start is reached in the interpreter before the block is translated.
+        u32 warmThreshold = 2;
+        /// Dispatches of a translated block before it is compiled to native code.
+        u32 hotThreshold = 64;
+        /// Compile on a background thread while the block keeps running threaded.
+        bool backgroundCompile = true;
+    };
+
+    /// What the tiered engine did so far.
+    struct TierStats
+    {
+        u64 interpretedInsts = 0;    /// Instructions run by the interpreter tier.
+        u64 threadedRuns     = 0;    /// Dispatches of threaded blocks.
+        u64 nativeRuns       = 0;    /// Dispatches into compiled code, chained blocks excluded.
+        u64 translated       = 0;    /// Blocks promoted to the threaded tier.
+        u64 compiled         = 0;    /// Blocks promoted to native code.
+        u64 compileNanos     = 0;    /// Time spent compiling.
+        u64 maxCompileNanos  = 0;    /// Longest compilation of a block.
+        u64 maxQueueDepth    = 0;    /// Most blocks waiting for the background compiler.
+        u64 staleCompiles    = 0;    /// Background compilations of blocks dropped meanwhile.
+    };
+
+    /// Execution engine picking the tier of each block by how often it runs.
+    ///
+    /// Code starts in the interpreter, which counts how many times each block start is
+    /// reached. A warm block is translated for the threaded engine and a translated block that
+    /// keeps running is compiled by the JIT, so one-shot code never pays for translation and
+    /// loops end up in native code.
+    ///
+    /// Compilation normally runs on a BackgroundCompiler thread, the hart installs finished
+    /// code between two dispatches.
+    class TieredEngine
+    {
+      public:
+        explicit TieredEngine(const TierConfig &config);
+        ~TieredEngine();
+
+        /// Runs the program on the given hart until it ends.
+        void run(CPU &cpu);
+
+        const TierStats &getStats() const { return stats_; }
+
+      private:
+        /// Interprets the instructions of the block starting at the current pc.
+        void interpretBlock(CPU &cpu);
+
+        /// Compiles a translated block or queues it for compilation, creating the JIT on first
+        /// use.
+        /// @return False if the code arena had to be recycled, which dropped every block.
+        bool promote(CPU &cpu, TranslatedBlock &block);
+
+        /// Installs the code the background compiler finished.
+        /// @return False if nothing changed. Otherwise exits may have been replaced and, if the
+        /// arena was full, every block dropped.
+        bool installCompiled(CPU &cpu);
+
+        /// Empties the code arena, once the background compiler is idle.
+        void recycle(CPU &cpu);
+
+        void recordCompile(u64 nanos);
+
+        TierConfig config_;
+        TierStats stats_;
+
+        /// Times each untranslated block start was reached.
+        std::unordered_map<AddrType, u32> hotness_;
+
+        std::unique_ptr<JitEngine> jit_;
+        std::unique_ptr<BackgroundCompiler> compiler_;    /// Declared last, joined first.
+    };
+}    // namespace rvemu
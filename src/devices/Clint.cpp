@@ -0,0 +1,118 @@
+#include "Clint.hpp"
+
+#include <iostream>
+
+namespace rvemu
+{
+    namespace
+    {
+        /// Merges a write of size bytes at offset into a register of 8 bytes at base.
+        u64 merge(u64 reg, AddrType base, AddrType offset, u8 size, u64 value)
+        {
+            const u64 shift = (offset - base) * 8;
+            const u64 mask  = (size == DoubleWord ? ~0ULL : (1ULL << (size * 8)) - 1) << shift;
+            return (reg & ~mask) | ((value << shift) & mask);
+        }
+
+        /// Whether size bytes at offset fall in the register of width bytes at base.
+        bool inside(AddrType base, u8 width, AddrType offset, u8 size)
+        {
+            return offset >= base && offset - base + size <= width;
+        }
+    }    // namespace
+
+    Clint::Clint(EventQueue &events, InterruptLines &lines) : events_(events)
+    {
+        harts_.push_back(Hart {.lines = &lines});
+    }
+
+    void Clint::addHart(InterruptLines &lines)
+    {
+        if (harts_.size() == MAX_HARTS)
+        {
+            std::cerr << "The CLINT serves " << MAX_HARTS << " harts at most\n";
+            abort();
+        }
+        harts_.push_back(Hart {.lines = &lines});
+    }
+
+    u64 Clint::read(AddrType offset, u8 size)
+    {
+        const std::lock_guard lock(mutex_);
+        const u64 msip = (offset - MSIP) / Word;
+        const u64 cmp  = (offset - MTIMECMP) / DoubleWord;
+        u64 reg        = 0;
+        AddrType base  = 0;
+        if (msip < harts_.size() && inside(MSIP + msip * Word, Word, offset, size))
+        {
+            reg  = (harts_[msip].lines->pending() & MASK_MSIP) != 0;
+            base = MSIP + msip * Word;
+        }
+        else if (cmp < harts_.size()
+                 && inside(MTIMECMP + cmp * DoubleWord, DoubleWord, offset, size))
+        {
+            reg  = harts_[cmp].mtimecmp;
+            base = MTIMECMP + cmp * DoubleWord;
+        }
+        else if (inside(MTIME, DoubleWord, offset, size))
+        {
+            reg  = mtime();
+            base = MTIME;
+        }
+        else
+            return 0;
+
+        const u64 value = reg >> ((offset - base) * 8);
+        return size == DoubleWord ? value : value & ((1ULL << (size * 8)) - 1);
+    }
+
+    void Clint::write(AddrType offset, u8 size, u64 value)
+    {
+        const std::lock_guard lock(mutex_);
+        const u64 msip = (offset - MSIP) / Word;
+        const u64 cmp  = (offset - MTIMECMP) / DoubleWord;
+        if (msip < harts_.size() && inside(MSIP + msip * Word, Word, offset, size))
+        {
+            if (merge(0, MSIP + msip * Word, offset, size, value) & 1)
+                harts_[msip].lines->raise(MASK_MSIP);
+            else
+                harts_[msip].lines->lower(MASK_MSIP);
+        }
+        else if (cmp < harts_.size()
+                 && inside(MTIMECMP + cmp * DoubleWord, DoubleWord, offset, size))
+        {
+            u64 &mtimecmp = harts_[cmp].mtimecmp;
+            mtimecmp      = merge(mtimecmp, MTIMECMP + cmp * DoubleWord, offset, size, value);
+            updateTimer(cmp);
+        }
+        else if (inside(MTIME, DoubleWord, offset, size))
+        {
+            timeOffset_ = merge(mtime(), MTIME, offset, size, value) - events_.now();
+            for (u32 hart = 0; hart < harts_.size(); ++hart)
+                updateTimer(hart);
+        }
+    }
+
+    void Clint::updateTimer(u32 hart)
+    {
+        Hart &target = harts_[hart];
+        if (target.timerEvent)
+        {
+            events_.cancel(*target.timerEvent);
+            target.timerEvent.reset();
+        }
+
+        if (mtime() >= target.mtimecmp)
+        {
+            target.lines->raise(MASK_MTIP);
+            return;
+        }
+        target.lines->lower(MASK_MTIP);
+        // The event may run on any hart, and race with a write rescheduling it: it looks at
+        // the registers again rather than trusting it is the one scheduled.
+        target.timerEvent = events_.schedule(target.mtimecmp - timeOffset_, [this, hart] {
+            const std::lock_guard lock(mutex_);
+            updateTimer(hart);
+        });
+    }
+}    // namespace rvemu
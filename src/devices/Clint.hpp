@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Device.hpp"
+#include "EventQueue.hpp"
+#include "InterruptLines.hpp"
+
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace rvemu
+{
+    /// Core-local interruptor of the harts: a software interrupt bit (msip) and a timer
+    /// compare register (mtimecmp) per hart, and the machine timer (mtime) they share, laid out
+    /// like the SiFive CLINT.
+    ///
+    /// mtime is the virtual time of the EventQueue. Rather than comparing it with each
+    /// mtimecmp as time goes, the CLINT schedules an event for the time mtimecmp holds and
+    /// raises the timer line of the hart when the event runs. A hart writing the msip of
+    /// another one sends it an inter-processor interrupt.
+    class Clint : public Device
+    {
+      public:
+        static constexpr AddrType MSIP     = 0x0;       /// A word per hart.
+        static constexpr AddrType MTIMECMP = 0x4000;    /// A double word per hart.
+        static constexpr AddrType MTIME    = 0xbff8;
+        static constexpr u32 MAX_HARTS     = 4095;
+
+        /// @param lines The lines of hart 0.
+        Clint(EventQueue &events, InterruptLines &lines);
+
+        /// Adds the next hart, before the harts first run. Aborts past MAX_HARTS.
+        void addHart(InterruptLines &lines);
+
+        u64 read(AddrType offset, u8 size) override;
+
+        void write(AddrType offset, u8 size, u64 value) override;
+
+        const char *name() const override { return "CLINT"; }
+
+      private:
+        struct Hart
+        {
+            InterruptLines *lines;
+            u64 mtimecmp = EventQueue::NEVER;
+            std::optional<EventQueue::EventId> timerEvent = std::nullopt;
+        };
+
+        u64 mtime() const { return events_.now() + timeOffset_; }
+
+        /// Raises or lowers the timer line of a hart, scheduling the event of a future
+        /// mtimecmp.
+        void updateTimer(u32 hart);
+
+        EventQueue &events_;
+        std::mutex mutex_;    /// Harts write the registers from threads of their own.
+        std::vector<Hart> harts_;
+        u64 timeOffset_ = 0;    /// mtime - the time of events_, set by writes to mtime.
+    };
+}    // namespace rvemu
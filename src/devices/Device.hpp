@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+namespace rvemu
+{
+    /// A device the harts reach through loads and stores to its address range.
+    ///
+    /// Accesses come with their offset from the start of the range and are 1, 2, 4 or 8 bytes
+    /// wide, the value is in the low bits. A device that cannot serve an access throws a const
+    /// char *, like DRAM does outside of its range.
+    class Device
+    {
+      public:
+        virtual ~Device() = default;
+
+        virtual u64 read(AddrType offset, u8 size) = 0;
+
+        virtual void write(AddrType offset, u8 size, u64 value) = 0;
+
+        /// What the device is, for error messages.
+        virtual const char *name() const = 0;
+    };
+}    // namespace rvemu
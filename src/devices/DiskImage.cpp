@@ -0,0 +1,161 @@
+#include "DiskImage.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rvemu
+{
+    namespace
+    {
+        [[noreturn]] void fail(const std::string &path)
+        {
+            std::cerr << "Cannot map disk " << path << ": " << std::strerror(errno) << "\n";
+            abort();
+        }
+
+        /// Opens a file, aborting if it cannot be, and closes it once mapped.
+        class File
+        {
+          public:
+            File(const std::string &path, int flags) : fd_(open(path.c_str(), flags, 0644))
+            {
+                if (fd_ < 0)
+                    fail(path);
+            }
+
+            ~File() { close(fd_); }
+
+            File(const File &)             = delete;
+            File &operator= (const File &) = delete;
+
+            operator int () const { return fd_; }
+
+            u64 size(const std::string &path) const
+            {
+                struct stat st;
+                if (fstat(fd_, &st) != 0)
+                    fail(path);
+                return st.st_size;
+            }
+
+          private:
+            int fd_;
+        };
+    }    // namespace
+
+    DiskImage::DiskImage(const DiskConfig &config) : readOnly_(config.readOnly)
+    {
+        const bool writesImage = !config.readOnly && config.overlay.empty();
+        File image(config.path, writesImage ? O_RDWR : O_RDONLY);
+        size_ = image.size(config.path);
+        if (size_ < SECTOR_SIZE)
+        {
+            std::cerr << "Cannot map disk " << config.path << ": smaller than a sector\n";
+            abort();
+        }
+
+        const int protection = writesImage ? PROT_READ | PROT_WRITE : PROT_READ;
+        void *mapping        = mmap(nullptr, size_, protection, MAP_SHARED, image, 0);
+        if (mapping == MAP_FAILED)
+            fail(config.path);
+        image_ = static_cast<std::byte *>(mapping);
+
+        if (config.overlay.empty())
+            return;
+
+        // A sparse file, chunks never written take no space.
+        const u64 chunks = (size_ + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        overlayLength_   = size_ + (chunks + 7) / 8;
+        File overlay(config.overlay, O_RDWR | O_CREAT);
+        const u64 found = overlay.size(config.overlay);
+        if (found == 0 && ftruncate(overlay, overlayLength_) != 0)
+            fail(config.overlay);
+        if (found != 0 && found != overlayLength_)
+        {
+            std::cerr << "Cannot map disk " << config.overlay << ": the overlay of another image\n";
+            abort();
+        }
+
+        mapping = mmap(nullptr, overlayLength_, PROT_READ | PROT_WRITE, MAP_SHARED, overlay, 0);
+        if (mapping == MAP_FAILED)
+            fail(config.overlay);
+        overlay_ = static_cast<std::byte *>(mapping);
+        chunks_  = reinterpret_cast<u8 *>(overlay_ + size_);
+    }
+
+    DiskImage::~DiskImage()
+    {
+        munmap(image_, size_);
+        if (overlay_ != nullptr)
+            munmap(overlay_, overlayLength_);
+    }
+
+    void DiskImage::read(u64 offset, std::byte *dest, std::size_t size) const
+    {
+        if (overlay_ == nullptr)
+        {
+            std::memcpy(dest, image_ + offset, size);
+            return;
+        }
+
+        while (size > 0)
+        {
+            const u64 chunk         = offset / CHUNK_SIZE;
+            const std::size_t count = std::min(size, CHUNK_SIZE - offset % CHUNK_SIZE);
+            std::memcpy(dest, (holds(chunk) ? overlay_ : image_) + offset, count);
+            offset += count;
+            dest += count;
+            size -= count;
+        }
+    }
+
+    void DiskImage::write(u64 offset, const std::byte *src, std::size_t size)
+    {
+        if (overlay_ == nullptr)
+        {
+            std::memcpy(image_ + offset, src, size);
+            return;
+        }
+
+        while (size > 0)
+        {
+            const u64 chunk         = offset / CHUNK_SIZE;
+            const std::size_t count = std::min(size, CHUNK_SIZE - offset % CHUNK_SIZE);
+            if (!holds(chunk))
+            {
+                // What the write leaves of the chunk comes from the image.
+                const u64 start = chunk * CHUNK_SIZE;
+                if (count < CHUNK_SIZE)
+                    std::memcpy(overlay_ + start,
+                                image_ + start,
+                                std::min<u64>(CHUNK_SIZE, size_ - start));
+                chunks_[chunk / 8] |= 1 << (chunk % 8);
+            }
+            std::memcpy(overlay_ + offset, src, count);
+            offset += count;
+            src += count;
+            size -= count;
+        }
+    }
+
+    bool DiskImage::flush()
+    {
+        if (overlay_ != nullptr)
+            return msync(overlay_, overlayLength_, MS_SYNC) == 0;
+        return readOnly_ || msync(image_, size_, MS_SYNC) == 0;
+    }
+
+    const char *DiskImage::describe() const
+    {
+        if (overlay_ != nullptr)
+            return "image with an overlay";
+        return readOnly_ ? "read-only image" : "image";
+    }
+}    // namespace rvemu
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+#include <cstddef>
+#include <string>
+
+namespace rvemu
+{
+    /// What backs a disk.
+    struct DiskConfig
+    {
+        std::string path;       /// The disk image.
+        std::string overlay;    /// If set, the file the writes go to, the image is only read.
+        bool readOnly = false;
+    };
+
+    /// A disk image mapped into the host address space, so requests copy straight between
+    /// the mapping and guest RAM and the host page cache does the I/O.
+    ///
+    /// Without an overlay, writes go to the image. With one, the image is mapped read-only,
+    /// and so shared by every emulator using it, while each CHUNK_SIZE chunk written is first
+    /// copied to the overlay file: its data at the same offset as in the image, followed by a
+    /// bitmap of the chunks it holds. The overlay keeps the writes across runs.
+    class DiskImage
+    {
+      public:
+        static constexpr std::size_t SECTOR_SIZE = 512;
+        static constexpr std::size_t CHUNK_SIZE  = 4096;    /// Granularity of the overlay.
+
+        /// Maps the image and the overlay, aborting if the host cannot or if the overlay was
+        /// made for an image of another size.
+        explicit DiskImage(const DiskConfig &config);
+
+        ~DiskImage();
+
+        DiskImage(const DiskImage &)             = delete;
+        DiskImage &operator= (const DiskImage &) = delete;
+
+        /// Size of the disk in bytes.
+        u64 size() const { return size_; }
+
+        bool isReadOnly() const { return readOnly_; }
+
+        /// Copies size bytes of the disk from offset to dest, which must be inside the disk.
+        void read(u64 offset, std::byte *dest, std::size_t size) const;
+
+        /// Copies size bytes from src to the disk at offset, which must be inside the disk.
+        void write(u64 offset, const std::byte *src, std::size_t size);
+
+        /// Writes what was written back to the files.
+        /// @return Whether the host could.
+        bool flush();
+
+        const char *describe() const;
+
+      private:
+        bool holds(u64 chunk) const { return (chunks_[chunk / 8] >> (chunk % 8)) & 1; }
+
+        std::byte *image_ = nullptr;
+        u64 size_         = 0;
+        bool readOnly_    = false;
+
+        // The overlay: its data, then the bitmap of the chunks it holds.
+        std::byte *overlay_        = nullptr;
+        u8 *chunks_                = nullptr;
+        std::size_t overlayLength_ = 0;
+    };
+}    // namespace rvemu
@@ -0,0 +1,148 @@
+#include "EventQueue.hpp"
+
+#include <algorithm>
+
+namespace rvemu
+{
+    EventQueue::EventQueue(TimeMode mode, InterruptLines &lines)
+      : mode_(mode), harts_ {&lines}, start_(std::chrono::steady_clock::now())
+    { }
+
+    void EventQueue::watch(InterruptLines &lines)
+    {
+        harts_.push_back(&lines);
+        mode_ = TimeMode::Host;
+    }
+
+    u64 EventQueue::now() const
+    {
+        if (mode_ == TimeMode::Instructions)
+            return (retired_ != nullptr ? *retired_ : stopped_) + skipped_;
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_);
+        return static_cast<u64>(elapsed.count()) / NANOS_PER_TICK;
+    }
+
+    EventQueue::EventId EventQueue::schedule(u64 when, Callback callback)
+    {
+        const std::lock_guard lock(mutex_);
+
+        // Cancelled events only leave the heap from its top, rebuild it before they pile up.
+        if (heap_.size() > 2 * callbacks_.size() + 64)
+        {
+            std::erase_if(heap_, [this](const Entry &entry) {
+                return !callbacks_.contains(entry.id);
+            });
+            std::ranges::make_heap(heap_, std::greater {});
+        }
+
+        const bool first = callbacks_.empty() || when < heap_.front().when;
+        const EventId id = nextId_++;
+        heap_.push_back({when, id});
+        std::ranges::push_heap(heap_, std::greater {});
+        callbacks_.emplace(id, std::move(callback));
+
+        // The harts run until the event they knew was next, make them look again.
+        if (first)
+        {
+            for (InterruptLines *lines : harts_)
+                lines->notify();
+        }
+        return id;
+    }
+
+    void EventQueue::cancel(EventId id)
+    {
+        const std::lock_guard lock(mutex_);
+        callbacks_.erase(id);
+        dropCancelled();
+    }
+
+    void EventQueue::runDue()
+    {
+        const u64 time = now();
+        std::unique_lock lock(mutex_);
+        while (!heap_.empty() && heap_.front().when <= time)
+        {
+            std::ranges::pop_heap(heap_, std::greater {});
+            auto event = callbacks_.extract(heap_.back().id);
+            heap_.pop_back();
+            dropCancelled();
+            ++fired_;
+
+            // The callback may schedule or cancel events.
+            lock.unlock();
+            event.mapped()();
+            lock.lock();
+        }
+    }
+
+    u64 EventQueue::nextCheck(u64 retired) const
+    {
+        const std::lock_guard lock(mutex_);
+        if (heap_.empty())
+            return NEVER;
+        if (mode_ == TimeMode::Host)
+            return retired + HOST_CHECK_INSTS;
+
+        const u64 due  = heap_.front().when;
+        const u64 time = now();
+        return due > time ? retired + (due - time) : retired;
+    }
+
+    u64 EventQueue::getFired() const
+    {
+        const std::lock_guard lock(mutex_);
+        return fired_;
+    }
+
+    u64 EventQueue::getIdleTicks() const
+    {
+        const std::lock_guard lock(mutex_);
+        return idleTicks_;
+    }
+
+    void EventQueue::idle(InterruptLines &lines, u64 epoch)
+    {
+        const u64 time = now();
+        std::unique_lock lock(mutex_);
+        const u64 due = heap_.empty() ? NEVER : heap_.front().when;
+        if (mode_ == TimeMode::Instructions)
+        {
+            if (lines.isBusy())
+            {
+                lock.unlock();
+                lines.waitFor(epoch);
+            }
+            else if (due != NEVER && due > time)
+            {
+                idleTicks_ += due - time;
+                skipped_ += due - time;
+            }
+            return;
+        }
+
+        // Another hart may raise a line at any time, a single one only waits for something.
+        if (due == NEVER && !lines.isBusy() && harts_.size() == 1)
+            return;
+        lock.unlock();
+        auto deadline = InterruptLines::Clock::time_point::max();
+        if (due != NEVER)
+            deadline = start_ + std::chrono::nanoseconds(due * NANOS_PER_TICK);
+        lines.waitFor(epoch, deadline);
+
+        lock.lock();
+        idleTicks_ += now() - time;
+    }
+
+    void EventQueue::dropCancelled()
+    {
+        // Keeps the top of the heap a pending event.
+        while (!heap_.empty() && !callbacks_.contains(heap_.front().id))
+        {
+            std::ranges::pop_heap(heap_, std::greater {});
+            heap_.pop_back();
+        }
+    }
+}    // namespace rvemu
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "InterruptLines.hpp"
+
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace rvemu
+{
+    /// What the virtual time of the machine follows.
+    enum class TimeMode : u8 {
+        Instructions,    // One tick per instruction of a single hart, runs are reproducible
+        Host,            // The host clock, at EventQueue::HOST_FREQUENCY ticks per second
+    };
+
+    /// Virtual time and the device events due at given times, in a min-heap.
+    ///
+    /// The hart does not poll the devices: it runs until the next event is due, then runs the
+    /// events, which raise the interrupt lines they drive. With instruction time the hart
+    /// stops exactly at the instruction an event is due at; with host time it looks at the
+    /// clock every HOST_CHECK_INSTS instructions while events are pending. A hart waiting for
+    /// an interrupt idles: instruction time jumps to the next event, host time is slept
+    /// through. Device work in flight on other threads ends the sleep, and takes no
+    /// instruction time: it is waited for before the time jumps.
+    ///
+    /// The harts of a machine share the queue, each running the due events it finds. Their
+    /// instructions make no common time, so with more than one hart the time is the host
+    /// clock, and a hart idles until another one or a device raises one of its lines.
+    class EventQueue
+    {
+      public:
+        using EventId  = u64;
+        using Callback = std::function<void()>;
+
+        static constexpr u64 HOST_FREQUENCY   = 10'000'000;
+        static constexpr u64 NANOS_PER_TICK   = 1'000'000'000 / HOST_FREQUENCY;
+        static constexpr u64 HOST_CHECK_INSTS = 1 << 14;
+        static constexpr u64 NEVER            = std::numeric_limits<u64>::max();
+
+        /// @param lines The lines of the first hart, notified when an event is scheduled
+        /// before the others.
+        EventQueue(TimeMode mode, InterruptLines &lines);
+
+        /// Adds a hart running the events, before the harts first run. The time follows the
+        /// host clock from then on.
+        void watch(InterruptLines &lines);
+
+        /// Selects the time source, before the harts first run. Several harts keep the host
+        /// clock.
+        void setMode(TimeMode mode) { mode_ = harts_.size() > 1 ? TimeMode::Host : mode; }
+
+        TimeMode getMode() const { return mode_; }
+
+        /// The virtual time, in ticks.
+        u64 now() const;
+
+        /// Makes instruction time follow the retired count of the only hart while it runs.
+        void attach(const u64 *retired) { retired_ = retired; }
+
+        /// Stops following the hart, instruction time stays where it is.
+        void detach()
+        {
+            stopped_ = *retired_;
+            retired_ = nullptr;
+        }
+
+        /// Runs callback once the time reaches when.
+        /// @return An id to cancel the event with.
+        EventId schedule(u64 when, Callback callback);
+
+        /// Drops an event that is still pending.
+        void cancel(EventId id);
+
+        /// Runs the callbacks of the events that are due, in time order.
+        void runDue();
+
+        /// The retired count at which the hart has to run the due events next, NEVER if no
+        /// event is pending.
+        /// @param retired The instructions the hart retired so far.
+        u64 nextCheck(u64 retired) const;
+
+        /// Lets the time pass until the next event is due, without running it, or waits for
+        /// the lines of the hart to change if a device or another hart may change them.
+        /// Returns at once if nothing could end the wait.
+        /// @param lines The lines of the waiting hart.
+        /// @param epoch The epoch of the lines the hart saw nothing pending in.
+        void idle(InterruptLines &lines, u64 epoch);
+
+        /// Number of events run so far.
+        u64 getFired() const;
+
+        /// Number of ticks the harts spent idling.
+        u64 getIdleTicks() const;
+
+      private:
+        struct Entry
+        {
+            u64 when;
+            EventId id;
+
+            bool operator> (const Entry &other) const
+            {
+                return when != other.when ? when > other.when : id > other.id;
+            }
+        };
+
+        /// Drops the cancelled events at the top of the heap.
+        void dropCancelled();
+
+        TimeMode mode_;
+        std::vector<InterruptLines *> harts_;            /// Lines of the harts.
+        std::chrono::steady_clock::time_point start_;    /// Host time 0.
+        const u64 *retired_ = nullptr;    /// Retired count of the running hart.
+        u64 stopped_        = 0;          /// Instruction time while the hart is not running.
+        u64 skipped_        = 0;          /// Instruction time skipped idling.
+
+        mutable std::mutex mutex_;                            /// Guards what follows.
+        std::vector<Entry> heap_;                             /// Pending and cancelled events.
+        std::unordered_map<EventId, Callback> callbacks_;    /// Of the pending events only.
+        EventId nextId_ = 0;
+        u64 fired_      = 0;
+        u64 idleTicks_  = 0;
+    };
+}    // namespace rvemu
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace rvemu
+{
+    /// The interrupt lines devices drive into a hart, as mip bits, and the epoch the hart
+    /// watches to notice changes.
+    ///
+    /// The hart compares the epoch with the one it last saw between instructions or blocks,
+    /// so it reacts to an interrupt, or to anything else it is told about, without polling the
+    /// devices. Lines may be driven from any thread. An idle hart may block until the epoch
+    /// moves, notifications only take a lock while one does.
+    class InterruptLines
+    {
+      public:
+        using Clock = std::chrono::steady_clock;
+
+        /// Raises the lines of mask, telling the hart if any was low.
+        void raise(u64 mask)
+        {
+            if ((lines_.fetch_or(mask, std::memory_order_acq_rel) & mask) != mask)
+                notify();
+        }
+
+        /// Lowers the lines of mask, telling the hart if any was high.
+        void lower(u64 mask)
+        {
+            if ((lines_.fetch_and(~mask, std::memory_order_acq_rel) & mask) != 0)
+                notify();
+        }
+
+        /// The lines currently raised.
+        u64 pending() const { return lines_.load(std::memory_order_acquire); }
+
+        /// Makes the hart stop what it runs and look at its state again.
+        void notify()
+        {
+            // Sequentially consistent with the waiter count: either the waiter sees the new
+            // epoch or the notification sees the waiter.
+            epoch_.fetch_add(1);
+            if (waiters_.load() != 0)
+            {
+                const std::lock_guard lock(mutex_);
+                changed_.notify_all();
+            }
+        }
+
+        u64 getEpoch() const { return epoch_.load(std::memory_order_relaxed); }
+
+        /// Asks the hart to stop running, from any thread. The hart sees the request once it
+        /// sees the epoch it moved.
+        void requestStop()
+        {
+            stop_.store(true);
+            notify();
+        }
+
+        /// Whether a stop was requested, clearing the request.
+        bool takeStop() { return stop_.exchange(false); }
+
+        /// A device starts work on a thread of its own, which may end by raising a line.
+        void beginWork() { busy_.fetch_add(1, std::memory_order_relaxed); }
+
+        /// The work is done, whatever line it raised is raised already.
+        void endWork()
+        {
+            busy_.fetch_sub(1, std::memory_order_relaxed);
+            notify();
+        }
+
+        /// Whether a device works on a thread of its own.
+        bool isBusy() const { return busy_.load(std::memory_order_relaxed) != 0; }
+
+        /// Blocks until the epoch is no longer epoch or until deadline.
+        void waitFor(u64 epoch, Clock::time_point deadline = Clock::time_point::max())
+        {
+            waiters_.fetch_add(1);
+            {
+                std::unique_lock lock(mutex_);
+                auto moved = [&] { return epoch_.load() != epoch; };
+                if (deadline == Clock::time_point::max())
+                    changed_.wait(lock, moved);
+                else
+                    changed_.wait_until(lock, deadline, moved);
+            }
+            waiters_.fetch_sub(1);
+        }
+
+      private:
+        std::atomic<u64> lines_ {0};
+        std::atomic<u64> epoch_ {0};
+        std::atomic<u32> busy_ {0};       /// Devices working on threads of their own.
+        std::atomic<u32> waiters_ {0};    /// Threads in waitFor.
+        std::atomic<bool> stop_ {false};
+        std::mutex mutex_;
+        std::condition_variable changed_;
+    };
+}    // namespace rvemu
@@ -0,0 +1,52 @@
+#include "MmioBus.hpp"
+
+#include <algorithm>
+#include <fmt/core.h>
+#include <iostream>
+
+namespace rvemu
+{
+    MmioBus::~MmioBus()
+    {
+        while (!devices_.empty())
+            devices_.pop_back();
+    }
+
+    MmioBus &MmioBus::operator= (MmioBus &&other)
+    {
+        while (!devices_.empty())
+            devices_.pop_back();
+        ranges_  = std::move(other.ranges_);
+        devices_ = std::move(other.devices_);
+        return *this;
+    }
+
+    Device &MmioBus::map(AddrType base, AddrType size, std::unique_ptr<Device> device)
+    {
+        const Range range {base, base + size - 1, device.get()};
+        auto next = std::ranges::upper_bound(ranges_, base, {}, &Range::base);
+        if (size == 0 || range.last < base || (next != ranges_.end() && next->base <= range.last)
+            || (next != ranges_.begin() && std::prev(next)->last >= base))
+        {
+            std::cerr << fmt::format("Cannot map {} at {:#x}: empty or overlapping range\n",
+                                     device->name(),
+                                     base);
+            abort();
+        }
+
+        ranges_.insert(next, range);
+        devices_.push_back(std::move(device));
+        return *devices_.back();
+    }
+
+    const MmioBus::Range &MmioBus::find(AddrType addr, std::size_t size) const
+    {
+        auto next = std::ranges::upper_bound(ranges_, addr, {}, &Range::base);
+        if (next == ranges_.begin())
+            throw("Memory access outside of the memory\n");
+        const Range &range = *std::prev(next);
+        if (range.last < addr || range.last - addr < size - 1)
+            throw("Memory access outside of the memory\n");
+        return range;
+    }
+}    // namespace rvemu
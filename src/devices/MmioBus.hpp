@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Device.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace rvemu
+{
+    /// Routes the accesses outside of DRAM to the device mapped there.
+    ///
+    /// The ranges are kept sorted by address, an access finds its device with a binary search
+    /// over their start addresses. SystemInterface only comes here once an access missed DRAM,
+    /// so the devices cost DRAM accesses nothing.
+    class MmioBus
+    {
+      public:
+        MmioBus() = default;
+
+        /// Destroys the devices in reverse mapping order: one may use those mapped before it
+        /// until it is gone, as the I/O thread of a disk raises its interrupt at the PLIC.
+        ~MmioBus();
+
+        MmioBus(MmioBus &&) = default;
+        MmioBus &operator= (MmioBus &&other);
+
+        /// Maps a device over size bytes from base, the bus owns it from then on. Aborts if
+        /// the range is empty or overlaps the one of a device mapped already.
+        /// @return The device.
+        Device &map(AddrType base, AddrType size, std::unique_ptr<Device> device);
+
+        /// Reads size bytes from the device holding addr.
+        /// @throws const char * if no device holds the whole access.
+        u64 read(AddrType addr, u8 size) const
+        {
+            const Range &range = find(addr, size);
+            return range.device->read(addr - range.base, size);
+        }
+
+        /// Writes size bytes to the device holding addr.
+        /// @throws const char * if no device holds the whole access.
+        void write(AddrType addr, u8 size, u64 value) const
+        {
+            const Range &range = find(addr, size);
+            range.device->write(addr - range.base, size, value);
+        }
+
+      private:
+        struct Range
+        {
+            AddrType base;     /// First address of the device.
+            AddrType last;     /// Last address, so a range may end at the top of the space.
+            Device *device;    /// Owned by devices_.
+        };
+
+        /// Returns the range holding size bytes at addr.
+        /// @throws const char * if there is none.
+        const Range &find(AddrType addr, std::size_t size) const;
+
+        std::vector<Range> ranges_;                       /// Sorted by base, disjoint.
+        std::vector<std::unique_ptr<Device>> devices_;    /// In mapping order.
+    };
+}    // namespace rvemu
@@ -0,0 +1,131 @@
+#include "Plic.hpp"
+
+#include <bit>
+
+namespace rvemu
+{
+    void Plic::raise(u32 source)
+    {
+        const std::lock_guard lock(mutex_);
+        const u32 bit = 1U << source;
+        levels_ |= bit;
+        if (!(claimed_ & bit))
+            pending_ |= bit;
+        update();
+    }
+
+    void Plic::lower(u32 source)
+    {
+        const std::lock_guard lock(mutex_);
+        const u32 bit = 1U << source;
+        levels_ &= ~bit;
+        pending_ &= ~bit;
+        update();
+    }
+
+    u64 Plic::read(AddrType offset, u8 size)
+    {
+        if (size != Word || offset % Word != 0)
+            return 0;
+
+        const std::lock_guard lock(mutex_);
+        if (offset < PRIORITY + SOURCES * Word)
+            return priorities_[offset / Word];
+        if (offset == PENDING)
+            return pending_;
+        if (offset >= ENABLE && offset < ENABLE + CONTEXTS * ENABLE_SIZE)
+            return (offset - ENABLE) % ENABLE_SIZE == 0 ? enables_[(offset - ENABLE) / ENABLE_SIZE]
+                                                        : 0;
+        if (offset >= CONTEXT && offset < CONTEXT + CONTEXTS * CONTEXT_SIZE)
+        {
+            const u32 context = (offset - CONTEXT) / CONTEXT_SIZE;
+            switch ((offset - CONTEXT) % CONTEXT_SIZE)
+            {
+                case 0:    return thresholds_[context];
+                case Word: return claim(context);
+                default:   return 0;
+            }
+        }
+        return 0;
+    }
+
+    void Plic::write(AddrType offset, u8 size, u64 value)
+    {
+        if (size != Word || offset % Word != 0)
+            return;
+
+        const std::lock_guard lock(mutex_);
+        const u32 word = value;
+        if (offset < PRIORITY + SOURCES * Word)
+        {
+            // Source 0 does not exist, its priority stays 0.
+            if (offset != PRIORITY)
+                priorities_[offset / Word] = word & MAX_PRIORITY;
+        }
+        else if (offset >= ENABLE && offset < ENABLE + CONTEXTS * ENABLE_SIZE)
+        {
+            if ((offset - ENABLE) % ENABLE_SIZE == 0)
+                enables_[(offset - ENABLE) / ENABLE_SIZE] = word & ~1U;
+        }
+        else if (offset >= CONTEXT && offset < CONTEXT + CONTEXTS * CONTEXT_SIZE)
+        {
+            const u32 context = (offset - CONTEXT) / CONTEXT_SIZE;
+            switch ((offset - CONTEXT) % CONTEXT_SIZE)
+            {
+                case 0:    thresholds_[context] = word & MAX_PRIORITY; break;
+                case Word: complete(context, word); break;
+                default:   return;
+            }
+        }
+        update();
+    }
+
+    u32 Plic::best(u32 context) const
+    {
+        // The highest priority wins, then the lowest source.
+        u32 found    = 0;
+        u32 priority = thresholds_[context];
+        for (u32 candidates = pending_ & enables_[context]; candidates != 0;
+             candidates &= candidates - 1)
+        {
+            const u32 source = std::countr_zero(candidates);
+            if (priorities_[source] > priority)
+            {
+                found    = source;
+                priority = priorities_[source];
+            }
+        }
+        return found;
+    }
+
+    u32 Plic::claim(u32 context)
+    {
+        const u32 source = best(context);
+        pending_ &= ~(1U << source);
+        claimed_ |= (1U << source) & ~1U;
+        update();
+        return source;
+    }
+
+    void Plic::complete(u32 context, u32 source)
+    {
+        const u32 bit = source < SOURCES ? 1U << source : 0;
+        if (!(enables_[context] & bit))
+            return;
+        claimed_ &= ~bit;
+        if (levels_ & bit)
+            pending_ |= bit;
+    }
+
+    void Plic::update()
+    {
+        constexpr std::array<u64, CONTEXTS> LINES = {MASK_MEIP, MASK_SEIP};
+        for (u32 context = 0; context < CONTEXTS; ++context)
+        {
+            if (best(context) != 0)
+                lines_.raise(LINES[context]);
+            else
+                lines_.lower(LINES[context]);
+        }
+    }
+}    // namespace rvemu
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Device.hpp"
+#include "InterruptLines.hpp"
+
+#include <array>
+#include <mutex>
+
+namespace rvemu
+{
+    /// Platform-level interrupt controller of a hart, laid out like the SiFive PLIC. It
+    /// gathers the interrupt requests of the devices and drives the external interrupt lines
+    /// of its two contexts: machine mode (MEIP) and supervisor mode (SEIP).
+    ///
+    /// A source is pending while its device asserts it, until a context claims it, and is
+    /// not forwarded again before that context completes it. Devices may raise and lower
+    /// their sources from any thread.
+    class Plic : public Device
+    {
+      public:
+        static constexpr u32 SOURCES      = 32;    /// Source 0 is none.
+        static constexpr u32 CONTEXTS     = 2;     /// Machine, then supervisor mode.
+        static constexpr u32 MAX_PRIORITY = 7;
+
+        static constexpr AddrType PRIORITY     = 0x0;         /// A word per source.
+        static constexpr AddrType PENDING      = 0x1000;
+        static constexpr AddrType ENABLE       = 0x2000;      /// From here per context.
+        static constexpr AddrType ENABLE_SIZE  = 0x80;
+        static constexpr AddrType CONTEXT      = 0x20'0000;   /// Threshold, claim/complete.
+        static constexpr AddrType CONTEXT_SIZE = 0x1000;
+
+        explicit Plic(InterruptLines &lines) : lines_(lines) { }
+
+        /// The device behind source asserts its interrupt request.
+        void raise(u32 source);
+
+        /// The device behind source withdraws its interrupt request.
+        void lower(u32 source);
+
+        /// A device starts work on a thread of its own, a hart waiting for an interrupt waits
+        /// for it to end.
+        void beginWork() { lines_.beginWork(); }
+
+        /// The work is done, its interrupt requests are made already.
+        void endWork() { lines_.endWork(); }
+
+        /// Registers are words, other accesses read 0 and write nothing.
+        u64 read(AddrType offset, u8 size) override;
+
+        void write(AddrType offset, u8 size, u64 value) override;
+
+        const char *name() const override { return "PLIC"; }
+
+      private:
+        /// The pending source a context would claim, 0 if none is above its threshold.
+        u32 best(u32 context) const;
+
+        /// Claims the source a context is interrupted for.
+        u32 claim(u32 context);
+
+        /// Lets a claimed source interrupt again.
+        void complete(u32 context, u32 source);
+
+        /// Drives the line of each context from what it would claim.
+        void update();
+
+        std::mutex mutex_;    /// Guards the state below.
+        InterruptLines &lines_;
+        std::array<u32, SOURCES> priorities_ {};
+        std::array<u32, CONTEXTS> enables_ {};       /// A bit per source.
+        std::array<u32, CONTEXTS> thresholds_ {};
+        u32 levels_  = 0;    /// Sources their device asserts.
+        u32 pending_ = 0;
+        u32 claimed_ = 0;    /// Sources claimed and not completed yet.
+    };
+}    // namespace rvemu
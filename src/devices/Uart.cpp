@@ -0,0 +1,235 @@
+#include "Uart.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+
+#include <poll.h>
+#include <unistd.h>
+
+namespace rvemu
+{
+    namespace
+    {
+        // IER bits.
+        constexpr u8 IER_RX   = 1 << 0;    // Received data available.
+        constexpr u8 IER_THRE = 1 << 1;    // Transmitter holding register empty.
+
+        // IIR values.
+        constexpr u8 IIR_NONE  = 0x01;
+        constexpr u8 IIR_THRE  = 0x02;
+        constexpr u8 IIR_RX    = 0x04;
+        constexpr u8 IIR_FIFOS = 0xc0;
+
+        constexpr u8 FCR_ENABLE   = 1 << 0;
+        constexpr u8 FCR_CLEAR_RX = 1 << 1;
+        constexpr u8 LCR_DLAB     = 1 << 7;
+
+        // LSR bits.
+        constexpr u8 LSR_DR   = 1 << 0;    // Data ready.
+        constexpr u8 LSR_THRE = 1 << 5;
+        constexpr u8 LSR_TEMT = 1 << 6;    // Transmitter empty.
+    }    // namespace
+
+    Uart::Uart(EventQueue &events, Plic &plic, u32 source)
+      : events_(events), plic_(plic), source_(source)
+    {
+        setOutput(STDOUT_FILENO);
+    }
+
+    Uart::~Uart() { flush(); }
+
+    void Uart::setInput(int fd)
+    {
+        const std::lock_guard lock(mutex_);
+        input_    = fd;
+        nextPoll_ = 0;
+        schedulePoll();
+    }
+
+    void Uart::setOutput(int fd)
+    {
+        const std::lock_guard lock(mutex_);
+        writeOut();
+        output_    = fd;
+        lineFlush_ = isatty(fd);
+    }
+
+    void Uart::flush()
+    {
+        const std::lock_guard lock(mutex_);
+        writeOut();
+    }
+
+    u64 Uart::getBytesSent() const
+    {
+        const std::lock_guard lock(mutex_);
+        return bytesSent_;
+    }
+
+    u64 Uart::getHostWrites() const
+    {
+        const std::lock_guard lock(mutex_);
+        return hostWrites_;
+    }
+
+    void Uart::writeOut()
+    {
+        const char *data = tx_.data();
+        std::size_t left = tx_.size();
+        while (left > 0)
+        {
+            const ssize_t written = ::write(output_, data, left);
+            if (written < 0 && errno == EINTR)
+                continue;
+            // The host side went away, what is left is lost as on a line nobody listens to.
+            if (written <= 0)
+                break;
+            data += written;
+            left -= written;
+        }
+        if (!tx_.empty())
+            ++hostWrites_;
+        tx_.clear();
+    }
+
+    u64 Uart::read(AddrType offset, u8)
+    {
+        const std::lock_guard lock(mutex_);
+        if ((lcr_ & LCR_DLAB) && offset <= IER)
+            return offset == RBR ? divisor_ & 0xff : divisor_ >> 8;
+
+        switch (offset)
+        {
+            case RBR: {
+                if (rx_.empty())
+                    pollInput();
+                if (rx_.empty())
+                    return 0;
+                const u8 byte = rx_.front();
+                rx_.pop_front();
+                updateInterrupt();
+                return byte;
+            }
+            case IER: return ier_;
+            case IIR: {
+                u8 iir = IIR_NONE;
+                if ((ier_ & IER_RX) && !rx_.empty())
+                    iir = IIR_RX;
+                else if ((ier_ & IER_THRE) && threPending_)
+                {
+                    iir          = IIR_THRE;
+                    threPending_ = false;
+                    updateInterrupt();
+                }
+                return iir | ((fcr_ & FCR_ENABLE) ? IIR_FIFOS : 0);
+            }
+            case LCR: return lcr_;
+            case MCR: return mcr_;
+            case LSR:
+                if (rx_.empty())
+                    pollInput();
+                // Sent bytes leave the transmitter right away.
+                return LSR_THRE | LSR_TEMT | (rx_.empty() ? 0 : LSR_DR);
+            case SCR: return scr_;
+            default:  return 0;
+        }
+    }
+
+    void Uart::write(AddrType offset, u8, u64 value)
+    {
+        const std::lock_guard lock(mutex_);
+        const u8 byte = value;
+        if ((lcr_ & LCR_DLAB) && offset <= IER)
+        {
+            divisor_ = offset == RBR ? (divisor_ & 0xff00) | byte : (divisor_ & 0xff) | byte << 8;
+            return;
+        }
+
+        switch (offset)
+        {
+            case THR:
+                tx_ += static_cast<char>(byte);
+                ++bytesSent_;
+                if (tx_.size() >= FLUSH_SIZE || (lineFlush_ && byte == '\n'))
+                    writeOut();
+                else if (!flushEvent_)
+                {
+                    flushEvent_ = events_.schedule(events_.now() + FLUSH_DELAY, [this] {
+                        const std::lock_guard lock(mutex_);
+                        flushEvent_.reset();
+                        writeOut();
+                    });
+                }
+                threPending_ = true;
+                updateInterrupt();
+                break;
+            case IER:
+                // Enabling the THR empty interrupt while the register is empty raises it.
+                if ((byte & IER_THRE) && !(ier_ & IER_THRE))
+                    threPending_ = true;
+                ier_ = byte & 0x0f;
+                schedulePoll();
+                pollInput();
+                updateInterrupt();
+                break;
+            case FCR:
+                fcr_ = byte;
+                if (byte & FCR_CLEAR_RX)
+                {
+                    rx_.clear();
+                    updateInterrupt();
+                }
+                break;
+            case LCR: lcr_ = byte; break;
+            case MCR: mcr_ = byte; break;
+            case SCR: scr_ = byte; break;
+            default:  break;
+        }
+    }
+
+    void Uart::pollInput()
+    {
+        if (input_ < 0 || rx_.size() >= RX_SIZE || events_.now() < nextPoll_)
+            return;
+        nextPoll_ = events_.now() + POLL_DELAY;
+
+        pollfd ready {input_, POLLIN, 0};
+        if (poll(&ready, 1, 0) <= 0)
+            return;
+
+        std::array<u8, 256> bytes;
+        const std::size_t room = std::min(bytes.size(), RX_SIZE - rx_.size());
+        const ssize_t count    = ::read(input_, bytes.data(), room);
+        if (count > 0)
+            rx_.insert(rx_.end(), bytes.begin(), bytes.begin() + count);
+        else if (count == 0 || (errno != EINTR && errno != EAGAIN))
+            input_ = -1;    // End of the input, or it broke.
+        updateInterrupt();
+    }
+
+    void Uart::schedulePoll()
+    {
+        if (pollEvent_ || input_ < 0 || !(ier_ & IER_RX))
+            return;
+        pollEvent_ = events_.schedule(events_.now() + POLL_DELAY, [this] {
+            const std::lock_guard lock(mutex_);
+            pollEvent_.reset();
+            pollInput();
+            schedulePoll();
+        });
+    }
+
+    void Uart::updateInterrupt()
+    {
+        const bool pending =
+            ((ier_ & IER_RX) && !rx_.empty()) || ((ier_ & IER_THRE) && threPending_);
+        if (pending == asserted_)
+            return;
+        asserted_ = pending;
+        if (pending)
+            plic_.raise(source_);
+        else
+            plic_.lower(source_);
+    }
+}    // namespace rvemu
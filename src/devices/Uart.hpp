@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Device.hpp"
+#include "EventQueue.hpp"
+#include "Plic.hpp"
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+namespace rvemu
+{
+    /// 16550-compatible UART for the console, its registers a byte apart.
+    ///
+    /// Sent bytes go to a buffer written to the host in batches: once it holds FLUSH_SIZE
+    /// bytes, FLUSH_DELAY ticks after it stopped being empty, at the end of each run, and at
+    /// every newline if the host side is a terminal someone watches. Received bytes are read
+    /// from a host file descriptor only when it has some, so the guest never blocks on it:
+    /// when the guest looks for one while none is buffered, at most every POLL_DELAY ticks,
+    /// and every POLL_DELAY ticks while the received data interrupt is enabled. Interrupts
+    /// go through a source of the PLIC. Every hart may use it, one at a time.
+    class Uart : public Device
+    {
+      public:
+        // Registers, the divisor latch (DLL, DLM) replaces RBR/THR and IER while LCR.DLAB is
+        // set.
+        static constexpr AddrType RBR = 0;    /// Read.
+        static constexpr AddrType THR = 0;    /// Write.
+        static constexpr AddrType IER = 1;
+        static constexpr AddrType IIR = 2;    /// Read.
+        static constexpr AddrType FCR = 2;    /// Write.
+        static constexpr AddrType LCR = 3;
+        static constexpr AddrType MCR = 4;
+        static constexpr AddrType LSR = 5;
+        static constexpr AddrType MSR = 6;
+        static constexpr AddrType SCR = 7;
+
+        static constexpr std::size_t FLUSH_SIZE = 4096;
+        static constexpr std::size_t RX_SIZE    = 4096;       /// Received bytes buffered.
+        static constexpr u64 FLUSH_DELAY        = 100'000;    /// Ticks, 10 ms of host time.
+        static constexpr u64 POLL_DELAY         = 100'000;
+
+        /// Sends to stdout and receives nothing until given an input.
+        Uart(EventQueue &events, Plic &plic, u32 source);
+
+        /// Writes what is left in the buffer.
+        ~Uart() override;
+
+        Uart(const Uart &)             = delete;
+        Uart &operator= (const Uart &) = delete;
+
+        /// Receives from fd, -1 for nothing. The UART does not close it.
+        void setInput(int fd);
+
+        /// Sends to fd. The UART does not close it.
+        void setOutput(int fd);
+
+        /// Writes the buffered bytes to the host.
+        void flush();
+
+        u64 read(AddrType offset, u8 size) override;
+
+        void write(AddrType offset, u8 size, u64 value) override;
+
+        const char *name() const override { return "UART"; }
+
+        /// Number of bytes the guest sent.
+        u64 getBytesSent() const;
+
+        /// Number of writes to the host they took.
+        u64 getHostWrites() const;
+
+      private:
+        /// Writes the buffered bytes to the host, the lock held.
+        void writeOut();
+
+        /// Reads what the input has, if the last look was POLL_DELAY ticks ago or more.
+        void pollInput();
+
+        /// Schedules the next look at the input while the received data interrupt is on.
+        void schedulePoll();
+
+        /// Asserts the PLIC source if an enabled interrupt is pending.
+        void updateInterrupt();
+
+        EventQueue &events_;
+        Plic &plic_;
+        u32 source_;
+        mutable std::mutex mutex_;    /// Guards the state below.
+        int input_      = -1;
+        int output_     = -1;
+        bool lineFlush_ = false;    /// The output is a terminal.
+        bool asserted_  = false;    /// The PLIC source is raised.
+        std::string tx_;
+        std::deque<u8> rx_;
+        u64 nextPoll_ = 0;    /// Time of the next look at the input.
+        std::optional<EventQueue::EventId> flushEvent_;
+        std::optional<EventQueue::EventId> pollEvent_;
+
+        u8 ier_           = 0;
+        u8 lcr_           = 0;
+        u8 mcr_           = 0;
+        u8 scr_           = 0;
+        u8 fcr_           = 0;
+        u16 divisor_      = 0;
+        bool threPending_ = false;    /// The THR empty interrupt, cleared by reading IIR.
+
+        u64 bytesSent_  = 0;
+        u64 hostWrites_ = 0;
+    };
+}    // namespace rvemu
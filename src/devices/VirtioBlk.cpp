@@ -0,0 +1,411 @@
+#include "VirtioBlk.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+namespace rvemu
+{
+    namespace
+    {
+        // virtio-mmio registers.
+        constexpr AddrType MAGIC_VALUE         = 0x000;
+        constexpr AddrType VERSION             = 0x004;
+        constexpr AddrType DEVICE_ID           = 0x008;
+        constexpr AddrType VENDOR_ID           = 0x00c;
+        constexpr AddrType DEVICE_FEATURES     = 0x010;
+        constexpr AddrType DEVICE_FEATURES_SEL = 0x014;
+        constexpr AddrType DRIVER_FEATURES     = 0x020;
+        constexpr AddrType DRIVER_FEATURES_SEL = 0x024;
+        constexpr AddrType QUEUE_SEL           = 0x030;
+        constexpr AddrType QUEUE_NUM_MAX       = 0x034;
+        constexpr AddrType QUEUE_NUM           = 0x038;
+        constexpr AddrType QUEUE_READY         = 0x044;
+        constexpr AddrType QUEUE_NOTIFY        = 0x050;
+        constexpr AddrType INTERRUPT_STATUS    = 0x060;
+        constexpr AddrType INTERRUPT_ACK       = 0x064;
+        constexpr AddrType STATUS              = 0x070;
+        constexpr AddrType QUEUE_DESC_LOW      = 0x080;
+        constexpr AddrType QUEUE_DESC_HIGH     = 0x084;
+        constexpr AddrType QUEUE_DRIVER_LOW    = 0x090;
+        constexpr AddrType QUEUE_DRIVER_HIGH   = 0x094;
+        constexpr AddrType QUEUE_DEVICE_LOW    = 0x0a0;
+        constexpr AddrType QUEUE_DEVICE_HIGH   = 0x0a4;
+        constexpr AddrType CONFIG              = 0x100;
+
+        constexpr u32 MAGIC        = 0x7472'6976;    // "virt"
+        constexpr u32 BLOCK_DEVICE = 2;
+        constexpr u32 VENDOR       = 0x554d'4551;    // "QEMU", which drivers know
+
+        constexpr u64 F_BLK_RO    = 1ULL << 5;
+        constexpr u64 F_BLK_FLUSH = 1ULL << 9;
+        constexpr u64 F_VERSION_1 = 1ULL << 32;
+
+        constexpr u32 STATUS_FEATURES_OK = 8;
+        constexpr u32 STATUS_NEEDS_RESET = 64;
+        constexpr u32 INTERRUPT_USED     = 1;
+        constexpr u32 INTERRUPT_CONFIG   = 2;
+
+        constexpr u16 DESC_NEXT          = 1;
+        constexpr u16 DESC_WRITE         = 2;
+        constexpr u16 AVAIL_NO_INTERRUPT = 1;
+        constexpr std::size_t DESC_SIZE  = 16;
+
+        // Request types and status.
+        constexpr u32 T_IN     = 0;
+        constexpr u32 T_OUT    = 1;
+        constexpr u32 T_FLUSH  = 4;
+        constexpr u32 T_GET_ID = 8;
+        constexpr u8 S_OK      = 0;
+        constexpr u8 S_IOERR   = 1;
+        constexpr u8 S_UNSUPP  = 2;
+
+        constexpr std::size_t HEADER_SIZE = 16;    // type, reserved, sector
+        constexpr std::string_view SERIAL = "rvemu-virtio-blk";
+
+        template <typename T>
+        T load(const std::byte *host)
+        {
+            T value;
+            std::memcpy(&value, host, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        void store(std::byte *host, T value)
+        {
+            std::memcpy(host, &value, sizeof(T));
+        }
+
+        void merge(BlockStats &total, const BlockStats &more)
+        {
+            total.reads += more.reads;
+            total.writes += more.writes;
+            total.flushes += more.flushes;
+            total.errors += more.errors;
+            total.bytesRead += more.bytesRead;
+            total.bytesWritten += more.bytesWritten;
+            total.busyNanos += more.busyNanos;
+            total.maxNanos = std::max(total.maxNanos, more.maxNanos);
+        }
+
+        /// Replaces the low or the high word of an address.
+        AddrType setHalf(AddrType addr, bool high, u32 value)
+        {
+            return high ? (addr & 0xffff'ffff) | u64 {value} << 32
+                        : (addr & ~0xffff'ffffULL) | value;
+        }
+    }    // namespace
+
+    VirtioBlk::VirtioBlk(std::byte *memory,
+                         std::size_t memorySize,
+                         std::unique_ptr<DiskImage> disk,
+                         Plic &plic,
+                         u32 source)
+      : memory_(memory), memorySize_(memorySize), disk_(std::move(disk)), plic_(plic),
+        source_(source)
+    {
+        store<u64>(reinterpret_cast<std::byte *>(config_.data()),
+                   disk_->size() / DiskImage::SECTOR_SIZE);
+        worker_ = std::thread(&VirtioBlk::work, this);
+    }
+
+    VirtioBlk::~VirtioBlk()
+    {
+        {
+            const std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        kicked_.notify_one();
+        worker_.join();
+    }
+
+    BlockStats VirtioBlk::getStats() const
+    {
+        const std::lock_guard lock(mutex_);
+        return stats_;
+    }
+
+    void VirtioBlk::drain()
+    {
+        std::unique_lock lock(mutex_);
+        idle_.wait(lock, [this] { return !notified_ && !working_; });
+    }
+
+    u64 VirtioBlk::read(AddrType offset, u8 size)
+    {
+        if (offset >= CONFIG)
+        {
+            const AddrType at = offset - CONFIG;
+            u64 value         = 0;
+            if (at + size <= config_.size())
+                std::memcpy(&value, config_.data() + at, size);
+            return value;
+        }
+        if (size != Word)
+            return 0;
+
+        const std::lock_guard lock(mutex_);
+        const u64 features = F_VERSION_1 | F_BLK_FLUSH | (disk_->isReadOnly() ? F_BLK_RO : 0);
+        switch (offset)
+        {
+            case MAGIC_VALUE: return MAGIC;
+            case VERSION:     return 2;
+            case DEVICE_ID:   return BLOCK_DEVICE;
+            case VENDOR_ID:   return VENDOR;
+            case DEVICE_FEATURES:
+                if (deviceFeaturesSel_ >= 2)
+                    return 0;
+                return (features >> (32 * deviceFeaturesSel_)) & 0xffff'ffff;
+            case QUEUE_NUM_MAX:    return queueSel_ == 0 ? QUEUE_SIZE : 0;
+            case QUEUE_READY:      return queueSel_ == 0 && queue_.ready;
+            case INTERRUPT_STATUS: return interruptStatus_;
+            case STATUS:           return status_;
+            default:               return 0;    // CONFIG_GENERATION too, it never changes.
+        }
+    }
+
+    void VirtioBlk::write(AddrType offset, u8 size, u64 value)
+    {
+        if (size != Word)
+            return;
+
+        std::unique_lock lock(mutex_);
+        const u32 word = value;
+        switch (offset)
+        {
+            case DEVICE_FEATURES_SEL: deviceFeaturesSel_ = word; break;
+            case DRIVER_FEATURES_SEL: driverFeaturesSel_ = word; break;
+            case DRIVER_FEATURES:
+                if (driverFeaturesSel_ < 2)
+                    driverFeatures_ = setHalf(driverFeatures_, driverFeaturesSel_ == 1, word);
+                break;
+            case QUEUE_SEL: queueSel_ = word; break;
+            case QUEUE_NUM:
+                if (queueSel_ == 0 && word <= QUEUE_SIZE && (word & (word - 1)) == 0)
+                    queue_.num = word;
+                break;
+            case QUEUE_READY:
+                if (queueSel_ == 0)
+                    queue_.ready = word & 1;
+                break;
+            case QUEUE_DESC_LOW:
+            case QUEUE_DESC_HIGH:
+                queue_.desc = setHalf(queue_.desc, offset == QUEUE_DESC_HIGH, word);
+                break;
+            case QUEUE_DRIVER_LOW:
+            case QUEUE_DRIVER_HIGH:
+                queue_.avail = setHalf(queue_.avail, offset == QUEUE_DRIVER_HIGH, word);
+                break;
+            case QUEUE_DEVICE_LOW:
+            case QUEUE_DEVICE_HIGH:
+                queue_.used = setHalf(queue_.used, offset == QUEUE_DEVICE_HIGH, word);
+                break;
+            case QUEUE_NOTIFY:
+                // Notifications while the thread has one already are served with it.
+                if (word == 0 && !notified_)
+                {
+                    notified_ = true;
+                    plic_.beginWork();
+                    kicked_.notify_one();
+                }
+                break;
+            case INTERRUPT_ACK:
+                interruptStatus_ &= ~word;
+                if (interruptStatus_ == 0)
+                    plic_.lower(source_);
+                break;
+            case STATUS:
+                if (word == 0)
+                {
+                    idle_.wait(lock, [this] { return !notified_ && !working_; });
+                    reset();
+                    break;
+                }
+                // Features are only OK if the driver speaks virtio 1.
+                status_ = (word & STATUS_FEATURES_OK) && !(driverFeatures_ & F_VERSION_1)
+                            ? word & ~STATUS_FEATURES_OK
+                            : word;
+                break;
+            default: break;
+        }
+    }
+
+    void VirtioBlk::reset()
+    {
+        status_            = 0;
+        deviceFeaturesSel_ = 0;
+        driverFeaturesSel_ = 0;
+        driverFeatures_    = 0;
+        queueSel_          = 0;
+        interruptStatus_   = 0;
+        queue_             = {};
+        lastAvail_         = 0;
+        plic_.lower(source_);
+    }
+
+    void VirtioBlk::work()
+    {
+        std::unique_lock lock(mutex_);
+        for (;;)
+        {
+            kicked_.wait(lock, [this] { return notified_ || stopping_; });
+            if (!notified_)
+                return;
+            notified_ = false;
+            working_  = true;
+
+            const Queue queue = queue_;
+            u32 interrupts    = 0;
+            BlockStats stats;
+            if (queue.ready && queue.num != 0 && !(status_ & STATUS_NEEDS_RESET))
+            {
+                lock.unlock();
+                interrupts = processQueue(queue, stats);
+                lock.lock();
+            }
+
+            // A broken queue stops the device until the driver resets it.
+            merge(stats_, stats);
+            if (interrupts & INTERRUPT_CONFIG)
+                status_ |= STATUS_NEEDS_RESET;
+            if (interrupts != 0)
+            {
+                interruptStatus_ |= interrupts;
+                plic_.raise(source_);
+            }
+            working_ = false;
+            idle_.notify_all();
+            plic_.endWork();
+        }
+    }
+
+    u32 VirtioBlk::processQueue(const Queue &queue, BlockStats &stats)
+    {
+        const std::byte *avail = guest(queue.avail, 4 + 2 * queue.num);
+        std::byte *used        = guest(queue.used, 4 + 8 * queue.num);
+        if (avail == nullptr || used == nullptr)
+            return INTERRUPT_CONFIG;
+
+        // What the driver published before the notification at least.
+        const u16 availIdx = load<u16>(avail + 2);
+        u16 usedIdx        = load<u16>(used + 2);
+        bool served        = false;
+        for (; lastAvail_ != availIdx; ++lastAvail_)
+        {
+            const u16 head = load<u16>(avail + 4 + 2 * (lastAvail_ % queue.num));
+            const i64 len  = serve(queue, head, stats);
+            if (len < 0)
+                return INTERRUPT_CONFIG;
+
+            std::byte *elem = used + 4 + 8 * (usedIdx % queue.num);
+            store<u32>(elem, head);
+            store<u32>(elem + 4, len);
+            store<u16>(used + 2, ++usedIdx);
+            served = true;
+        }
+        return served && !(load<u16>(avail) & AVAIL_NO_INTERRUPT) ? INTERRUPT_USED : 0;
+    }
+
+    i64 VirtioBlk::serve(const Queue &queue, u16 head, BlockStats &stats)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Header, data buffers, status byte.
+        std::array<Desc, QUEUE_SIZE> chain;
+        u32 count = 0;
+        for (u16 idx = head;; ++count)
+        {
+            // A chain longer than the queue loops.
+            if (idx >= queue.num || count == queue.num)
+                return -1;
+            const std::byte *desc = guest(queue.desc + DESC_SIZE * idx, DESC_SIZE);
+            if (desc == nullptr)
+                return -1;
+            chain[count] = {load<u64>(desc), load<u32>(desc + 8), load<u16>(desc + 12),
+                            load<u16>(desc + 14)};
+            if (!(chain[count].flags & DESC_NEXT))
+            {
+                ++count;
+                break;
+            }
+            idx = chain[count].next;
+        }
+
+        const Desc &last        = chain[count - 1];
+        const std::byte *header = guest(chain[0].addr, HEADER_SIZE);
+        std::byte *status       = guest(last.addr + last.len - 1, 1);
+        if (count < 2 || chain[0].len < HEADER_SIZE || header == nullptr || last.len == 0
+            || !(last.flags & DESC_WRITE) || status == nullptr)
+            return -1;
+
+        const u32 type      = load<u32>(header);
+        u64 offset          = load<u64>(header + 8) * DiskImage::SECTOR_SIZE;
+        u8 result           = S_OK;
+        u64 written         = 0;
+        const bool transfer = type == T_IN || type == T_OUT;
+        for (u32 idx = 1; idx < count - 1 && result == S_OK; ++idx)
+        {
+            const Desc &data = chain[idx];
+            std::byte *host  = guest(data.addr, data.len);
+            if (host == nullptr)
+                return -1;
+
+            const bool toGuest = type != T_OUT;
+            if (toGuest != bool(data.flags & DESC_WRITE)
+                || (transfer && (offset > disk_->size() || data.len > disk_->size() - offset)))
+                result = S_IOERR;
+            else if (type == T_IN)
+            {
+                disk_->read(offset, host, data.len);
+                stats.bytesRead += data.len;
+            }
+            else if (type == T_OUT)
+            {
+                if (disk_->isReadOnly())
+                    result = S_IOERR;
+                else
+                {
+                    disk_->write(offset, host, data.len);
+                    stats.bytesWritten += data.len;
+                }
+            }
+            else if (type == T_GET_ID)
+                std::memcpy(host, SERIAL.data(), std::min<std::size_t>(data.len, SERIAL.size()));
+            offset += data.len;
+            written += toGuest ? data.len : 0;
+        }
+
+        switch (type)
+        {
+            case T_IN:  ++stats.reads; break;
+            case T_OUT: ++stats.writes; break;
+            case T_FLUSH:
+                ++stats.flushes;
+                if (!disk_->flush())
+                    result = S_IOERR;
+                break;
+            case T_GET_ID: break;
+            default:       result = S_UNSUPP; break;
+        }
+        store<u8>(status, result);
+        stats.errors += result != S_OK;
+
+        const u64 nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+        stats.busyNanos += nanos;
+        stats.maxNanos  = std::max(stats.maxNanos, nanos);
+        return (result == S_OK ? written : 0) + 1;
+    }
+
+    std::byte *VirtioBlk::guest(AddrType addr, std::size_t size) const
+    {
+        // Addresses below DRAM_BASE wrap around to huge offsets.
+        const AddrType offset = addr - DRAM_BASE;
+        if (offset > memorySize_ || size > memorySize_ - offset)
+            return nullptr;
+        return memory_ + offset;
+    }
+}    // namespace rvemu
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Device.hpp"
+#include "DiskImage.hpp"
+#include "Plic.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace rvemu
+{
+    /// What a block device served.
+    struct BlockStats
+    {
+        u64 reads        = 0;    /// Requests of each type.
+        u64 writes       = 0;
+        u64 flushes      = 0;
+        u64 errors       = 0;    /// Requests that did not complete with VIRTIO_BLK_S_OK.
+        u64 bytesRead    = 0;
+        u64 bytesWritten = 0;
+        u64 busyNanos    = 0;    /// Time spent serving requests.
+        u64 maxNanos     = 0;    /// Latency of the slowest request.
+    };
+
+    /// virtio-blk device behind a virtio-mmio (version 2) transport, with one split queue.
+    ///
+    /// A notification hands the queue to an I/O thread of the device and returns, so the
+    /// hart runs on while the host reads or writes. The thread serves every request made
+    /// available so far: the data moves with one copy per descriptor, straight between guest
+    /// RAM and the mapping of the DiskImage, where page faults do the host I/O. It then
+    /// publishes the used buffers and raises the used buffer interrupt through a source of
+    /// the PLIC, like a DMA engine would.
+    class VirtioBlk : public Device
+    {
+      public:
+        static constexpr u32 QUEUE_SIZE = 256;    /// Most descriptors the queue may have.
+
+        /// @param memory Host address of DRAM, which holds the queues and the buffers.
+        VirtioBlk(std::byte *memory,
+                  std::size_t memorySize,
+                  std::unique_ptr<DiskImage> disk,
+                  Plic &plic,
+                  u32 source);
+
+        /// Serves the requests notified already, then stops the I/O thread.
+        ~VirtioBlk() override;
+
+        VirtioBlk(const VirtioBlk &)             = delete;
+        VirtioBlk &operator= (const VirtioBlk &) = delete;
+
+        /// Registers are words, the configuration space takes any width.
+        u64 read(AddrType offset, u8 size) override;
+
+        void write(AddrType offset, u8 size, u64 value) override;
+
+        const char *name() const override { return "virtio-blk"; }
+
+        const DiskImage &getDisk() const { return *disk_; }
+
+        /// What the requests served so far did.
+        BlockStats getStats() const;
+
+        /// Waits until the requests notified so far are served.
+        void drain();
+
+      private:
+        /// A descriptor of the queue.
+        struct Desc
+        {
+            u64 addr;
+            u32 len;
+            u16 flags;
+            u16 next;
+        };
+
+        /// Where the queue is, as the driver set it up.
+        struct Queue
+        {
+            u32 num        = 0;
+            bool ready     = false;
+            AddrType desc  = 0;    /// Descriptor table.
+            AddrType avail = 0;    /// Driver area.
+            AddrType used  = 0;    /// Device area.
+        };
+
+        /// Back to the state after power on, once the I/O thread is idle.
+        void reset();
+
+        /// The I/O thread: serves the queue each time it is notified.
+        void work();
+
+        /// Serves the requests the driver made available, on the I/O thread.
+        /// @return The interrupts to raise.
+        u32 processQueue(const Queue &queue, BlockStats &stats);
+
+        /// Serves the request whose descriptor chain starts at head.
+        /// @return The bytes written to guest memory, or -1 if the chain is malformed.
+        i64 serve(const Queue &queue, u16 head, BlockStats &stats);
+
+        /// Host address of size bytes of guest RAM at addr, nullptr if not all in DRAM.
+        std::byte *guest(AddrType addr, std::size_t size) const;
+
+        std::byte *memory_;
+        std::size_t memorySize_;
+        std::unique_ptr<DiskImage> disk_;
+        Plic &plic_;
+        u32 source_;
+        std::array<u8, 8> config_ {};    /// Configuration space: the capacity in sectors.
+
+        // Registers, the I/O thread only sets the interrupt status and NEEDS_RESET.
+        mutable std::mutex mutex_;    /// Guards the registers and the state below.
+        u32 status_            = 0;
+        u32 deviceFeaturesSel_ = 0;
+        u32 driverFeaturesSel_ = 0;
+        u64 driverFeatures_    = 0;
+        u32 queueSel_          = 0;
+        u32 interruptStatus_   = 0;
+        Queue queue_;
+
+        // The I/O thread and what it shares with the hart.
+        std::condition_variable kicked_;    /// The thread has requests to serve or is to stop.
+        std::condition_variable idle_;      /// The thread served what it was notified of.
+        bool notified_ = false;
+        bool working_  = false;
+        bool stopping_ = false;
+        u16 lastAvail_ = 0;    /// The next request to serve, only the thread changes it.
+        BlockStats stats_;
+        std::thread worker_;
+    };
+}    // namespace rvemu
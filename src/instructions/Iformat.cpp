@@ -97,7 +97,7 @@ namespace rvemu
 
     void ImmOp64::addiw()
     {
-        RegisterSizeType result = rs_ + offset_;
+        RegisterSizeType result = (rs_ + offset_) & 0xFFFF'FFFF;
         rd_                     = BitsManipulation::extendSign(result, 31);
     }
 
@@ -1,9 +1,7 @@
 #include "Load.hpp"
 
-#include "../BitsManipulation.hpp"
 #include "../Memory.hpp"
 
-#include <cassert>
 #include <iostream>
 
 namespace rvemu
@@ -12,22 +10,19 @@ namespace rvemu
 
     void Load::accessMemory(SystemInterface &bus)
     {
-        assert(func3_ <= 6);
-        DataSizeType sz;
-        if (func3_ == 0 || func3_ == 4)         // lb or lbu
-            sz = Byte;
-        else if (func3_ == 1 || func3_ == 5)    // lh or lhu
-            sz = HalfWord;
-        else if (func3_ == 2 || func3_ == 6)    // lw or lwu
-            sz = Word;
-        else
+        switch (func3_)
         {
-            std::cerr << "Invalid func3 in load instruction\n";
-            abort();
+            case 0: rd_ = static_cast<int8_t>(bus.read<u8>(addrToRead)); break;      // lb
+            case 1: rd_ = static_cast<int16_t>(bus.read<u16>(addrToRead)); break;    // lh
+            case 2: rd_ = static_cast<int32_t>(bus.read<u32>(addrToRead)); break;    // lw
+            case 3: rd_ = bus.read<u64>(addrToRead); break;                          // ld
+            case 4: rd_ = bus.read<u8>(addrToRead); break;                           // lbu
+            case 5: rd_ = bus.read<u16>(addrToRead); break;                          // lhu
+            case 6: rd_ = bus.read<u32>(addrToRead); break;                          // lwu
+            default: {
+                std::cerr << "Invalid func3 in load instruction\n";
+                abort();
+            }
         }
-        rd_ = bus.readData(addrToRead, sz);
-
-        if (func3_ <= 2)
-            rd_ = BitsManipulation::extendSign(rd_, (1 << (func3_ + 3)) - 1);
     }
 }    // namespace rvemu
@@ -173,11 +173,17 @@ namespace rvemu
 
     void ModeRet::sfenceVMA() { nextInst_ = currPC_ + DataSizeType::Word; }
 
+    void ModeRet::wfi()
+    {
+        cpu_.waitForInterrupt();
+        nextInst_ = currPC_ + DataSizeType::Word;
+    }
+
     void ModeRet::execution()
     {
         switch (func7_)
         {
-            case Func7Type::Sret:      sret(); break;
+            case Func7Type::Sret:      wfi_ ? wfi() : sret(); break;
             case Func7Type::Mret:      mret(); break;
             case Func7Type::SFenceVMA: sfenceVMA(); break;
 
@@ -192,6 +198,8 @@ namespace rvemu
 
     void ModeRet::writeCsr(CSRInterface &csrs)
     {
+        if (wfi_)
+            return;
         if (func7_ == Func7Type::Sret || func7_ == Func7Type::Mret)
             csrs.write(csrAddr_, csrValue_);
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../BitsManipulation.hpp"
 #include "../Cpu.hpp"
 #include "InstFormat.hpp"
 
@@ -109,7 +110,8 @@ namespace rvemu
     {
       public:
         ModeRet(const InstSizeType is, const AddrType pc, CPU &cpu)
-          : R(is, pc), func7_(takeFunc7()), cpu_(cpu)
+          : R(is, pc), func7_(takeFunc7()), cpu_(cpu),
+            wfi_(func7_ == Func7Type::Sret && BitsManipulation::takeBits(is, 20, 24) == 0b00101)
         { }
 
         void readCsr(const CSRInterface &csr) override;
@@ -121,7 +123,7 @@ namespace rvemu
         AddrType moveNextInst() override;
 
         enum class Func7Type : u8 {
-            Sret      = 0x8,
+            Sret      = 0x8,    // And wfi, told apart by rs2
             SFenceVMA = 0x9,
             Mret      = 0x18,
         };
@@ -134,10 +136,12 @@ namespace rvemu
         RegisterSizeType csrValue_;
         AddrType nextInst_;
         CPU &cpu_;
+        bool wfi_;
 
       private:
         void sret();
         void mret();
         void sfenceVMA();
+        void wfi();
     };
 }    // namespace rvemu
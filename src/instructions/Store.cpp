@@ -18,12 +18,17 @@ namespace rvemu
 
     void Store::accessMemory(SystemInterface &bus)
     {
-        if (func3_ > 2)
+        switch (func3_)
         {
-            std::cerr << "Invalid data size for store instruction\n";
-            abort();
+            case 0: bus.write<u8>(addrToWrite, rs2_); break;     // sb
+            case 1: bus.write<u16>(addrToWrite, rs2_); break;    // sh
+            case 2: bus.write<u32>(addrToWrite, rs2_); break;    // sw
+            case 3: bus.write<u64>(addrToWrite, rs2_); break;    // sd
+            default: {
+                std::cerr << "Invalid data size for store instruction\n";
+                abort();
+            }
         }
-        bus.writeData(addrToWrite, rs2_, DataSizeType(1 << (func3_)));
     }
 
     size_t Store::takeRs1() { return BitsManipulation::takeBits(inst_, 15, 19); }
@@ -0,0 +1,81 @@
+#include "BackgroundCompiler.hpp"
+
+#include "JitEngine.hpp"
+
+#include <chrono>
+
+namespace rvemu
+{
+    BackgroundCompiler::BackgroundCompiler(JitEngine &jit)
+      : jit_(jit), thread_([this] { work(); })
+    { }
+
+    BackgroundCompiler::~BackgroundCompiler()
+    {
+        stop_.store(true, std::memory_order_release);
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    bool BackgroundCompiler::submit(const TranslatedBlock &block)
+    {
+        // Every job in flight must find room in done_: quiesce() waits for the compiler
+        // thread without polling, a full done_ would keep it from finishing.
+        if (pending() >= QUEUE_SIZE)
+            return false;
+
+        auto job           = std::make_unique<CompileJob>();
+        job->blockId       = block.id;
+        job->block.startPC = block.startPC;
+        job->block.endPC   = block.endPC;
+        job->block.ops     = block.ops;
+        if (!jobs_.push(std::move(job)))
+            return false;
+
+        ++submitted_;
+        wake_.fetch_add(1, std::memory_order_release);
+        wake_.notify_one();
+        return true;
+    }
+
+    void BackgroundCompiler::quiesce()
+    {
+        u64 finished = finished_.load(std::memory_order_acquire);
+        while (finished != submitted_)
+        {
+            finished_.wait(finished, std::memory_order_acquire);
+            finished = finished_.load(std::memory_order_acquire);
+        }
+    }
+
+    void BackgroundCompiler::work()
+    {
+        for (;;)
+        {
+            // Read before stop_, a stop request bumps wake_ after setting it.
+            const u64 wake = wake_.load(std::memory_order_acquire);
+            if (stop_.load(std::memory_order_acquire))
+                return;
+
+            while (auto job = jobs_.pop())
+            {
+                CompileJob &current = **job;
+                const auto start    = std::chrono::steady_clock::now();
+                if (jit_.hasRoom())
+                    current.block.native = jit_.compile(current.block);
+                else
+                    current.noRoom = true;
+                current.compileNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::steady_clock::now() - start)
+                                           .count();
+
+                // submit() keeps the jobs in flight within the size of done_.
+                done_.push(std::move(*job));
+                finished_.fetch_add(1, std::memory_order_release);
+                finished_.notify_one();
+            }
+            wake_.wait(wake, std::memory_order_acquire);
+        }
+    }
+}    // namespace rvemu
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "../BlockCache.hpp"
+#include "../RVEmu.hpp"
+#include "../SpscQueue.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace rvemu
+{
+    class JitEngine;
+
+    /// A block handed to the compiler thread and, once done, handed back with its code.
+    struct CompileJob
+    {
+        u64 blockId;                 /// TranslatedBlock::id of the block to compile.
+        TranslatedBlock block;       /// Copy of the block, receives code and exits.
+        bool noRoom      = false;    /// The code arena was too full to compile.
+        u64 compileNanos = 0;
+    };
+
+    /// Thread compiling hot blocks while the hart keeps running their threaded ops.
+    ///
+    /// Jobs and results travel through single-producer single-consumer lock-free queues, the
+    /// hart installs finished code into the block map itself when it drains the results, so
+    /// blocks are only ever modified on the hart thread. The compiler thread is the only one
+    /// emitting code, the hart only patches chain jumps of published code, and must call
+    /// quiesce() before recycling the arena.
+    class BackgroundCompiler
+    {
+      public:
+        /// Jobs that can be in flight in each direction.
+        static constexpr std::size_t QUEUE_SIZE = 256;
+
+        explicit BackgroundCompiler(JitEngine &jit);
+        ~BackgroundCompiler();
+
+        BackgroundCompiler(const BackgroundCompiler &)             = delete;
+        BackgroundCompiler &operator= (const BackgroundCompiler &) = delete;
+
+        /// Queues a block for compilation.
+        /// @return False if QUEUE_SIZE jobs are already submitted and not polled.
+        bool submit(const TranslatedBlock &block);
+
+        /// Returns the next finished job, or nullptr.
+        std::unique_ptr<CompileJob> poll()
+        {
+            auto job = done_.pop();
+            if (!job)
+                return nullptr;
+            ++received_;
+            return std::move(*job);
+        }
+
+        /// Jobs submitted whose result was not polled yet.
+        u64 pending() const { return submitted_ - received_; }
+
+        /// Waits until the compiler thread finished every submitted job.
+        void quiesce();
+
+      private:
+        void work();
+
+        JitEngine &jit_;
+        SpscQueue<std::unique_ptr<CompileJob>, QUEUE_SIZE> jobs_;
+        SpscQueue<std::unique_ptr<CompileJob>, QUEUE_SIZE> done_;
+
+        u64 submitted_ = 0;    /// Hart side count of submitted jobs.
+        u64 received_  = 0;    /// Hart side count of polled results.
+
+        /// Bumped by the hart to wake the compiler thread up.
+        std::atomic<u64> wake_ {0};
+        /// Jobs the compiler thread finished.
+        std::atomic<u64> finished_ {0};
+        std::atomic<bool> stop_ {false};
+
+        std::thread thread_;
+    };
+}    // namespace rvemu
@@ -0,0 +1,26 @@
+#include "CodeBuffer.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <sys/mman.h>
+
+namespace rvemu
+{
+    CodeBuffer::CodeBuffer(std::size_t capacity) : capacity_(capacity), used_(0)
+    {
+        void *mem = mmap(nullptr,
+                         capacity,
+                         PROT_READ | PROT_WRITE | PROT_EXEC,
+                         MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1,
+                         0);
+        if (mem == MAP_FAILED)
+        {
+            std::cerr << "Failed to map the JIT code buffer\n";
+            abort();
+        }
+        base_ = static_cast<u8 *>(mem);
+    }
+
+    CodeBuffer::~CodeBuffer() { munmap(base_, capacity_); }
+}    // namespace rvemu
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+#include <cstddef>
+
+namespace rvemu
+{
+    /// Executable memory arena the JIT emits native code into.
+    ///
+    /// Code is bump-allocated and never freed piecemeal, when the arena runs out the owner
+    /// drops every translated block and calls reset().
+    class CodeBuffer
+    {
+      public:
+        /// @param capacity The size in bytes of the arena.
+        explicit CodeBuffer(std::size_t capacity);
+        ~CodeBuffer();
+
+        CodeBuffer(const CodeBuffer &)             = delete;
+        CodeBuffer &operator= (const CodeBuffer &) = delete;
+
+        /// Address the next emitted byte goes to.
+        u8 *cursor() const { return base_ + used_; }
+
+        /// Number of bytes still available.
+        std::size_t remaining() const { return capacity_ - used_; }
+
+        /// Marks the bytes up to end as used.
+        void commit(const u8 *end) { used_ = end - base_; }
+
+        /// Discards every emitted byte.
+        void reset() { used_ = 0; }
+
+      private:
+        u8 *base_;
+        std::size_t capacity_;
+        std::size_t used_;
+    };
+}    // namespace rvemu
@@ -0,0 +1,669 @@
+#include "JitEngine.hpp"
+
+#include "../Cpu.hpp"
+#include "../ThreadedEngine.hpp"
+#include "X86Emitter.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+namespace rvemu
+{
+    namespace
+    {
+        constexpr X86Reg REGS = X86Reg::Rbx;
+        constexpr X86Reg MEM  = X86Reg::R12;
+        constexpr X86Reg CTX  = X86Reg::R13;
+
+        constexpr i64 regOffset(u8 reg) { return reg * sizeof(RegisterSizeType); }
+
+        constexpr std::size_t limitIndex(DataSizeType size)
+        {
+            switch (size)
+            {
+                case Byte:       return 0;
+                case HalfWord:   return 1;
+                case Word:       return 2;
+                case DoubleWord: return 3;
+            }
+            return 0;
+        }
+
+        /// Wraps a byte offset into JitContext::ras.
+        constexpr int32_t RAS_MASK = (std::tuple_size_v<decltype(JitContext::ras)> - 1)
+                                     * sizeof(BlockExit *);
+
+        bool fitsInt32(i64 value) { return value >= INT32_MIN && value <= INT32_MAX; }
+
+        /// Emits the code of one block.
+        class BlockCompiler
+        {
+          public:
+            BlockCompiler(u8 *begin, u8 *end) : as_(begin, end) { }
+
+            /// Compiles the supported prefix of a block, replacing its exits with the ones of
+            /// the compiled code.
+            NativeBlock compile(TranslatedBlock &block)
+            {
+                block_ = &block;
+                block.exits.clear();
+                block.exits.reserve(TranslatedBlock::MAX_EXITS);
+
+                as_.push(X86Reg::Rbx);
+                as_.push(X86Reg::R12);
+                as_.push(X86Reg::R13);
+                as_.mov(CTX, X86Reg::Rdi);
+                as_.load64(REGS, CTX, offsetof(JitContext, regs));
+                as_.load64(MEM, CTX, offsetof(JitContext, memory));
+                block.chainEntry = as_.cursor();
+
+                std::size_t compiled = 0;
+                bool terminated      = false;
+                for (const ThreadedOp &op : block.ops)
+                {
+                    retired_ = instsBefore(op.pc + instLength(op.inst.kind));
+                    if (!compileInst(op.inst, op.pc))
+                        break;
+                    ++compiled;
+                    terminated = ThreadedEngine::endsBlock(op.inst.kind) || isAtomic(op.inst.kind);
+                    if (terminated)
+                        break;
+                }
+
+                if (compiled == 0)
+                {
+                    block.chainEntry = nullptr;
+                    block.exits.clear();
+                    return nullptr;
+                }
+
+                // Falling off the compiled prefix continues at the first instruction left out,
+                // the exit op if the whole block was compiled. Optimized out instructions may
+                // sit between the two.
+                if (!terminated)
+                {
+                    retired_ = instsBefore(block.ops[compiled].pc);
+                    exitTo(block.ops[compiled].pc);
+                }
+
+                u8 *epilogue = as_.cursor();
+                as_.pop(X86Reg::R13);
+                as_.pop(X86Reg::R12);
+                as_.pop(X86Reg::Rbx);
+                as_.ret();
+
+                for (X86Emitter::Fixup fixup : epilogueJumps_)
+                    patch(fixup, epilogue);
+                for (const auto &[fixup, exit, retired] : exits_)
+                {
+                    patch(fixup, as_.cursor());
+                    countRetired(retired);
+                    as_.aluMemImm(X86Alu::Sub, CTX, offsetof(JitContext, chainBudget), 1);
+                    const X86Emitter::Fixup exhausted = as_.jcc(X86Cond::E);
+                    exit->jump                        = as_.jmp();
+
+                    exit->unchained = as_.cursor();
+                    patch(exhausted, exit->unchained);
+                    patch(exit->jump, exit->unchained);
+                    as_.movImm64(X86Reg::Rcx, reinterpret_cast<u64>(exit));
+                    as_.store64(CTX, offsetof(JitContext, lastExit), X86Reg::Rcx);
+                    as_.movImm64(X86Reg::Rax, exit->target);
+                    as_.jmpTo(epilogue);
+                }
+                for (const auto &[fixup, pc] : sideExits_)
+                {
+                    patch(fixup, as_.cursor());
+                    countRetired(instsBefore(pc));
+                    as_.storeImm64(CTX, offsetof(JitContext, sideExit), 1);
+                    as_.movImm64(X86Reg::Rax, pc);
+                    as_.jmpTo(epilogue);
+                }
+
+                if (as_.overflowed())
+                    return nullptr;
+                return reinterpret_cast<NativeBlock>(as_.begin());
+            }
+
+            u8 *end() const { return as_.cursor(); }
+
+          private:
+            using enum InstKind;
+
+            /// A jump to the stub of a direct exit.
+            struct Exit
+            {
+                X86Emitter::Fixup fixup;
+                BlockExit *exit;
+                u64 retired;    /// Guest instructions run when leaving through the exit.
+            };
+
+            /// A jump leaving the block before the instruction at pc.
+            struct SideExit
+            {
+                X86Emitter::Fixup fixup;
+                AddrType pc;
+            };
+
+            /// Number of guest instructions of the block before the one at pc.
+            u64 instsBefore(AddrType pc) const
+            {
+                return (pc - block_->startPC) / DataSizeType::Word;
+            }
+
+            void countRetired(u64 count)
+            {
+                if (count != 0)
+                    as_.aluMemImm(X86Alu::Add, CTX, offsetof(JitContext, retired), count);
+            }
+
+            void patch(X86Emitter::Fixup fixup, const u8 *target)
+            {
+                if (!as_.overflowed())
+                    X86Emitter::patch(fixup, target);
+            }
+
+            void loadReg(X86Reg dst, u8 reg)
+            {
+                if (reg == Zero)
+                    as_.zero(dst);
+                else
+                    as_.load64(dst, REGS, regOffset(reg));
+            }
+
+            void storeReg(u8 reg, X86Reg src)
+            {
+                if (reg != Zero)
+                    as_.store64(REGS, regOffset(reg), src);
+            }
+
+            void storeRegImm(u8 reg, RegisterSizeType value)
+            {
+                if (reg == Zero)
+                    return;
+                if (fitsInt32(static_cast<i64>(value)))
+                    as_.storeImm64(REGS, regOffset(reg), static_cast<int32_t>(value));
+                else
+                {
+                    // rcx, so that a target computed into rax survives.
+                    as_.movImm64(X86Reg::Rcx, value);
+                    as_.store64(REGS, regOffset(reg), X86Reg::Rcx);
+                }
+            }
+
+            BlockExit *addExit(ExitKind kind, AddrType target)
+            {
+                assert(block_->exits.size() < TranslatedBlock::MAX_EXITS);
+                return &block_->exits.emplace_back(BlockExit {kind, target});
+            }
+
+            /// Leaves the block for a fixed guest address.
+            void exitTo(AddrType target)
+            {
+                exits_.push_back({as_.jmp(), addExit(ExitKind::Direct, target), retired_});
+            }
+
+            /// Emits a call's push of its return exit on the return-address stack.
+            void pushReturn(AddrType returnPC)
+            {
+                BlockExit *exit = addExit(ExitKind::Return, returnPC);
+                as_.load64(X86Reg::Rcx, CTX, offsetof(JitContext, rasTop));
+                as_.aluImm(X86Alu::Add, X86Reg::Rcx, sizeof(BlockExit *));
+                as_.aluImm(X86Alu::And, X86Reg::Rcx, RAS_MASK);
+                as_.store64(CTX, offsetof(JitContext, rasTop), X86Reg::Rcx);
+                as_.alu(X86Alu::Add, X86Reg::Rcx, CTX);
+                as_.movImm64(X86Reg::Rdx, reinterpret_cast<u64>(exit));
+                as_.store64(X86Reg::Rcx, offsetof(JitContext, ras), X86Reg::Rdx);
+            }
+
+            /// Emits the jump to the block chained to the exit in rcx, which must lead to the
+            /// guest address in rax. Jumps to leave when the exit is not chained or the
+            /// budget ran out.
+            void jumpChained(std::vector<X86Emitter::Fixup> &leave)
+            {
+                as_.load64(X86Reg::Rdx, X86Reg::Rcx, offsetof(BlockExit, entry));
+                as_.aluImm(X86Alu::Cmp, X86Reg::Rdx, 0);
+                leave.push_back(as_.jcc(X86Cond::E));
+                as_.aluMemImm(X86Alu::Sub, CTX, offsetof(JitContext, chainBudget), 1);
+                leave.push_back(as_.jcc(X86Cond::E));
+                as_.jmpReg(X86Reg::Rdx);
+            }
+
+            /// Emits the end of a jalr, with rax holding the target.
+            void emitIndirectExit(const DecodedInst &inst)
+            {
+                std::vector<X86Emitter::Fixup> leave;
+                std::vector<X86Emitter::Fixup> notPredicted;
+                countRetired(retired_);
+
+                // A return first tries the exit pushed by the matching call.
+                if (inst.rd == Zero && inst.rs1 == RA)
+                {
+                    as_.load64(X86Reg::Rcx, CTX, offsetof(JitContext, rasTop));
+                    as_.mov(X86Reg::Rdx, X86Reg::Rcx);
+                    as_.alu(X86Alu::Add, X86Reg::Rcx, CTX);
+                    as_.load64(X86Reg::Rcx, X86Reg::Rcx, offsetof(JitContext, ras));
+                    as_.aluImm(X86Alu::Sub, X86Reg::Rdx, sizeof(BlockExit *));
+                    as_.aluImm(X86Alu::And, X86Reg::Rdx, RAS_MASK);
+                    as_.store64(CTX, offsetof(JitContext, rasTop), X86Reg::Rdx);
+
+                    as_.aluImm(X86Alu::Cmp, X86Reg::Rcx, 0);
+                    notPredicted.push_back(as_.jcc(X86Cond::E));
+                    as_.aluMem(X86Alu::Cmp, X86Reg::Rax, X86Reg::Rcx, offsetof(BlockExit, target));
+                    notPredicted.push_back(as_.jcc(X86Cond::NE));
+                    jumpChained(leave);
+                }
+
+                for (X86Emitter::Fixup fixup : notPredicted)
+                    patch(fixup, as_.cursor());
+                BlockExit *cache = addExit(ExitKind::Indirect, 0);
+                as_.movImm64(X86Reg::Rcx, reinterpret_cast<u64>(cache));
+                as_.aluMem(X86Alu::Cmp, X86Reg::Rax, X86Reg::Rcx, offsetof(BlockExit, target));
+                leave.push_back(as_.jcc(X86Cond::NE));
+                jumpChained(leave);
+
+                for (X86Emitter::Fixup fixup : leave)
+                    patch(fixup, as_.cursor());
+                as_.store64(CTX, offsetof(JitContext, lastExit), X86Reg::Rcx);
+                epilogueJumps_.push_back(as_.jmp());
+            }
+
+            /// Computes the DRAM offset of a load or store into rdx, leaving through a side
+            /// exit if the access is misaligned or outside of DRAM.
+            void emitAddress(const DecodedInst &inst, AddrType pc, DataSizeType size)
+            {
+                // The block optimizer folds constant addresses into the immediate.
+                if (inst.rs1 == Zero)
+                    as_.movImm64(X86Reg::Rdx, inst.imm);
+                else
+                {
+                    loadReg(X86Reg::Rdx, inst.rs1);
+                    as_.lea(X86Reg::Rdx, X86Reg::Rdx, static_cast<i64>(inst.imm));
+                }
+                as_.aluMem(X86Alu::Sub, X86Reg::Rdx, CTX, offsetof(JitContext, memoryBase));
+                as_.aluMem(X86Alu::Cmp,
+                           X86Reg::Rdx,
+                           CTX,
+                           offsetof(JitContext, memoryLimit) + limitIndex(size) * sizeof(u64));
+                sideExits_.push_back({as_.jcc(X86Cond::A), pc});
+                if (size != Byte)
+                {
+                    as_.test32(X86Reg::Rdx, size - 1);
+                    sideExits_.push_back({as_.jcc(X86Cond::NE), pc});
+                }
+            }
+
+            void emitLoad(const DecodedInst &inst, AddrType pc, DataSizeType size, bool sign)
+            {
+                emitAddress(inst, pc, size);
+                as_.loadIndexed(X86Reg::Rax, MEM, X86Reg::Rdx, size, sign);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            void emitStore(const DecodedInst &inst, AddrType pc, DataSizeType size)
+            {
+                emitAddress(inst, pc, size);
+
+                // The access is aligned, so it stays inside the page of its first byte.
+                as_.mov(X86Reg::Rcx, X86Reg::Rdx);
+                as_.shiftImm(X86Shift::Shr, X86Reg::Rcx, BlockCache::PAGE_SHIFT);
+                as_.load64(X86Reg::Rsi, CTX, offsetof(JitContext, codePages));
+                as_.cmpByteIndexed(X86Reg::Rsi, X86Reg::Rcx, 0);
+                sideExits_.push_back({as_.jcc(X86Cond::NE), pc});
+
+                loadReg(X86Reg::Rax, inst.rs2);
+                as_.storeIndexed(MEM, X86Reg::Rdx, X86Reg::Rax, size);
+            }
+
+            void emitBranch(const DecodedInst &inst, AddrType pc, X86Cond taken)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                loadReg(X86Reg::Rcx, inst.rs2);
+                as_.alu(X86Alu::Cmp, X86Reg::Rax, X86Reg::Rcx);
+                exits_.push_back(
+                    {as_.jcc(taken), addExit(ExitKind::Direct, pc + inst.imm), retired_});
+                exitTo(pc + DataSizeType::Word);
+            }
+
+            /// rd = rs1 < rs2, then a branch on rd being non-zero or zero.
+            void emitSetBranch(const DecodedInst &inst, AddrType pc, X86Cond less, bool ifSet)
+            {
+                emitSet(inst, less);
+                as_.test32(X86Reg::Rax, 1);
+                const X86Cond taken = ifSet ? X86Cond::NE : X86Cond::E;
+                exits_.push_back(
+                    {as_.jcc(taken), addExit(ExitKind::Direct, pc + inst.imm), retired_});
+                exitTo(pc + instLength(inst.kind));
+            }
+
+            /// rd = rs1 op imm
+            void emitAluImm(const DecodedInst &inst, X86Alu op, bool word = false)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                as_.aluImm(op, X86Reg::Rax, static_cast<int32_t>(inst.imm));
+                if (word)
+                    as_.movsxd(X86Reg::Rax, X86Reg::Rax);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// rd = rs1 < imm
+            void emitSetImm(const DecodedInst &inst, X86Cond cond)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                as_.aluImm(X86Alu::Cmp, X86Reg::Rax, static_cast<int32_t>(inst.imm));
+                as_.setcc(cond, X86Reg::Rax);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// rd = rs1 shift shamt
+            void emitShiftImm(const DecodedInst &inst, X86Shift op, bool word = false)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                if (word)
+                {
+                    as_.shiftImm32(op, X86Reg::Rax, inst.imm);
+                    as_.movsxd(X86Reg::Rax, X86Reg::Rax);
+                }
+                else
+                    as_.shiftImm(op, X86Reg::Rax, inst.imm);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// rd = rs1 op rs2
+            void emitAlu(const DecodedInst &inst, X86Alu op, bool word = false)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                loadReg(X86Reg::Rcx, inst.rs2);
+                as_.alu(op, X86Reg::Rax, X86Reg::Rcx);
+                if (word)
+                    as_.movsxd(X86Reg::Rax, X86Reg::Rax);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// rd = rs1 < rs2
+            void emitSet(const DecodedInst &inst, X86Cond cond)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                loadReg(X86Reg::Rcx, inst.rs2);
+                as_.alu(X86Alu::Cmp, X86Reg::Rax, X86Reg::Rcx);
+                as_.setcc(cond, X86Reg::Rax);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// rd = rs1 shift rs2, x86 masks the count like RISC-V does.
+            void emitShift(const DecodedInst &inst, X86Shift op, bool word = false)
+            {
+                loadReg(X86Reg::Rax, inst.rs1);
+                loadReg(X86Reg::Rcx, inst.rs2);
+                if (word)
+                {
+                    as_.shiftCl32(op, X86Reg::Rax);
+                    as_.movsxd(X86Reg::Rax, X86Reg::Rax);
+                }
+                else
+                    as_.shiftCl(op, X86Reg::Rax);
+                storeReg(inst.rd, X86Reg::Rax);
+            }
+
+            /// Emits one instruction.
+            /// @return False if the instruction has no native translation.
+            bool compileInst(const DecodedInst &inst, AddrType pc)
+            {
+                // Atomics leave for step(), which runs them on host atomics.
+                if (isAtomic(inst.kind))
+                {
+                    sideExits_.push_back({as_.jmp(), pc});
+                    return true;
+                }
+
+                // Fused pairs never take a side exit, counting them up front is exact.
+                if (isFused(inst.kind))
+                    as_.aluMemImm(X86Alu::Add, CTX, offsetof(JitContext, fused), 1);
+
+                switch (inst.kind)
+                {
+                    case Lui:   storeRegImm(inst.rd, inst.imm); break;
+                    case Auipc: storeRegImm(inst.rd, pc + inst.imm); break;
+                    case Jal:
+                        storeRegImm(inst.rd, pc + DataSizeType::Word);
+                        if (inst.rd == RA)
+                            pushReturn(pc + DataSizeType::Word);
+                        exitTo(pc + inst.imm);
+                        break;
+                    case Jalr:
+                        loadReg(X86Reg::Rax, inst.rs1);
+                        as_.aluImm(X86Alu::Add, X86Reg::Rax, static_cast<int32_t>(inst.imm));
+                        as_.aluImm(X86Alu::And, X86Reg::Rax, -2);
+                        storeRegImm(inst.rd, pc + DataSizeType::Word);
+                        if (inst.rd == RA)
+                            pushReturn(pc + DataSizeType::Word);
+                        emitIndirectExit(inst);
+                        break;
+
+                    case Beq:  emitBranch(inst, pc, X86Cond::E); break;
+                    case Bne:  emitBranch(inst, pc, X86Cond::NE); break;
+                    case Blt:  emitBranch(inst, pc, X86Cond::L); break;
+                    case Bge:  emitBranch(inst, pc, X86Cond::GE); break;
+                    case Bltu: emitBranch(inst, pc, X86Cond::B); break;
+                    case Bgeu: emitBranch(inst, pc, X86Cond::AE); break;
+
+                    case Lb:  emitLoad(inst, pc, Byte, true); break;
+                    case Lh:  emitLoad(inst, pc, HalfWord, true); break;
+                    case Lw:  emitLoad(inst, pc, Word, true); break;
+                    case Ld:  emitLoad(inst, pc, DoubleWord, false); break;
+                    case Lbu: emitLoad(inst, pc, Byte, false); break;
+                    case Lhu: emitLoad(inst, pc, HalfWord, false); break;
+                    case Lwu: emitLoad(inst, pc, Word, false); break;
+
+                    case Sb: emitStore(inst, pc, Byte); break;
+                    case Sh: emitStore(inst, pc, HalfWord); break;
+                    case Sw: emitStore(inst, pc, Word); break;
+                    case Sd: emitStore(inst, pc, DoubleWord); break;
+
+                    case Addi:  emitAluImm(inst, X86Alu::Add); break;
+                    case Slti:  emitSetImm(inst, X86Cond::L); break;
+                    case Sltiu: emitSetImm(inst, X86Cond::B); break;
+                    case Xori:  emitAluImm(inst, X86Alu::Xor); break;
+                    case Ori:   emitAluImm(inst, X86Alu::Or); break;
+                    case Andi:  emitAluImm(inst, X86Alu::And); break;
+                    case Slli:  emitShiftImm(inst, X86Shift::Shl); break;
+                    case Srli:  emitShiftImm(inst, X86Shift::Shr); break;
+                    case Srai:  emitShiftImm(inst, X86Shift::Sar); break;
+
+                    case Addiw: emitAluImm(inst, X86Alu::Add, true); break;
+                    case Slliw: emitShiftImm(inst, X86Shift::Shl, true); break;
+                    case Srliw: emitShiftImm(inst, X86Shift::Shr, true); break;
+                    case Sraiw: emitShiftImm(inst, X86Shift::Sar, true); break;
+
+                    case Add:  emitAlu(inst, X86Alu::Add); break;
+                    case Sub:  emitAlu(inst, X86Alu::Sub); break;
+                    case Sll:  emitShift(inst, X86Shift::Shl); break;
+                    case Slt:  emitSet(inst, X86Cond::L); break;
+                    case Sltu: emitSet(inst, X86Cond::B); break;
+                    case Xor:  emitAlu(inst, X86Alu::Xor); break;
+                    case Srl:  emitShift(inst, X86Shift::Shr); break;
+                    case Sra:  emitShift(inst, X86Shift::Sar); break;
+                    case Or:   emitAlu(inst, X86Alu::Or); break;
+                    case And:  emitAlu(inst, X86Alu::And); break;
+                    case Mul:
+                        loadReg(X86Reg::Rax, inst.rs1);
+                        loadReg(X86Reg::Rcx, inst.rs2);
+                        as_.imul(X86Reg::Rax, X86Reg::Rcx);
+                        storeReg(inst.rd, X86Reg::Rax);
+                        break;
+
+                    case Addw: emitAlu(inst, X86Alu::Add, true); break;
+                    case Subw: emitAlu(inst, X86Alu::Sub, true); break;
+                    case Sllw: emitShift(inst, X86Shift::Shl, true); break;
+                    case Srlw: emitShift(inst, X86Shift::Shr, true); break;
+                    case Sraw: emitShift(inst, X86Shift::Sar, true); break;
+
+                    // x86 only reorders a store with a later load, which a fence must not.
+                    case Fence: as_.mfence(); break;
+
+                    case LuiAddi:   storeRegImm(inst.rd, inst.imm); break;
+                    case AuipcAddi: storeRegImm(inst.rd, pc + inst.imm); break;
+                    case AuipcJalr: {
+                        const AddrType next = pc + instLength(inst.kind);
+                        storeRegImm(inst.rs1, pc + ((inst.imm + 0x800) & ~0xfffULL));
+                        storeRegImm(inst.rd, next);
+                        if (inst.rd == RA)
+                            pushReturn(next);
+                        exitTo((pc + inst.imm) & ~1ULL);
+                        break;
+                    }
+                    case ZextW:
+                        loadReg(X86Reg::Rax, inst.rs1);
+                        as_.mov32(X86Reg::Rax, X86Reg::Rax);
+                        storeReg(inst.rd, X86Reg::Rax);
+                        break;
+                    case SltBnez:  emitSetBranch(inst, pc, X86Cond::L, true); break;
+                    case SltBeqz:  emitSetBranch(inst, pc, X86Cond::L, false); break;
+                    case SltuBnez: emitSetBranch(inst, pc, X86Cond::B, true); break;
+                    case SltuBeqz: emitSetBranch(inst, pc, X86Cond::B, false); break;
+
+                    default: return false;
+                }
+                return true;
+            }
+
+            X86Emitter as_;
+            TranslatedBlock *block_ = nullptr;
+            std::vector<Exit> exits_;
+            std::vector<SideExit> sideExits_;
+            std::vector<X86Emitter::Fixup> epilogueJumps_;    /// Exits with rax already set.
+            /// Guest instructions run up to the end of the instruction being compiled.
+            u64 retired_ = 0;
+        };
+    }    // namespace
+
+    JitEngine::JitEngine() : code_(CODE_BUFFER_SIZE), ctx_ {} { }
+
+    void JitEngine::attach(CPU &cpu)
+    {
+        ctx_.regs       = cpu.getRegs().data();
+        ctx_.memory     = cpu.getDRAM().data();
+        ctx_.codePages  = cpu.getBlockCache().codePageMap();
+        ctx_.memoryBase = DRAM_BASE;
+        for (DataSizeType size : {Byte, HalfWord, Word, DoubleWord})
+            ctx_.memoryLimit[limitIndex(size)] = cpu.getDRAM().size() - size;
+        ctx_.sideExit = 0;
+        ctx_.rasTop   = 0;
+        ctx_.ras.fill(nullptr);
+    }
+
+    void JitEngine::recycle(CPU &cpu)
+    {
+        cpu.flushCodeCaches();
+        blocksDropped();
+        cpu.getBlockCache().releaseDropped();
+        code_.reset();
+    }
+
+    NativeBlock JitEngine::compile(TranslatedBlock &block)
+    {
+#if defined(__x86_64__)
+        std::vector<BlockExit> threadedExits = block.exits;
+
+        BlockCompiler compiler(code_.cursor(), code_.cursor() + code_.remaining());
+        NativeBlock native = compiler.compile(block);
+        if (native != nullptr)
+            code_.commit(compiler.end());
+        else
+            block.exits = std::move(threadedExits);
+        return native;
+#else
+        return nullptr;
+#endif
+    }
+
+    BlockExit *JitEngine::execute(CPU &cpu, TranslatedBlock &block)
+    {
+        // Chained blocks may not go over the budget, nor past a stop pc they cannot see.
+        const u64 fullBlocks =
+            cpu.hasStopPC() ? 1 : cpu.getBudget() / ThreadedEngine::MAX_BLOCK_WORDS;
+        ctx_.lastExit        = nullptr;
+        ctx_.chainBudget     = std::clamp<u64>(fullBlocks, 1, CHAIN_BUDGET);
+        ctx_.retired         = 0;
+        ctx_.fused           = 0;
+        cpu.setPC(block.native(&ctx_));
+        cpu.retire(ctx_.retired);
+        cpu.retireFused(ctx_.fused);
+        if (ctx_.sideExit == 0)
+            return ctx_.lastExit;
+
+        ctx_.sideExit = 0;
+        cpu.step();
+        return nullptr;
+    }
+
+    void JitEngine::link(BlockCache &cache, BlockExit &exit, TranslatedBlock *target)
+    {
+        if (exit.kind != ExitKind::Indirect && exit.target != target->startPC)
+            return;
+
+        cache.link(exit, target);
+        if (target->chainEntry != nullptr)
+        {
+            exit.entry = target->chainEntry;
+            if (exit.jump != nullptr)
+                X86Emitter::patch(exit.jump, target->chainEntry);
+        }
+    }
+
+    void JitEngine::run(CPU &cpu)
+    {
+#if defined(__x86_64__)
+        BlockCache &cache = cpu.getBlockCache();
+        attach(cpu);
+
+        // Exit of the previous block that led to pc, if it can be chained.
+        BlockExit *taken = nullptr;
+        while (!cpu.shouldStop())
+        {
+            const AddrType pc      = cpu.getPC();
+            TranslatedBlock *block = follow(taken, pc);
+            if (block == nullptr)
+            {
+                block = cache.lookup(pc);
+                if (block == nullptr)
+                {
+                    if (makeRoom(cpu))
+                        taken = nullptr;
+                    block         = cache.insert(ThreadedEngine::translate(cpu, pc));
+                    block->native = compile(*block);
+                }
+                if (taken != nullptr)
+                    link(cache, *taken, block);
+            }
+
+            if (!cpu.canRunBlock(block->startPC, block->endPC))
+            {
+                cpu.step();
+                taken = nullptr;
+            }
+            else if (block->native != nullptr)
+                taken = execute(cpu, *block);
+            else
+            {
+                const AddrType next = ThreadedEngine::runOps(cpu, *block);
+                taken               = block->exitTo(next);
+            }
+
+            if (cache.hasDropped())
+            {
+                taken = nullptr;
+                blocksDropped();
+                cache.releaseDropped();
+            }
+
+            if (cpu.isTracing())
+                cpu.dumpState();
+        }
+#else
+        ThreadedEngine::run(cpu);
+#endif
+    }
+}    // namespace rvemu
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "../BlockCache.hpp"
+#include "../RVEmu.hpp"
+#include "CodeBuffer.hpp"
+
+#include <array>
+#include <cstddef>
+
+namespace rvemu
+{
+    class CPU;
+
+    /// State shared between the dispatcher and compiled blocks. Compiled code addresses the
+    /// fields through fixed offsets, so the layout must stay standard.
+    struct JitContext
+    {
+        RegisterSizeType *regs;      /// The guest integer registers.
+        std::byte *memory;           /// Host address of the first DRAM byte.
+        const u8 *codePages;         /// BlockCache::codePageMap().
+        AddrType memoryBase;         /// Guest address of the first DRAM byte.
+        /// Highest DRAM offset an access of 1, 2, 4 and 8 bytes may start at.
+        std::array<u64, 4> memoryLimit;
+        /// Set by a block that stopped before an instruction it cannot execute natively.
+        u64 sideExit;
+        /// Exit the code left through, for the dispatcher to chain it.
+        BlockExit *lastExit;
+        /// Chained transfers left before control goes back to the dispatcher.
+        u64 chainBudget;
+        /// Guest instructions run since the dispatcher called the code.
+        u64 retired;
+        /// Fused pairs among them.
+        u64 fused;
+        /// Byte offset in ras of the top entry.
+        u64 rasTop;
+        /// Return-address stack: the return exits of the calls in flight. A return whose
+        /// target matches the top entry jumps straight into the block chained to it.
+        std::array<BlockExit *, 16> ras;
+    };
+
+    /// Execution engine compiling basic blocks of RV64I to x86-64.
+    ///
+    /// Blocks are discovered by the threaded engine and share its cache, the JIT compiles the
+    /// longest prefix of a block made of instructions it supports (integer ALU, loads,
+    /// stores, branches and jumps). A block whose first instruction is not supported keeps
+    /// running through its threaded ops.
+    ///
+    /// Guest registers stay in memory, compiled code pins rbx to the register file, r12 to
+    /// the host copy of DRAM and r13 to the JitContext. A load or store that is misaligned,
+    /// outside of DRAM or, for stores, hits a page holding translated code leaves the block
+    /// through a side exit, the dispatcher then executes that single instruction with the
+    /// interpreter, so translated code never calls back into C++.
+    ///
+    /// Exits are chained lazily: the first time an exit returns to the dispatcher its jump is
+    /// patched to enter the successor past its frame setup. A jalr checks the return-address
+    /// stack when it is a return, then a per-site cache of its last target. A chained
+    /// transfer costs one unit of the budget the dispatcher grants each call, so control
+    /// still comes back regularly. The budget is smaller when the instruction budget of the
+    /// run is nearly spent, and chaining is off while the run has a stop pc.
+    ///
+    /// On hosts other than x86-64 run() falls back to the threaded engine.
+    class JitEngine
+    {
+      public:
+        /// Size of the executable arena, every block is dropped when it fills up.
+        static constexpr std::size_t CODE_BUFFER_SIZE = 16 * 1024 * 1024;
+
+        /// Chained transfers compiled code may make before returning to the dispatcher.
+        static constexpr u64 CHAIN_BUDGET = 4096;
+
+        /// Free space below which the arena is recycled before compiling another block, larger
+        /// than the code of any block.
+        static constexpr std::size_t MIN_FREE_CODE = 64 * 1024;
+
+        JitEngine();
+
+        /// Runs the program on the given hart until the run has to stop.
+        void run(CPU &cpu);
+
+        /// Points compiled code at the state of a hart.
+        void attach(CPU &cpu);
+
+        /// Whether the code arena can take another block.
+        bool hasRoom() const { return code_.remaining() >= MIN_FREE_CODE; }
+
+        /// Drops every translated block and empties the code arena.
+        void recycle(CPU &cpu);
+
+        /// Recycles the code arena if it is nearly full.
+        /// @return True if the blocks were dropped.
+        bool makeRoom(CPU &cpu)
+        {
+            if (hasRoom())
+                return false;
+            recycle(cpu);
+            return true;
+        }
+
+        /// Compiles the supported prefix of a block, replacing its exits with the ones of the
+        /// compiled code. The exits must not be chained. Only touches the block and the arena,
+        /// so it may run on another thread while the hart neither compiles nor recycles.
+        /// @return The entry point, or nullptr if no instruction could be compiled.
+        NativeBlock compile(TranslatedBlock &block);
+
+        /// Runs a compiled block and whatever it chains to, leaving the next address in pc.
+        /// @return The exit the code left through, or nullptr if it cannot be chained.
+        BlockExit *execute(CPU &cpu, TranslatedBlock &block);
+
+        /// Chains an exit to the block it led to, patching compiled code if target has some.
+        static void link(BlockCache &cache, BlockExit &exit, TranslatedBlock *target);
+
+        /// Returns the block the exit taken to reach pc is chained to, or nullptr if the exit
+        /// has to be linked first. An exit chained before its target was compiled is linked
+        /// again so it enters the compiled code.
+        static TranslatedBlock *follow(const BlockExit *taken, AddrType pc)
+        {
+            if (taken == nullptr || taken->linked == nullptr || taken->linked->startPC != pc)
+                return nullptr;
+            if (taken->linked->chainEntry != nullptr && taken->entry == nullptr)
+                return nullptr;
+            return taken->linked;
+        }
+
+        /// Forgets the exits of dropped blocks. Must be called before they are released.
+        void blocksDropped() { ctx_.ras.fill(nullptr); }
+
+      private:
+        CodeBuffer code_;
+        JitContext ctx_;
+    };
+}    // namespace rvemu
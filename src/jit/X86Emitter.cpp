@@ -0,0 +1,370 @@
+#include "X86Emitter.hpp"
+
+#include <cassert>
+#include <cstring>
+
+namespace rvemu
+{
+    namespace
+    {
+        u8 low(X86Reg reg) { return static_cast<u8>(reg) & 0b111; }
+
+        u8 id(X86Reg reg) { return static_cast<u8>(reg); }
+
+        bool fitsInt8(i64 value) { return value >= INT8_MIN && value <= INT8_MAX; }
+
+        bool fitsInt32(i64 value) { return value >= INT32_MIN && value <= INT32_MAX; }
+    }    // namespace
+
+    void X86Emitter::emit8(u8 byte)
+    {
+        if (cursor_ >= end_)
+        {
+            overflowed_ = true;
+            return;
+        }
+        *cursor_++ = byte;
+    }
+
+    void X86Emitter::emit32(u32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+            emit8(value >> (8 * i));
+    }
+
+    void X86Emitter::emit64(u64 value)
+    {
+        for (int i = 0; i < 8; ++i)
+            emit8(value >> (8 * i));
+    }
+
+    void X86Emitter::rex(bool wide, u8 reg, u8 index, u8 base, bool force)
+    {
+        u8 prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+        if (prefix != 0x40 || force)
+            emit8(prefix);
+    }
+
+    void X86Emitter::modrmMem(u8 reg, X86Reg base, i64 disp)
+    {
+        assert(fitsInt32(disp));
+        u8 mod = 0b10;
+        if (disp == 0 && low(base) != 0b101)
+            mod = 0b00;
+        else if (fitsInt8(disp))
+            mod = 0b01;
+
+        emit8((mod << 6) | ((reg & 0b111) << 3) | low(base));
+        // rsp and r12 as a base need a SIB byte.
+        if (low(base) == 0b100)
+            emit8(0x24);
+
+        if (mod == 0b01)
+            emit8(disp);
+        else if (mod == 0b10)
+            emit32(disp);
+    }
+
+    void X86Emitter::modrmIndexed(u8 reg, X86Reg base, X86Reg index)
+    {
+        assert(index != X86Reg::Rsp);
+        // rbp and r13 as a base need an explicit displacement.
+        const bool needDisp = low(base) == 0b101;
+        emit8(((needDisp ? 0b01 : 0b00) << 6) | ((reg & 0b111) << 3) | 0b100);
+        emit8((low(index) << 3) | low(base));
+        if (needDisp)
+            emit8(0);
+    }
+
+    void X86Emitter::modrmReg(u8 reg, X86Reg rm) { emit8(0xc0 | ((reg & 0b111) << 3) | low(rm)); }
+
+    void X86Emitter::push(X86Reg reg)
+    {
+        rex(false, 0, 0, id(reg));
+        emit8(0x50 + low(reg));
+    }
+
+    void X86Emitter::pop(X86Reg reg)
+    {
+        rex(false, 0, 0, id(reg));
+        emit8(0x58 + low(reg));
+    }
+
+    void X86Emitter::ret() { emit8(0xc3); }
+
+    void X86Emitter::mfence()
+    {
+        emit8(0x0f);
+        emit8(0xae);
+        emit8(0xf0);
+    }
+
+    void X86Emitter::load64(X86Reg dst, X86Reg base, i64 disp)
+    {
+        rex(true, id(dst), 0, id(base));
+        emit8(0x8b);
+        modrmMem(id(dst), base, disp);
+    }
+
+    void X86Emitter::store64(X86Reg base, i64 disp, X86Reg src)
+    {
+        rex(true, id(src), 0, id(base));
+        emit8(0x89);
+        modrmMem(id(src), base, disp);
+    }
+
+    void X86Emitter::storeImm64(X86Reg base, i64 disp, int32_t imm)
+    {
+        rex(true, 0, 0, id(base));
+        emit8(0xc7);
+        modrmMem(0, base, disp);
+        emit32(imm);
+    }
+
+    void X86Emitter::loadIndexed(X86Reg dst, X86Reg base, X86Reg index, DataSizeType size, bool sign)
+    {
+        switch (size)
+        {
+            case Byte:
+                rex(sign, id(dst), id(index), id(base));
+                emit8(0x0f);
+                emit8(sign ? 0xbe : 0xb6);    // movsx r64, r/m8 : movzx r32, r/m8
+                break;
+            case HalfWord:
+                rex(sign, id(dst), id(index), id(base));
+                emit8(0x0f);
+                emit8(sign ? 0xbf : 0xb7);    // movsx r64, r/m16 : movzx r32, r/m16
+                break;
+            case Word:
+                rex(sign, id(dst), id(index), id(base));
+                emit8(sign ? 0x63 : 0x8b);    // movsxd r64, r/m32 : mov r32, r/m32
+                break;
+            case DoubleWord:
+                rex(true, id(dst), id(index), id(base));
+                emit8(0x8b);
+                break;
+        }
+        modrmIndexed(id(dst), base, index);
+    }
+
+    void X86Emitter::storeIndexed(X86Reg base, X86Reg index, X86Reg src, DataSizeType size)
+    {
+        if (size == HalfWord)
+            emit8(0x66);
+
+        // Without a REX prefix the byte registers 4-7 are ah/ch/dh/bh.
+        rex(size == DoubleWord, id(src), id(index), id(base), size == Byte && id(src) >= 4);
+        emit8(size == Byte ? 0x88 : 0x89);
+        modrmIndexed(id(src), base, index);
+    }
+
+    void X86Emitter::cmpByteIndexed(X86Reg base, X86Reg index, u8 imm)
+    {
+        rex(false, 0, id(index), id(base));
+        emit8(0x80);
+        modrmIndexed(7, base, index);
+        emit8(imm);
+    }
+
+    void X86Emitter::movImm64(X86Reg dst, u64 imm)
+    {
+        if (imm <= UINT32_MAX)
+        {
+            rex(false, 0, 0, id(dst));
+            emit8(0xb8 + low(dst));
+            emit32(imm);
+        }
+        else if (fitsInt32(static_cast<i64>(imm)))
+        {
+            rex(true, 0, 0, id(dst));
+            emit8(0xc7);
+            modrmReg(0, dst);
+            emit32(imm);
+        }
+        else
+        {
+            rex(true, 0, 0, id(dst));
+            emit8(0xb8 + low(dst));
+            emit64(imm);
+        }
+    }
+
+    void X86Emitter::mov(X86Reg dst, X86Reg src)
+    {
+        rex(true, id(src), 0, id(dst));
+        emit8(0x89);
+        modrmReg(id(src), dst);
+    }
+
+    void X86Emitter::mov32(X86Reg dst, X86Reg src)
+    {
+        rex(false, id(src), 0, id(dst));
+        emit8(0x89);
+        modrmReg(id(src), dst);
+    }
+
+    void X86Emitter::lea(X86Reg dst, X86Reg base, i64 disp)
+    {
+        rex(true, id(dst), 0, id(base));
+        emit8(0x8d);
+        modrmMem(id(dst), base, disp);
+    }
+
+    void X86Emitter::movsxd(X86Reg dst, X86Reg src)
+    {
+        rex(true, id(dst), 0, id(src));
+        emit8(0x63);
+        modrmReg(id(dst), src);
+    }
+
+    void X86Emitter::zero(X86Reg reg)
+    {
+        rex(false, id(reg), 0, id(reg));
+        emit8(0x31);
+        modrmReg(id(reg), reg);
+    }
+
+    void X86Emitter::alu(X86Alu op, X86Reg dst, X86Reg src)
+    {
+        rex(true, id(dst), 0, id(src));
+        emit8((static_cast<u8>(op) << 3) | 0x03);
+        modrmReg(id(dst), src);
+    }
+
+    void X86Emitter::aluImm(X86Alu op, X86Reg dst, int32_t imm)
+    {
+        rex(true, 0, 0, id(dst));
+        if (fitsInt8(imm))
+        {
+            emit8(0x83);
+            modrmReg(static_cast<u8>(op), dst);
+            emit8(imm);
+        }
+        else
+        {
+            emit8(0x81);
+            modrmReg(static_cast<u8>(op), dst);
+            emit32(imm);
+        }
+    }
+
+    void X86Emitter::aluMem(X86Alu op, X86Reg dst, X86Reg base, i64 disp)
+    {
+        rex(true, id(dst), 0, id(base));
+        emit8((static_cast<u8>(op) << 3) | 0x03);
+        modrmMem(id(dst), base, disp);
+    }
+
+    void X86Emitter::aluMemImm(X86Alu op, X86Reg base, i64 disp, int32_t imm)
+    {
+        rex(true, 0, 0, id(base));
+        if (fitsInt8(imm))
+        {
+            emit8(0x83);
+            modrmMem(static_cast<u8>(op), base, disp);
+            emit8(imm);
+        }
+        else
+        {
+            emit8(0x81);
+            modrmMem(static_cast<u8>(op), base, disp);
+            emit32(imm);
+        }
+    }
+
+    void X86Emitter::imul(X86Reg dst, X86Reg src)
+    {
+        rex(true, id(dst), 0, id(src));
+        emit8(0x0f);
+        emit8(0xaf);
+        modrmReg(id(dst), src);
+    }
+
+    void X86Emitter::test32(X86Reg reg, int32_t imm)
+    {
+        rex(false, 0, 0, id(reg));
+        emit8(0xf7);
+        modrmReg(0, reg);
+        emit32(imm);
+    }
+
+    void X86Emitter::shiftImm(X86Shift op, X86Reg dst, u8 imm)
+    {
+        rex(true, 0, 0, id(dst));
+        emit8(0xc1);
+        modrmReg(static_cast<u8>(op), dst);
+        emit8(imm);
+    }
+
+    void X86Emitter::shiftImm32(X86Shift op, X86Reg dst, u8 imm)
+    {
+        rex(false, 0, 0, id(dst));
+        emit8(0xc1);
+        modrmReg(static_cast<u8>(op), dst);
+        emit8(imm);
+    }
+
+    void X86Emitter::shiftCl(X86Shift op, X86Reg dst)
+    {
+        rex(true, 0, 0, id(dst));
+        emit8(0xd3);
+        modrmReg(static_cast<u8>(op), dst);
+    }
+
+    void X86Emitter::shiftCl32(X86Shift op, X86Reg dst)
+    {
+        rex(false, 0, 0, id(dst));
+        emit8(0xd3);
+        modrmReg(static_cast<u8>(op), dst);
+    }
+
+    void X86Emitter::setcc(X86Cond cond, X86Reg dst)
+    {
+        rex(false, 0, 0, id(dst), id(dst) >= 4);
+        emit8(0x0f);
+        emit8(0x90 + static_cast<u8>(cond));
+        modrmReg(0, dst);
+
+        // movzx r32, r/m8
+        rex(false, id(dst), 0, id(dst), id(dst) >= 4);
+        emit8(0x0f);
+        emit8(0xb6);
+        modrmReg(id(dst), dst);
+    }
+
+    X86Emitter::Fixup X86Emitter::jcc(X86Cond cond)
+    {
+        emit8(0x0f);
+        emit8(0x80 + static_cast<u8>(cond));
+        Fixup fixup = cursor_;
+        emit32(0);
+        return fixup;
+    }
+
+    X86Emitter::Fixup X86Emitter::jmp()
+    {
+        emit8(0xe9);
+        Fixup fixup = cursor_;
+        emit32(0);
+        return fixup;
+    }
+
+    void X86Emitter::jmpTo(const u8 *target)
+    {
+        emit8(0xe9);
+        emit32(static_cast<u32>(target - (cursor_ + 4)));
+    }
+
+    void X86Emitter::jmpReg(X86Reg reg)
+    {
+        rex(false, 0, 0, id(reg));
+        emit8(0xff);
+        modrmReg(4, reg);
+    }
+
+    void X86Emitter::patch(Fixup fixup, const u8 *target)
+    {
+        const int32_t rel = static_cast<int32_t>(target - (fixup + 4));
+        std::memcpy(fixup, &rel, sizeof(rel));
+    }
+}    // namespace rvemu
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+#include <cstddef>
+
+namespace rvemu
+{
+    /// x86-64 general purpose registers, numbered as in the ModRM/REX encoding.
+    enum class X86Reg : u8 {
+        Rax,
+        Rcx,
+        Rdx,
+        Rbx,
+        Rsp,
+        Rbp,
+        Rsi,
+        Rdi,
+        R8,
+        R9,
+        R10,
+        R11,
+        R12,
+        R13,
+        R14,
+        R15,
+    };
+
+    /// Condition codes of jcc/setcc.
+    enum class X86Cond : u8 {
+        B  = 0x2,    // Below (unsigned <)
+        AE = 0x3,    // Above or equal (unsigned >=)
+        E  = 0x4,    // Equal
+        NE = 0x5,    // Not equal
+        A  = 0x7,    // Above (unsigned >)
+        L  = 0xc,    // Less (signed <)
+        GE = 0xd,    // Greater or equal (signed >=)
+    };
+
+    /// Arithmetic operations sharing the classic ALU encodings.
+    enum class X86Alu : u8 {
+        Add = 0,
+        Or  = 1,
+        And = 4,
+        Sub = 5,
+        Xor = 6,
+        Cmp = 7,
+    };
+
+    /// Shift operations, the value is the /digit of the C1/D3 opcodes.
+    enum class X86Shift : u8 {
+        Shl = 4,
+        Shr = 5,
+        Sar = 7,
+    };
+
+    /// Minimal x86-64 assembler covering what the JIT emits.
+    ///
+    /// Memory operands are [base + disp32] or [base + index]. Operations without a size in
+    /// their name work on 64-bit registers, the *32 variants write the 32-bit register, which
+    /// zero-extends into the full register.
+    class X86Emitter
+    {
+      public:
+        /// Position of an emitted rel32 displacement that still has to be patched.
+        using Fixup = u8 *;
+
+        /// @param begin The first byte to emit to.
+        /// @param end Past the last byte the emitter may write.
+        X86Emitter(u8 *begin, u8 *end) : begin_(begin), cursor_(begin), end_(end) { }
+
+        u8 *begin() const { return begin_; }
+        u8 *cursor() const { return cursor_; }
+
+        /// Whether the emitter ran out of space; the emitted code must then be discarded.
+        bool overflowed() const { return overflowed_; }
+
+        void push(X86Reg reg);
+        void pop(X86Reg reg);
+        void ret();
+        void mfence();
+
+        /// dst = [base + disp]
+        void load64(X86Reg dst, X86Reg base, i64 disp);
+        /// [base + disp] = src
+        void store64(X86Reg base, i64 disp, X86Reg src);
+        /// [base + disp] = sign-extended imm
+        void storeImm64(X86Reg base, i64 disp, int32_t imm);
+
+        /// dst = (zero/sign-extended) value of the given width at [base + index]
+        void loadIndexed(X86Reg dst, X86Reg base, X86Reg index, DataSizeType size, bool sign);
+        /// [base + index] = low bytes of src
+        void storeIndexed(X86Reg base, X86Reg index, X86Reg src, DataSizeType size);
+        /// cmp byte [base + index], imm
+        void cmpByteIndexed(X86Reg base, X86Reg index, u8 imm);
+
+        void movImm64(X86Reg dst, u64 imm);
+        void mov(X86Reg dst, X86Reg src);
+        void mov32(X86Reg dst, X86Reg src);
+        void lea(X86Reg dst, X86Reg base, i64 disp);
+        void movsxd(X86Reg dst, X86Reg src);
+        void zero(X86Reg reg);
+
+        /// dst = dst op src
+        void alu(X86Alu op, X86Reg dst, X86Reg src);
+        /// dst = dst op imm
+        void aluImm(X86Alu op, X86Reg dst, int32_t imm);
+        /// dst = dst op [base + disp]
+        void aluMem(X86Alu op, X86Reg dst, X86Reg base, i64 disp);
+        /// qword [base + disp] = qword [base + disp] op imm
+        void aluMemImm(X86Alu op, X86Reg base, i64 disp, int32_t imm);
+        void imul(X86Reg dst, X86Reg src);
+        /// Sets the flags of reg32 & imm.
+        void test32(X86Reg reg, int32_t imm);
+
+        /// dst = dst shift imm
+        void shiftImm(X86Shift op, X86Reg dst, u8 imm);
+        void shiftImm32(X86Shift op, X86Reg dst, u8 imm);
+        /// dst = dst shift cl
+        void shiftCl(X86Shift op, X86Reg dst);
+        void shiftCl32(X86Shift op, X86Reg dst);
+
+        /// dst = cond ? 1 : 0
+        void setcc(X86Cond cond, X86Reg dst);
+
+        /// Conditional jump whose target is patched later.
+        Fixup jcc(X86Cond cond);
+        /// Unconditional jump whose target is patched later.
+        Fixup jmp();
+        /// Unconditional jump to an already known address.
+        void jmpTo(const u8 *target);
+        /// Unconditional jump to the address held by reg.
+        void jmpReg(X86Reg reg);
+
+        /// Points the jump emitted at fixup to target.
+        static void patch(Fixup fixup, const u8 *target);
+
+      private:
+        void emit8(u8 byte);
+        void emit32(u32 value);
+        void emit64(u64 value);
+
+        void rex(bool wide, u8 reg, u8 index, u8 base, bool force = false);
+        void modrmMem(u8 reg, X86Reg base, i64 disp);
+        void modrmIndexed(u8 reg, X86Reg base, X86Reg index);
+        void modrmReg(u8 reg, X86Reg rm);
+
+        u8 *begin_;
+        u8 *cursor_;
+        u8 *end_;
+        bool overflowed_ = false;
+    };
+}    // namespace rvemu
@@ -1,14 +1,137 @@
 #include "Emulator.hpp"
+#include "devices/Uart.hpp"
+#include "devices/VirtioBlk.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
 
 constexpr size_t max_len = 100;
 
+// Parses the value of a numeric --name=value option.
+template <typename T>
+static bool parseNumber(std::string_view opt, std::string_view name, T &value)
+{
+    if (!opt.starts_with(name))
+        return false;
+    opt.remove_prefix(name.size());
+    auto [end, ec] = std::from_chars(opt.data(), opt.data() + opt.size(), value);
+    return ec == std::errc {} && end == opt.data() + opt.size();
+}
+
+// Prints the decoded instruction kinds, most frequent first, and how many words of the code
+// decoded as fused pairs. These are static counts, each instruction counting once however
+// often it ran.
+static void printInstMix(const rvemu::InstMix &mix)
+{
+    std::vector<std::size_t> kinds;
+    rvemu::u64 words = 0;
+    rvemu::u64 fused = 0;
+    for (std::size_t kind = 0; kind < mix.size(); ++kind)
+    {
+        if (mix[kind] == 0)
+            continue;
+        kinds.push_back(kind);
+        const bool isPair = rvemu::isFused(static_cast<rvemu::InstKind>(kind));
+        words += isPair ? 2 * mix[kind] : mix[kind];
+        fused += isPair ? 2 * mix[kind] : 0;
+    }
+    std::ranges::sort(kinds, [&](std::size_t a, std::size_t b) { return mix[a] > mix[b]; });
+
+    for (std::size_t kind : kinds)
+    {
+        std::cout << std::left << std::setw(26)
+                  << rvemu::instKindName(static_cast<rvemu::InstKind>(kind)) << mix[kind] << "\n";
+    }
+    std::cout << "Fused at decode (static): " << fused << " of " << words << std::endl;
+}
+
 int main(int argc, char **argv)
 {
-    int fileIdx = 1;
-    if (argc < 2)
+    int fileIdx              = 1;
+    rvemu::ExecEngine engine = rvemu::ExecEngine::Tiered;
+    rvemu::TierConfig tierConfig;
+    bool printStats       = false;
+    bool printMix         = false;
+    bool trace            = false;
+    rvemu::u64 maxInsts   = rvemu::CPU::NO_LIMIT;
+    rvemu::u32 harts      = 1;
+    std::size_t memoryMiB = rvemu::DEFAULT_DRAM_SIZE >> 20;
+    rvemu::RamConfig ram;
+    rvemu::TimeMode timeMode = rvemu::TimeMode::Instructions;
+    rvemu::DiskConfig disk;
+    std::string traceFile;
+
+    // Options come before the file:
+    // --engine=tiered|interp|threaded|jit|pipeline --warm=N --hot=N --sync-compile --stats
+    // --mix --trace --trace-file=PATH --max-insts=N --memory=MiB
+    // --ram=anon|huge|file:PATH|image:PATH --time=insts|host
+    // --disk=PATH --disk-overlay=PATH --disk-ro --harts=N
+    for (; fileIdx < argc && std::strncmp(argv[fileIdx], "--", 2) == 0; ++fileIdx)
+    {
+        std::string_view opt {argv[fileIdx]};
+        if (opt == "--engine=tiered")
+            engine = rvemu::ExecEngine::Tiered;
+        else if (opt == "--engine=interp")
+            engine = rvemu::ExecEngine::Interpreter;
+        else if (opt == "--engine=threaded")
+            engine = rvemu::ExecEngine::Threaded;
+        else if (opt == "--engine=jit")
+            engine = rvemu::ExecEngine::Jit;
+        else if (opt == "--engine=pipeline")
+            engine = rvemu::ExecEngine::Pipeline;
+        else if (opt == "--sync-compile")
+            tierConfig.backgroundCompile = false;
+        else if (opt == "--stats")
+            printStats = true;
+        else if (opt == "--mix")
+            printMix = true;
+        else if (opt == "--trace")
+            trace = true;
+        else if (opt.starts_with("--trace-file="))
+            traceFile = opt.substr(std::strlen("--trace-file="));
+        else if (opt == "--ram=anon")
+            ram.kind = rvemu::RamKind::Anonymous;
+        else if (opt == "--ram=huge")
+            ram.kind = rvemu::RamKind::HugePages;
+        else if (opt.starts_with("--disk="))
+            disk.path = opt.substr(std::strlen("--disk="));
+        else if (opt.starts_with("--disk-overlay="))
+            disk.overlay = opt.substr(std::strlen("--disk-overlay="));
+        else if (opt == "--disk-ro")
+            disk.readOnly = true;
+        else if (opt == "--time=insts")
+            timeMode = rvemu::TimeMode::Instructions;
+        else if (opt == "--time=host")
+            timeMode = rvemu::TimeMode::Host;
+        else if (opt.starts_with("--ram=file:"))
+        {
+            ram.kind = rvemu::RamKind::File;
+            ram.path = opt.substr(std::strlen("--ram=file:"));
+        }
+        else if (opt.starts_with("--ram=image:"))
+        {
+            ram.kind = rvemu::RamKind::Image;
+            ram.path = opt.substr(std::strlen("--ram=image:"));
+        }
+        else if (!parseNumber(opt, "--warm=", tierConfig.warmThreshold)
+                 && !parseNumber(opt, "--hot=", tierConfig.hotThreshold)
+                 && !parseNumber(opt, "--max-insts=", maxInsts)
+                 && !(parseNumber(opt, "--harts=", harts) && harts > 0)
+                 && !(parseNumber(opt, "--memory=", memoryMiB) && memoryMiB > 0))
+        {
+            std::cerr << "Error: unknown option " << opt << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (fileIdx >= argc)
     {
         std::cerr << "Error: no file provided\n";
         return EXIT_FAILURE;
@@ -23,9 +146,89 @@ int main(int argc, char **argv)
     std::string bin_file {argv[fileIdx]};
     std::cout << "File provided: " << bin_file << std::endl;
 
-    rvemu::Emulator riscv_emulator(bin_file);
+    ram.size = memoryMiB << 20;
+    rvemu::Emulator riscv_emulator(bin_file, engine, ram, harts);
+    for (rvemu::u32 hart = 0; hart < harts; ++hart)
+    {
+        riscv_emulator.getCPU(hart).setTierConfig(tierConfig);
+        riscv_emulator.getCPU(hart).setTracing(trace);
+    }
+    riscv_emulator.getCPU().setTimeMode(timeMode);
+    riscv_emulator.getCPU().getUart().setInput(STDIN_FILENO);
+    if (!disk.path.empty())
+        riscv_emulator.getCPU().attachDisk(disk);
+    if (!traceFile.empty())
+        riscv_emulator.traceTo(traceFile);
+
+    if (riscv_emulator.run(maxInsts) == rvemu::StopReason::Budget)
+        std::cout << "Stopped after " << maxInsts << " instructions" << std::endl;
+
+    if (printStats)
+    {
+        const rvemu::LoadStats &load = riscv_emulator.getCPU().getLoadStats();
+        std::cout << "Instructions executed:    " << riscv_emulator.getCPU().getRetired() << "\n";
+        for (rvemu::u32 hart = 1; hart < harts; ++hart)
+        {
+            std::cout << "Instructions of hart " << std::left << std::setw(5) << hart
+                      << riscv_emulator.getCPU(hart).getRetired() << "\n";
+        }
+        rvemu::u64 fusedPairs = 0;
+        for (rvemu::u32 hart = 0; hart < harts; ++hart)
+            fusedPairs += riscv_emulator.getCPU(hart).getFusedRetired();
+        std::cout << "Executed as fused pairs:  " << 2 * fusedPairs << "\n";
+        std::cout << "DRAM backing:             " << riscv_emulator.getCPU().getDRAM().describe()
+                  << "\n"
+                  << "Program size (bytes):     " << load.bytes << "\n"
+                  << "Program load time (us):   " << load.nanos / 1000 << "\n";
+
+        const rvemu::TlbStats &tlb = riscv_emulator.getCPU().getTlbStats();
+        std::cout << "TLB fetch hits/misses:    " << tlb.hits[0] << "/" << tlb.misses[0] << "\n"
+                  << "TLB load hits/misses:     " << tlb.hits[1] << "/" << tlb.misses[1] << "\n"
+                  << "TLB store hits/misses:    " << tlb.hits[2] << "/" << tlb.misses[2] << "\n"
+                  << "Timer events fired:       " << riscv_emulator.getCPU().getEvents().getFired()
+                  << "\n"
+                  << "Ticks idled in wfi:       "
+                  << riscv_emulator.getCPU().getEvents().getIdleTicks() << "\n";
+
+        const rvemu::Uart &uart = riscv_emulator.getCPU().getUart();
+        std::cout << "Console bytes/writes:     " << uart.getBytesSent() << "/"
+                  << uart.getHostWrites() << "\n";
+
+        if (const rvemu::VirtioBlk *blk = riscv_emulator.getCPU().getDisk())
+        {
+            const rvemu::BlockStats io = blk->getStats();
+            const rvemu::u64 requests   = io.reads + io.writes + io.flushes;
+            const rvemu::u64 bytes      = io.bytesRead + io.bytesWritten;
+            std::cout << "Disk backing:             " << blk->getDisk().describe() << "\n"
+                      << "Disk reads/writes/syncs:  " << io.reads << "/" << io.writes << "/"
+                      << io.flushes << " (" << io.errors << " failed)\n"
+                      << "Disk bytes read/written:  " << io.bytesRead << "/" << io.bytesWritten
+                      << "\n"
+                      << "Request avg/max (ns):     "
+                      << (requests != 0 ? io.busyNanos / requests : 0) << "/" << io.maxNanos
+                      << "\n"
+                      << "Disk throughput (MiB/s):  "
+                      << (io.busyNanos != 0 ? bytes * 1e9 / io.busyNanos / (1 << 20) : 0.0)
+                      << "\n";
+        }
+    }
+
+    const rvemu::TierStats *stats = riscv_emulator.getCPU().getTierStats();
+    if (printStats && stats != nullptr)
+    {
+        std::cout << "Interpreted instructions: " << stats->interpretedInsts << "\n"
+                  << "Threaded block runs:      " << stats->threadedRuns << "\n"
+                  << "Native block runs:        " << stats->nativeRuns << "\n"
+                  << "Blocks translated:        " << stats->translated << "\n"
+                  << "Blocks compiled:          " << stats->compiled << "\n"
+                  << "Stale compilations:       " << stats->staleCompiles << "\n"
+                  << "Max compile queue depth:  " << stats->maxQueueDepth << "\n"
+                  << "Compile time (us):        " << stats->compileNanos / 1000 << "\n"
+                  << "Max block compile (us):   " << stats->maxCompileNanos / 1000 << std::endl;
+    }
 
-    riscv_emulator.runEmulator();
+    if (printMix)
+        printInstMix(riscv_emulator.getCPU().getInstMix());
 
     return EXIT_SUCCESS;
 }
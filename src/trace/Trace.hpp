@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+
+#include <array>
+
+namespace rvemu
+{
+    /// Memory access of a traced instruction.
+    enum class TraceAccess : u8 {
+        None,
+        Load,
+        Store,
+        Atomic,    /// Read-modify-write of an AMO.
+    };
+
+    /// One executed guest instruction of a binary trace.
+    ///
+    /// value holds what the instruction wrote to rd, or the value a store wrote to memory
+    /// since stores write no register. A load writing x0 records no value. An lr is a load, an
+    /// sc a store if it succeeded, which wrote 0 to rd, and an AMO records the value it loaded
+    /// like a load.
+    struct TraceRecord
+    {
+        AddrType pc;
+        InstSizeType inst;     /// Raw encoding.
+        u8 rd;                 /// Register written, 0 if none.
+        TraceAccess access;
+        u8 size;               /// Bytes accessed, 0 without memory access.
+        u8 reserved;
+        RegisterSizeType value;
+        AddrType address;      /// Address accessed.
+    };
+
+    static_assert(sizeof(TraceRecord) == 32, "TraceRecord must stay compact");
+
+    /// Start of a trace file, followed by chunks of records.
+    struct TraceFileHeader
+    {
+        static constexpr std::array<char, 8> MAGIC = {'R', 'V', 'T', 'R', 'A', 'C', 'E', '\0'};
+        static constexpr u32 VERSION               = 1;
+
+        std::array<char, 8> magic = MAGIC;
+        u32 version               = VERSION;
+        u32 recordSize            = sizeof(TraceRecord);
+    };
+
+    /// Header of a run of consecutive records of one hart.
+    struct TraceChunkHeader
+    {
+        u32 hartId;
+        u32 count;
+    };
+}    // namespace rvemu
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <thread>
+
+namespace rvemu
+{
+    /// Lock-free ring of trace records between one hart and the trace writer.
+    ///
+    /// The hart fills records in place and publishes them in batches with a release store,
+    /// the writer drains contiguous runs of records and hands their space back the same way.
+    /// When the ring is full the hart waits for the writer, so no record is ever lost.
+    class TraceBuffer
+    {
+      public:
+        static constexpr std::size_t CAPACITY = 1 << 16;
+        /// Records the hart commits before publishing them.
+        static constexpr std::size_t PUBLISH_BATCH = 256;
+
+        static_assert(CAPACITY % PUBLISH_BATCH == 0, "batches must not straddle the end");
+
+        explicit TraceBuffer(u32 hartId)
+          : hartId_(hartId), records_(std::make_unique<TraceRecord[]>(CAPACITY))
+        { }
+
+        u32 getHartId() const { return hartId_; }
+
+        /// Returns the slot of the next record, hart side.
+        TraceRecord &reserve()
+        {
+            if (tail_ - cachedHead_ == CAPACITY)
+                waitForRoom();
+            return records_[tail_ % CAPACITY];
+        }
+
+        /// Appends the record filled in the reserved slot, hart side.
+        void commit()
+        {
+            if (++tail_ % PUBLISH_BATCH == 0)
+                publish();
+        }
+
+        /// Makes every committed record visible to the writer, hart side.
+        void publish() { published_.store(tail_, std::memory_order_release); }
+
+        /// The oldest published records not drained yet, writer side. The span stops at the
+        /// end of the ring, the rest follows on the next call.
+        std::span<const TraceRecord> readable() const
+        {
+            const std::size_t head  = head_.load(std::memory_order_relaxed);
+            const std::size_t tail  = published_.load(std::memory_order_acquire);
+            const std::size_t begin = head % CAPACITY;
+            return {&records_[begin], std::min(tail - head, CAPACITY - begin)};
+        }
+
+        /// Gives the space of drained records back to the hart, writer side.
+        void release(std::size_t count)
+        {
+            head_.store(head_.load(std::memory_order_relaxed) + count,
+                        std::memory_order_release);
+        }
+
+      private:
+        void waitForRoom()
+        {
+            publish();
+            while ((cachedHead_ = head_.load(std::memory_order_acquire)) + CAPACITY == tail_)
+                std::this_thread::yield();
+        }
+
+        u32 hartId_;
+        std::unique_ptr<TraceRecord[]> records_;
+
+        std::size_t tail_       = 0;    /// Records committed, hart only.
+        std::size_t cachedHead_ = 0;    /// Last head_ the hart read.
+
+        // Separate cache lines, so the two sides do not bounce one line between them.
+        alignas(64) std::atomic<std::size_t> published_ {0};
+        alignas(64) std::atomic<std::size_t> head_ {0};
+    };
+}    // namespace rvemu
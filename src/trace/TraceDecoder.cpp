@@ -0,0 +1,57 @@
+#include "TraceDecoder.hpp"
+
+#include "../Decoder.hpp"
+#include "../ElfLoader.hpp"
+#include "../Registers.hpp"
+
+#include <fmt/core.h>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace rvemu
+{
+    bool TraceDecoder::render(std::istream &in, std::ostream &out, const SymbolTable *symbols)
+    {
+        TraceFileHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+            || header.magic != TraceFileHeader::MAGIC || header.version != TraceFileHeader::VERSION
+            || header.recordSize != sizeof(TraceRecord))
+            return false;
+
+        TraceChunkHeader chunk;
+        std::vector<TraceRecord> records;
+        while (in.read(reinterpret_cast<char *>(&chunk), sizeof(chunk)))
+        {
+            records.resize(chunk.count);
+            if (!in.read(reinterpret_cast<char *>(records.data()),
+                         records.size() * sizeof(TraceRecord)))
+                return false;
+            for (const TraceRecord &record : records)
+                out << format(chunk.hartId, record, symbols) << "\n";
+        }
+        return in.gcount() == 0;
+    }
+
+    std::string
+    TraceDecoder::format(u32 hartId, const TraceRecord &record, const SymbolTable *symbols)
+    {
+        std::string line = fmt::format("{} {}: {:08x} {:<10}",
+                                       hartId,
+                                       symbols != nullptr ? symbols->describe(record.pc)
+                                                          : fmt::format("{:#x}", record.pc),
+                                       record.inst,
+                                       instKindName(decodeInst(record.inst).kind));
+        if (record.rd != 0)
+            line += fmt::format(" {}={:#x}", Registers::RVABI[record.rd], record.value);
+        if (record.access == TraceAccess::Load)
+            line += fmt::format(" load.{} [{:#x}]", record.size, record.address);
+        else if (record.access == TraceAccess::Store)
+            line += fmt::format(
+                " store.{} [{:#x}]={:#x}", record.size, record.address, record.value);
+        else if (record.access == TraceAccess::Atomic)
+            line += fmt::format(" amo.{} [{:#x}]", record.size, record.address);
+        line.erase(line.find_last_not_of(' ') + 1);
+        return line;
+    }
+}    // namespace rvemu
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "Trace.hpp"
+
+#include <iosfwd>
+#include <string>
+
+namespace rvemu
+{
+    class SymbolTable;
+
+    /// Renders binary traces as text, one line per instruction.
+    class TraceDecoder
+    {
+      public:
+        /// Renders a whole trace file.
+        /// @param symbols The symbols of the traced program to name the pcs with, if known.
+        /// @return False if the input is not a trace or ends in the middle of a chunk.
+        static bool
+        render(std::istream &in, std::ostream &out, const SymbolTable *symbols = nullptr);
+
+        /// Formats one record as: hart pc [<symbol+offset>] raw mnemonic [rd=value]
+        /// [load/store.size [address]].
+        static std::string
+        format(u32 hartId, const TraceRecord &record, const SymbolTable *symbols = nullptr);
+    };
+}    // namespace rvemu
@@ -0,0 +1,72 @@
+#include "TraceWriter.hpp"
+
+#include "Trace.hpp"
+
+#include <chrono>
+#include <iostream>
+
+namespace rvemu
+{
+    namespace
+    {
+        /// How long the writer sleeps when the harts published nothing.
+        constexpr std::chrono::microseconds IDLE_WAIT {200};
+    }    // namespace
+
+    TraceWriter::TraceWriter(const std::string &path, u32 harts)
+      : file_(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!file_.is_open())
+        {
+            std::cerr << "Cannot create trace file: " << path << "\n";
+            abort();
+        }
+
+        const TraceFileHeader header;
+        file_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+        for (u32 hartId = 0; hartId < harts; ++hartId)
+            buffers_.push_back(std::make_unique<TraceBuffer>(hartId));
+        thread_ = std::thread([this] { work(); });
+    }
+
+    TraceWriter::~TraceWriter()
+    {
+        stop_.store(true, std::memory_order_release);
+        thread_.join();
+    }
+
+    void TraceWriter::work()
+    {
+        for (;;)
+        {
+            // Read before draining, so the last drain sees all the harts published.
+            const bool stopping = stop_.load(std::memory_order_acquire);
+            if (!drain())
+            {
+                if (stopping)
+                    break;
+                std::this_thread::sleep_for(IDLE_WAIT);
+            }
+        }
+        file_.flush();
+    }
+
+    bool TraceWriter::drain()
+    {
+        bool wrote = false;
+        for (auto &buffer : buffers_)
+        {
+            const std::span<const TraceRecord> records = buffer->readable();
+            if (records.empty())
+                continue;
+
+            const TraceChunkHeader chunk {buffer->getHartId(), static_cast<u32>(records.size())};
+            file_.write(reinterpret_cast<const char *>(&chunk), sizeof(chunk));
+            file_.write(reinterpret_cast<const char *>(records.data()), records.size_bytes());
+            buffer->release(records.size());
+            wrote = true;
+        }
+        return wrote;
+    }
+}    // namespace rvemu
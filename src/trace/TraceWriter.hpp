@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../RVEmu.hpp"
+#include "TraceBuffer.hpp"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rvemu
+{
+    /// Thread writing the binary trace of the harts to a file.
+    ///
+    /// Each hart appends its records to its own TraceBuffer, the writer drains the buffers in
+    /// turn and writes each run of records behind a TraceChunkHeader, so the harts never wait
+    /// on the disk. Destroying the writer drains what the harts published and closes the file,
+    /// the harts must have published everything and stopped by then.
+    class TraceWriter
+    {
+      public:
+        /// Creates the trace file and starts the writer thread.
+        /// @param harts Number of harts, whose ids go from 0 to harts - 1.
+        TraceWriter(const std::string &path, u32 harts);
+        ~TraceWriter();
+
+        TraceWriter(const TraceWriter &)             = delete;
+        TraceWriter &operator= (const TraceWriter &) = delete;
+
+        /// The buffer a hart appends its records to.
+        TraceBuffer &getBuffer(u32 hartId) { return *buffers_[hartId]; }
+
+      private:
+        void work();
+
+        /// Writes what the harts published.
+        /// @return False if there was nothing to write.
+        bool drain();
+
+        std::ofstream file_;
+        std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+        std::atomic<bool> stop_ {false};
+
+        std::thread thread_;
+    };
+}    // namespace rvemu
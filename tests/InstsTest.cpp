@@ -1,7 +1,21 @@
 #include "testUtil.hpp"
 
+#include "../src/Emulator.hpp"
+#include "../src/devices/Uart.hpp"
+#include "../src/devices/VirtioBlk.hpp"
+#include "../src/trace/TraceDecoder.hpp"
+
 #include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <tuple>
+
+#include <unistd.h>
 
 namespace rvemu
 {
@@ -493,4 +507,1188 @@ namespace rvemu
         REQUIRE(cpu.getRegValueByName("stvec") == 5);
         REQUIRE(cpu.getRegValueByName("sepc") == 6);
     }
+
+    TEST_CASE("RVTests-engines", "Test every engine computes the same result")
+    {
+        std::string code = start
+                           + "addi a0, zero, 0 \n"
+                             "addi a1, zero, 10 \n"
+                             "loop: \n"
+                             "addi a0, a0, 3 \n"        // a0 += 3
+                             "addi a1, a1, -1 \n"       // a1 -= 1
+                             "bne a1, zero, loop \n"    // repeat 10 times
+                             "slli a2, a0, 1 \n";       // a2 = a0 << 1
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            CPU cpu = rvHelper(code, "test_engines", 33, engine);
+
+            REQUIRE(cpu.getRegValueByName("a0") == 30);
+            REQUIRE(cpu.getRegValueByName("a1") == 0);
+            REQUIRE(cpu.getRegValueByName("a2") == 60);
+        }
+    }
+
+    TEST_CASE("RVTests-engines-memory", "Test every engine agrees on loads, stores and words")
+    {
+        std::string code = start
+                           + "li t0, 0x80010000 \n"
+                             "addi t1, zero, -2 \n"
+                             "sd t1, 8(t0) \n"
+                             "lw a0, 8(t0) \n"         // a0 = -2
+                             "lbu a1, 9(t0) \n"        // a1 = 0xff
+                             "lwu a2, 12(t0) \n"       // a2 = 0xffffffff
+                             "addiw a3, a2, 3 \n"      // a3 = 2
+                             "sb zero, 15(t0) \n"
+                             "ld a4, 8(t0) \n"         // a4 = 0x00fffffffffffffe
+                             "sraiw a5, a1, 4 \n"      // a5 = 0xf
+                             "li t1, 0x1122334455667788 \n"
+                             "sd t1, 19(t0) \n"        // misaligned accesses complete
+                             "ld a6, 19(t0) \n"        // a6 = 0x1122334455667788
+                             "lh a7, 21(t0) \n";       // a7 = 0x5566
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            CPU cpu = rvHelper(code, "test_engines_memory", 16, engine);
+
+            REQUIRE(cpu.getRegValueByName("a0") == static_cast<u64>(-2));
+            REQUIRE(cpu.getRegValueByName("a1") == 0xff);
+            REQUIRE(cpu.getRegValueByName("a2") == 0xffff'ffff);
+            REQUIRE(cpu.getRegValueByName("a3") == 2);
+            REQUIRE(cpu.getRegValueByName("a4") == 0x00ff'ffff'ffff'fffe);
+            REQUIRE(cpu.getRegValueByName("a5") == 0xf);
+            REQUIRE(cpu.getRegValueByName("a6") == 0x1122'3344'5566'7788);
+            REQUIRE(cpu.getRegValueByName("a7") == 0x5566);
+        }
+
+        // The last doubleword of DRAM is in range; one byte further is not.
+        const std::string outOfRange = "li t0, 0x87fffff8 \n"
+                                       "li t1, 7 \n"
+                                       "sd t1, 0(t0) \n"
+                                       "ld a0, 0(t0) \n"
+                                       "ld a1, 1(t0) \n"
+                                       "li a2, 9 \n";
+        const std::string binFile = buildRVBinary(outOfRange, "test_engines_out_of_range");
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            REQUIRE(emulator.run() == StopReason::Exception);
+            CPU &cpu = emulator.getCPU();
+
+            REQUIRE(cpu.getRegValueByName("a0") == 7);
+            REQUIRE(cpu.getRegValueByName("a1") == 0);
+            REQUIRE(cpu.getRegValueByName("a2") == 0);
+        }
+    }
+
+    TEST_CASE("RVTests-engines-calls", "Test every engine agrees on chained calls and returns")
+    {
+        std::string code = start
+                           + "addi s0, zero, 20 \n"
+                             "addi a0, zero, 0 \n"
+                             "loop: \n"
+                             "addi a1, zero, 3 \n"
+                             "jal ra, f \n"            // called from two sites
+                             "addi a1, zero, 5 \n"
+                             "jal ra, f \n"
+                             "addi s0, s0, -1 \n"
+                             "bne s0, zero, loop \n"
+                             "jal zero, end \n"
+                             "f: \n"
+                             "add a0, a0, a1 \n"
+                             "jalr zero, 0(ra) \n"
+                             "end: \n"
+                             "addi a2, a0, 0 \n";
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            CPU cpu = rvHelper(code, "test_engines_calls", 131, engine);
+
+            REQUIRE(cpu.getRegValueByName("a0") == 160);
+            REQUIRE(cpu.getRegValueByName("a2") == 160);
+        }
+    }
+
+    TEST_CASE("RVTests-engines-fault", "Test every engine stops at a faulting instruction")
+    {
+        // The store of the last iteration goes 1 GiB past its buffer, out of DRAM, in the
+        // middle of a block that ran often enough to be translated.
+        const std::string code = "li s0, 0x80010000 \n"
+                                 "li s1, 0x40000000 \n"
+                                 "li t0, 300 \n"
+                                 "li a0, 0 \n"
+                                 "loop: \n"
+                                 "addi a0, a0, 1 \n"
+                                 "seqz t2, t0 \n"
+                                 "neg t2, t2 \n"
+                                 "and t2, t2, s1 \n"
+                                 "add t3, s0, t2 \n"
+                                 "sd a0, 0(t3) \n"
+                                 "addi a1, a0, 7 \n"
+                                 "addi t0, t0, -1 \n"
+                                 "bgez t0, loop \n";
+        const std::string binFile = buildRVBinary(code, "test_engines_fault");
+
+        Emulator reference(binFile, ExecEngine::Interpreter);
+        REQUIRE(reference.run() == StopReason::Exception);
+        CPU &expected = reference.getCPU();
+        REQUIRE(expected.getRegValueByName("a0") == 301);
+        REQUIRE(expected.getRegValueByName("a1") == 307);
+
+        for (auto engine : {ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            REQUIRE(emulator.run() == StopReason::Exception);
+            CPU &cpu = emulator.getCPU();
+
+            REQUIRE(cpu.getPC() == expected.getPC());
+            REQUIRE(cpu.getRetired() == expected.getRetired());
+            REQUIRE(cpu.getRegValueByName("a0") == 301);
+            REQUIRE(cpu.getRegValueByName("a1") == 307);
+        }
+    }
+
+    TEST_CASE("RVTests-decode-cache", "Test stores drop every decoded instruction they overlap")
+    {
+        // The first pass decodes the three addi, then an sd at patch + 2 rewrites the middle
+        // one and the top and bottom halves of its neighbours with their own bytes.
+        const std::string code = "li s1, 0 \n"
+                                 "la s0, patch \n"
+                                 "patch: \n"
+                                 "addi a0, zero, 1 \n"
+                                 "addi a1, zero, 1 \n"
+                                 "addi a2, zero, 1 \n"
+                                 "bnez s1, end \n"
+                                 "li s1, 1 \n"
+                                 "ld t0, 2(s0) \n"
+                                 "li t1, 0xffffffff \n"
+                                 "slli t1, t1, 16 \n"
+                                 "not t1, t1 \n"
+                                 "and t0, t0, t1 \n"
+                                 "li t2, 0x00200593 \n"    // addi a1, zero, 2
+                                 "slli t2, t2, 16 \n"
+                                 "or t0, t0, t2 \n"
+                                 "sd t0, 2(s0) \n"
+                                 "j patch \n"
+                                 "end: \n";
+        const std::string binFile = buildRVBinary(code, "test_decode_cache");
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            Emulator emulator(binFile, engine);
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            CPU &cpu = emulator.getCPU();
+
+            REQUIRE(cpu.getRegValueByName("a0") == 1);
+            REQUIRE(cpu.getRegValueByName("a1") == 2);
+            REQUIRE(cpu.getRegValueByName("a2") == 1);
+        }
+    }
+
+    TEST_CASE("RVTests-misaligned-pc", "Test a jump to a pc that is 2 mod 4 faults")
+    {
+        // target is decoded by the first pass, the jump lands in its middle.
+        const std::string code = "la t0, target \n"
+                                 "addi t0, t0, 2 \n"
+                                 "target: \n"
+                                 "addi a0, a0, 1 \n"
+                                 "jalr zero, 0(t0) \n";
+        const std::string binFile = buildRVBinary(code, "test_misaligned_pc");
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            REQUIRE(emulator.run(1000) == StopReason::Exception);
+            CPU &cpu = emulator.getCPU();
+
+            REQUIRE(cpu.getPC() == *cpu.getRegValueByName("t0"));
+            REQUIRE(cpu.getPC() % Word == 2);
+            REQUIRE(cpu.getRegValueByName("a0") == 1);
+        }
+    }
+
+    TEST_CASE("RVTests-optimizer", "Test translated blocks fold constants and drop dead writes")
+    {
+        std::string code = start
+                           + "lui a0, 0x12345 \n"
+                             "addi a0, a0, 0x678 \n"
+                             "addi zero, a0, 1 \n"      // x0 write, dropped
+                             "auipc a1, 0 \n"
+                             "addi a2, a1, 16 \n"
+                             "sub a3, a2, a1 \n"
+                             "1: auipc t0, %pcrel_hi(next) \n"
+                             "jalr zero, %pcrel_lo(1b)(t0) \n"
+                             "addi a4, zero, 1 \n"
+                             "next: \n"
+                             "lui s1, 0x80100 \n"
+                             "slli s1, s1, 32 \n"
+                             "srli s1, s1, 32 \n"
+                             "sd a0, 8(s1) \n"
+                             "addi t1, s1, 8 \n"
+                             "ld a5, 0(t1) \n";
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            CPU cpu = rvHelper(code, "test_optimizer", 16, engine);
+
+            REQUIRE(cpu.getRegValueByName("a0") == 0x12345678);
+            REQUIRE(cpu.getRegValueByName("a1") == DRAM_BASE + 12);
+            REQUIRE(cpu.getRegValueByName("a3") == 16);
+            REQUIRE(cpu.getRegValueByName("a4") == 0);
+            REQUIRE(cpu.getRegValueByName("a5") == 0x12345678);
+        }
+
+        CPU cpu                = rvHelper(code, "test_optimizer", 16, ExecEngine::Threaded);
+        TranslatedBlock *block = cpu.getBlockCache().lookup(DRAM_BASE);
+        REQUIRE(block != nullptr);
+        // The lui+addi and auipc+jalr pairs are fused, five ops are left plus the exit op.
+        REQUIRE(block->ops.size() == 6);
+        REQUIRE(block->ops[block->ops.size() - 2].inst.kind == InstKind::AuipcJalr);
+        REQUIRE(block->exits.size() == 1);
+        REQUIRE(block->exits[0].kind == ExitKind::Direct);
+    }
+
+    TEST_CASE("RVTests-fusion", "Test fused instruction pairs")
+    {
+        std::string code = start
+                           + "lui a0, 0x80001 \n"
+                             "addiw a0, a0, -1 \n"    // lui+addiw
+                             "1: auipc a1, %pcrel_hi(data) \n"
+                             "addi a1, a1, %pcrel_lo(1b) \n"    // auipc+addi
+                             "addi t0, zero, -5 \n"
+                             "slli a2, t0, 32 \n"
+                             "srli a2, a2, 32 \n"    // slli+srli
+                             "addi s0, zero, 3 \n"
+                             "loop: \n"
+                             "addi s0, s0, -1 \n"
+                             "slt t1, zero, s0 \n"
+                             "bnez t1, loop \n"    // slt+bnez
+                             "2: auipc ra, %pcrel_hi(f) \n"
+                             "jalr ra, %pcrel_lo(2b)(ra) \n"    // auipc+jalr call
+                             "jal zero, end \n"
+                             "f: \n"
+                             "addi a3, a3, 1 \n"
+                             "jalr zero, 0(ra) \n"
+                             "data: \n"
+                             "end: \n"
+                             "addi a4, zero, 1 \n";
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            CPU cpu = rvHelper(code, "test_fusion", 20, engine);
+
+            REQUIRE(cpu.getRegValueByName("a0") == 0xffff'ffff'8000'0fff);
+            REQUIRE(cpu.getRegValueByName("a1") == DRAM_BASE + 64);
+            REQUIRE(cpu.getRegValueByName("a2") == 0xffff'fffb);
+            REQUIRE(cpu.getRegValueByName("t1") == 0);
+            REQUIRE(cpu.getRegValueByName("s0") == 0);
+            REQUIRE(cpu.getRegValueByName("a3") == 1);
+            REQUIRE(cpu.getRegValueByName("ra") == DRAM_BASE + 52);
+            REQUIRE(cpu.getRegValueByName("a4") == 1);
+
+            const InstMix &mix = cpu.getInstMix();
+            for (InstKind kind : {InstKind::LuiAddi,
+                                  InstKind::AuipcAddi,
+                                  InstKind::ZextW,
+                                  InstKind::SltBnez,
+                                  InstKind::AuipcJalr})
+                REQUIRE(mix[static_cast<std::size_t>(kind)] > 0);
+            // Each pair ran once but slt+bnez, three times.
+            REQUIRE(cpu.getFusedRetired() == 7);
+        }
+    }
+
+    TEST_CASE("RVTests-tiered", "Test the tiered engine promotes hot blocks")
+    {
+        std::string code = start
+                           + "addi a0, zero, 0 \n"
+                             "addi a1, zero, 200 \n"
+                             "loop: \n"
+                             "addi a0, a0, 2 \n"
+                             "addi a1, a1, -1 \n"
+                             "bne a1, zero, loop \n";
+
+        // Compiling on the hart makes the promotions deterministic.
+        TierConfig sync;
+        sync.backgroundCompile = false;
+
+        CPU cpu = rvHelper(code, "test_tiered", 603, ExecEngine::Tiered, sync);
+        REQUIRE(cpu.getRegValueByName("a0") == 400);
+
+        const TierStats *stats = cpu.getTierStats();
+        REQUIRE(stats != nullptr);
+        REQUIRE(stats->interpretedInsts > 0);
+        REQUIRE(stats->translated > 0);
+        REQUIRE(stats->threadedRuns > 0);
+#if defined(__x86_64__)
+        REQUIRE(stats->compiled > 0);
+        REQUIRE(stats->nativeRuns > 0);
+#endif
+
+        CPU background = rvHelper(code, "test_tiered_background", 603, ExecEngine::Tiered);
+        REQUIRE(background.getRegValueByName("a0") == 400);
+        REQUIRE(background.getTierStats()->translated > 0);
+
+        // Nothing gets warm, the interpreter runs all, a fused lui+addi as two instructions.
+        TierConfig cold;
+        cold.warmThreshold = 1'000'000;
+        CPU interpreted    = rvHelper(code + "lui a2, 0x12345 \n addi a2, a2, 0x678 \n",
+                                   "test_tiered_cold",
+                                   605,
+                                   ExecEngine::Tiered,
+                                   cold);
+        REQUIRE(interpreted.getFusedRetired() == 1);
+        REQUIRE(interpreted.getTierStats()->translated == 0);
+        REQUIRE(interpreted.getTierStats()->interpretedInsts == interpreted.getRetired());
+    }
+
+    TEST_CASE("RVTests-run", "Test runs stop at their instruction budget or stop pc")
+    {
+        std::string code = start
+                           + "lui a3, 0x12345 \n"
+                             "addi a3, a3, 0x678 \n"    // lui+addi
+                             "addi a0, zero, 0 \n"
+                             "addi a1, zero, 200 \n"
+                             "loop: \n"
+                             "addi a0, a0, 1 \n"
+                             "addi a1, a1, -1 \n"
+                             "bne a1, zero, loop \n"
+                             "addi a2, zero, 7 \n";
+        const std::string binFile = buildRVBinary(code, "test_run");
+
+        TierConfig sync;
+        sync.warmThreshold     = 1;
+        sync.hotThreshold      = 1;
+        sync.backgroundCompile = false;
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            cpu.setTierConfig(sync);
+
+            // The budget ends between the two instructions of the fused pair.
+            REQUIRE(emulator.run(1) == StopReason::Budget);
+            REQUIRE(cpu.getRetired() == 1);
+            REQUIRE(cpu.getRegValueByName("a3") == 0x1234'5000);
+
+            REQUIRE(emulator.run(300) == StopReason::Budget);
+            REQUIRE(cpu.getRetired() == 301);
+            REQUIRE(cpu.getRegValueByName("a3") == 0x1234'5678);
+            REQUIRE(cpu.getRegValueByName("a0") == 99);
+            REQUIRE(cpu.getRegValueByName("a1") == 101);
+
+            REQUIRE(emulator.runUntil(DRAM_BASE + 28) == StopReason::StopPC);
+            REQUIRE(cpu.getRetired() == 604);
+            REQUIRE(cpu.getRegValueByName("a0") == 200);
+            REQUIRE(cpu.getRegValueByName("a2") == 0);
+
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            REQUIRE(cpu.getRetired() == 605);
+            REQUIRE(cpu.getRegValueByName("a2") == 7);
+        }
+    }
+
+    TEST_CASE("RVTests-trace", "Test the binary trace decodes to every executed instruction")
+    {
+        std::string code = start
+                           + "addi a0, zero, 42 \n"
+                             "auipc t0, 0x1 \n"
+                             "sd a0, 4(t0) \n"
+                             "ld a1, 4(t0) \n"
+                             "addi t1, t0, 4 \n"
+                             "addi a4, zero, 7 \n"
+                             "lr.d a2, (t1) \n"
+                             "sc.d a3, a4, (t1) \n"
+                             "sc.d a5, a4, (t1) \n"        // Fails, with no reservation.
+                             "amoadd.w a6, a4, (t1) \n"
+                             "amoadd.w zero, a4, (t1) \n"
+                             "lr.d zero, (t1) \n"
+                             "sc.d zero, a0, (t1) \n"
+                             "sc.d zero, a0, (t1) \n";     // Fails, memory holds a0 already.
+        const std::string binFile   = buildRVBinary(code, "test_trace");
+        const std::string traceFile = "test_trace.rvtrace";
+        {
+            // The writer flushes the trace when the emulator goes away.
+            Emulator emulator(binFile, ExecEngine::Jit);
+            emulator.traceTo(traceFile);
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+        }
+
+        std::ifstream in(traceFile, std::ios::binary);
+        std::ostringstream out;
+        REQUIRE(TraceDecoder::render(in, out));
+
+        const std::string text = out.str();
+        REQUIRE(std::count(text.begin(), text.end(), '\n') == 14);
+        REQUIRE(text.find("0x80000000: 02a00513 addi       a0=0x2a\n") != std::string::npos);
+        REQUIRE(text.find("sd         store.8 [0x80001008]=0x2a\n") != std::string::npos);
+        REQUIRE(text.find("ld         a1=0x2a load.8 [0x80001008]\n") != std::string::npos);
+        REQUIRE(text.find("lr.d       a2=0x2a load.8 [0x80001008]\n") != std::string::npos);
+        REQUIRE(text.find("sc.d       store.8 [0x80001008]=0x7\n") != std::string::npos);
+        REQUIRE(text.find("sc.d       a5=0x1\n") != std::string::npos);
+        REQUIRE(text.find("amoadd.w   a6=0x7 amo.4 [0x80001008]\n") != std::string::npos);
+        REQUIRE(text.find("amoadd.w   amo.4 [0x80001008]\n") != std::string::npos);
+        REQUIRE(text.find("lr.d       load.8 [0x80001008]\n") != std::string::npos);
+        REQUIRE(text.find("sc.d       store.8 [0x80001008]=0x2a\n") != std::string::npos);
+        REQUIRE(text.find("18a3302f sc.d\n") != std::string::npos);
+    }
+
+    TEST_CASE("RVTests-memory", "Test DRAM of a size given at run time")
+    {
+        std::string code = start
+                           + "addi a0, zero, 42 \n"
+                             "sd a0, -7(sp) \n"    // The last doubleword of DRAM.
+                             "ld a1, -7(sp) \n"
+                             "sd a0, 1(sp) \n";    // Past the end.
+        const std::string binFile = buildRVBinary(code, "test_memory");
+
+        constexpr std::size_t size = 1024 * 1024;
+        Emulator emulator(binFile, ExecEngine::Interpreter, RamConfig {.size = size});
+        CPU &cpu = emulator.getCPU();
+        REQUIRE(cpu.getDRAM().size() == size);
+        REQUIRE(cpu.getRegValueByName("sp") == DRAM_BASE + size - 1);
+        REQUIRE(cpu.getLoadStats().bytes == std::filesystem::file_size(binFile));
+        REQUIRE(cpu.readMemory<u32>(DRAM_BASE) == 0x02a0'0513);    // addi a0, zero, 42
+
+        REQUIRE(emulator.run() == StopReason::Exception);
+        REQUIRE(cpu.getRegValueByName("a1") == 42);
+        REQUIRE(cpu.getRetired() == 3);
+    }
+
+    TEST_CASE("RVTests-ram", "Test file and image backed DRAM")
+    {
+        std::string code = start
+                           + "auipc t0, 0x1 \n"    // The page after the program.
+                             "ld a0, 0(t0) \n"
+                             "addi a0, a0, 1 \n"
+                             "sd a0, 8(t0) \n";
+        const std::string binFile = buildRVBinary(code, "test_ram");
+
+        constexpr std::size_t size = 64 * 1024;
+        const std::string file     = "test_ram.mem";
+        std::filesystem::remove(file);
+        for (u64 expected : {1, 2})
+        {
+            // A file keeps the memory of the run, the next one starts from it.
+            Emulator emulator(binFile, ExecEngine::Interpreter, {RamKind::File, size, file});
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            REQUIRE(emulator.getCPU().getRegValueByName("a0") == expected);
+            REQUIRE(std::filesystem::file_size(file) == size);
+
+            u64 stored = 0;
+            std::ifstream in(file, std::ios::binary);
+            in.seekg(0x1008);
+            in.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+            REQUIRE(stored == expected);
+
+            std::ofstream(file, std::ios::binary | std::ios::in).seekp(0x1000)
+                .write(reinterpret_cast<const char *>(&expected), sizeof(expected));
+        }
+
+        // The image is where the file left off, and stays unchanged.
+        Emulator emulator(binFile, ExecEngine::Jit, {RamKind::Image, size, file});
+        REQUIRE(emulator.getCPU().getDRAM().describe() == std::string("image"));
+        REQUIRE(emulator.run() == StopReason::ProgramEnd);
+        REQUIRE(emulator.getCPU().getRegValueByName("a0") == 3);
+        REQUIRE(emulator.getCPU().readMemory<u64>(DRAM_BASE + 0x1008) == 3);
+
+        u64 stored = 0;
+        std::ifstream in(file, std::ios::binary);
+        in.seekg(0x1008);
+        in.read(reinterpret_cast<char *>(&stored), sizeof(stored));
+        REQUIRE(stored == 2);
+    }
+
+    TEST_CASE("RVTests-elf", "Test ELF executables start at their entry with their symbols")
+    {
+        std::string code = ".global _start \n"
+                           "helper: \n"
+                           "addi a0, a0, 1 \n"
+                           "ret \n"
+                           "_start: \n"
+                           "addi a0, zero, 41 \n"
+                           "jal ra, helper \n"
+                           "addi a1, a0, 0 \n";
+        const std::string elfFile = buildRVElf(code, "test_elf");
+
+        for (auto engine : {ExecEngine::Interpreter, ExecEngine::Jit, ExecEngine::Pipeline})
+        {
+            Emulator emulator(elfFile, engine);
+            CPU &cpu = emulator.getCPU();
+            REQUIRE(cpu.getPC() == DRAM_BASE + 8);
+            REQUIRE(cpu.getSymbols().find("helper") == DRAM_BASE);
+            REQUIRE(cpu.getSymbols().describe(DRAM_BASE + 4) == "0x80000004 <helper+0x4>");
+            REQUIRE(cpu.getSymbols().describe(DRAM_BASE + 12) == "0x8000000c <_start+0x4>");
+
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            REQUIRE(cpu.getRegValueByName("a1") == 42);
+            REQUIRE(cpu.getRetired() == 5);
+        }
+    }
+
+    TEST_CASE("RVTests-paging", "Test Sv39 translation through the TLBs")
+    {
+        // Machine mode maps DRAM with a gigapage and one 4 KiB page at 0x40000000 to the page
+        // after the code, then drops to supervisor mode, which runs translated.
+        std::string code = start
+                           + "auipc s0, 0 \n"
+                             "li t0, 0x1000 \n"
+                             "add s1, s0, t0 \n"    // The data page.
+                             "add s2, s1, t0 \n"    // The root page table.
+                             "add s3, s2, t0 \n"    // Level 1.
+                             "add s4, s3, t0 \n"    // Level 0.
+                             "srli t0, s3, 2 \n"
+                             "ori t0, t0, 0x1 \n"
+                             "sd t0, 8(s2) \n"      // 0x40000000: a table.
+                             "srli t0, s0, 2 \n"
+                             "ori t0, t0, 0xcf \n"
+                             "sd t0, 16(s2) \n"     // 0x80000000: DRAM, RWX, accessed, dirty.
+                             "srli t0, s4, 2 \n"
+                             "ori t0, t0, 0x1 \n"
+                             "sd t0, 0(s3) \n"
+                             "srli t0, s1, 2 \n"
+                             "ori t0, t0, 0x7 \n"
+                             "sd t0, 0(s4) \n"      // The data page, RW.
+                             "li t0, 42 \n"
+                             "sd t0, 0(s1) \n"
+                             "srli t0, s2, 12 \n"
+                             "li t1, 8 \n"
+                             "slli t1, t1, 60 \n"
+                             "or t0, t0, t1 \n"
+                             "csrw satp, t0 \n"
+                             "li t0, 0x800 \n"
+                             "csrw mstatus, t0 \n"    // MPP: supervisor.
+                             "auipc t0, 0 \n"
+                             "addi t0, t0, 16 \n"
+                             "csrw mepc, t0 \n"
+                             "mret \n"
+                             "lui a0, 0x40000 \n"
+                             "ld a1, 0(a0) \n"
+                             "addi a1, a1, 1 \n"
+                             "sd a1, 8(a0) \n"
+                             "sfence.vma \n"
+                             "ld a2, 8(a0) \n"
+                             "ld a3, 0(zero) \n";    // Unmapped.
+        const std::string binFile = buildRVBinary(code, "test_paging");
+
+        for (auto engine : {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            REQUIRE(emulator.run() == StopReason::Exception);
+            REQUIRE(cpu.getMode() == Supervisor);
+            REQUIRE(cpu.getRegValueByName("a1") == 43);
+            REQUIRE(cpu.getRegValueByName("a2") == 43);
+
+            // The sfence.vma dropped the pages used before it.
+            const TlbStats &tlb = cpu.getTlbStats();
+            REQUIRE(tlb.hits == std::array<u64, 3> {5, 0, 0});
+            REQUIRE(tlb.misses == std::array<u64, 3> {2, 3, 1});
+
+            // The walk marked the data page accessed and dirty.
+            REQUIRE((cpu.readMemory<u64>(DRAM_BASE + 0x4000) & 0xc0) == 0xc0);
+            REQUIRE(cpu.readMemory<u64>(DRAM_BASE + 0x1008) == 43);
+        }
+    }
+
+    namespace
+    {
+        /// Keeps the last value written, reads return it plus their offset.
+        class ScratchDevice : public Device
+        {
+          public:
+            u64 read(AddrType offset, u8) override { return value + offset; }
+
+            void write(AddrType, u8 size, u64 written) override
+            {
+                value     = written;
+                lastWidth = size;
+            }
+
+            const char *name() const override { return "scratch"; }
+
+            u64 value    = 0;
+            u8 lastWidth = 0;
+        };
+    }    // namespace
+
+    TEST_CASE("RVTests-mmio", "Test loads and stores outside of DRAM reach the mapped device")
+    {
+        std::string code = start
+                           + "lui t0, 0x40000 \n"
+                             "addi a0, zero, 7 \n"
+                             "sh a0, 0(t0) \n"
+                             "lw a1, 8(t0) \n"
+                             "sd a1, -15(sp) \n"      // DRAM.
+                             "ld a2, 0x100(t0) \n";    // Past the device.
+        const std::string binFile = buildRVBinary(code, "test_mmio");
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            auto device            = std::make_unique<ScratchDevice>();
+            ScratchDevice &scratch = *device;
+            cpu.mapDevice(0x4000'0000, 0x100, std::move(device));
+
+            REQUIRE(emulator.run() == StopReason::Exception);
+            REQUIRE(scratch.value == 7);
+            REQUIRE(scratch.lastWidth == HalfWord);
+            REQUIRE(cpu.getRegValueByName("a1") == 15);
+            REQUIRE(cpu.readMemory<u64>(*cpu.getRegValueByName("sp") - 15) == 15);
+        }
+    }
+
+    TEST_CASE("RVTests-clint", "Test the CLINT timer interrupts a spinning program")
+    {
+        // mtimecmp is 100 instructions away, the handler reads the cause and mtime.
+        std::string code = start
+                           + "auipc t0, 0 \n"
+                             "addi t0, t0, 44 \n"
+                             "csrw mtvec, t0 \n"
+                             "lui t1, 0x2004 \n"
+                             "li t0, 100 \n"
+                             "sd t0, 0(t1) \n"          // mtimecmp.
+                             "li t0, 0x80 \n"
+                             "csrw mie, t0 \n"          // MTIE.
+                             "csrsi mstatus, 0x8 \n"    // MIE.
+                             "spin: \n"
+                             "addi a3, a3, 1 \n"
+                             "j spin \n"
+                             "csrr a0, mcause \n"       // The handler.
+                             "lui t1, 0x200c \n"
+                             "ld a1, -8(t1) \n";        // mtime.
+        const std::string binFile = buildRVBinary(code, "test_clint");
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            emulator.run();
+            REQUIRE(cpu.getRegValueByName("a0") == (1ULL << 63 | 7));
+            REQUIRE(cpu.getRegValueByName("a3") == 46);
+            REQUIRE(cpu.getRegValueByName("a1") >= 100);
+            REQUIRE(cpu.getEvents().getFired() == 1);
+        }
+    }
+
+    TEST_CASE("RVTests-clint-mip", "Test csr writes to mip leave the timer line to the CLINT")
+    {
+        // The handler sets STIP with a csrs, which reads MTIP back raised, then moves
+        // mtimecmp away: the interrupt must not be taken again.
+        std::string code = start
+                           + "la t0, handler \n"
+                             "csrw mtvec, t0 \n"
+                             "lui t1, 0x2004 \n"
+                             "li t0, 100 \n"
+                             "sd t0, 0(t1) \n"          // mtimecmp.
+                             "li t0, 0x80 \n"
+                             "csrw mie, t0 \n"          // MTIE.
+                             "csrsi mstatus, 0x8 \n"    // MIE.
+                             "li s0, 300 \n"
+                             "loop: \n"
+                             "addi s0, s0, -1 \n"
+                             "bnez s0, loop \n"
+                             "csrr a1, mip \n"
+                             "j end \n"
+                             "handler: \n"
+                             "addi a0, a0, 1 \n"
+                             "li t0, 0x20 \n"
+                             "csrs mip, t0 \n"          // STIP.
+                             "li t0, -1 \n"
+                             "sd t0, 0(t1) \n"          // mtimecmp, never.
+                             "mret \n"
+                             "end: \n";
+        const std::string binFile = buildRVBinary(code, "test_clint_mip");
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            REQUIRE(emulator.run(10'000) == StopReason::ProgramEnd);
+            REQUIRE(cpu.getRegValueByName("a0") == 1);
+            REQUIRE(cpu.getRegValueByName("a1") == MASK_STIP);
+            REQUIRE(cpu.getRegValueByName("s0") == 0);
+        }
+    }
+
+    TEST_CASE("RVTests-wfi", "Test wfi skips the time to the next timer event")
+    {
+        // Interrupts stay masked by mstatus, the pending one only ends the wait.
+        std::string code = start
+                           + "lui t1, 0x2004 \n"
+                             "li t0, 1000 \n"
+                             "sd t0, 0(t1) \n"      // mtimecmp.
+                             "li t0, 0x80 \n"
+                             "csrw mie, t0 \n"      // MTIE.
+                             "wfi \n"
+                             "wfi \n"               // Already pending.
+                             "csrr a0, mip \n"
+                             "lui t1, 0x200c \n"
+                             "ld a1, -8(t1) \n";    // mtime.
+        const std::string binFile = buildRVBinary(code, "test_wfi");
+
+        for (auto engine : {ExecEngine::Interpreter,
+                            ExecEngine::Threaded,
+                            ExecEngine::Jit,
+                            ExecEngine::Tiered,
+                            ExecEngine::Pipeline})
+        {
+            Emulator emulator(binFile, engine);
+            CPU &cpu = emulator.getCPU();
+            emulator.run();
+            REQUIRE(cpu.getRegValueByName("a0") == 0x80);
+            REQUIRE(cpu.getRegValueByName("a1") >= 1000);
+            REQUIRE(cpu.getRetired() < 100);
+            REQUIRE(cpu.getEvents().getIdleTicks() > 900);
+        }
+    }
+
+    TEST_CASE("RVTests-uart", "Test the console UART sends in a batch and interrupts on input")
+    {
+        // The handler claims the interrupt from the PLIC and reads the byte received.
+        std::string code = start
+                           + "auipc t0, 0 \n"
+                             "addi t0, t0, 92 \n"
+                             "csrw mtvec, t0 \n"
+                             "lui t1, 0xc000 \n"
+                             "li t0, 1 \n"
+                             "sw t0, 40(t1) \n"     // Priority of source 10.
+                             "lui t2, 0xc002 \n"
+                             "li t0, 0x400 \n"
+                             "sw t0, 0(t2) \n"      // Enabled in machine mode.
+                             "lui s0, 0x10000 \n"
+                             "li t0, 'H' \n"
+                             "sb t0, 0(s0) \n"
+                             "li t0, 'i' \n"
+                             "sb t0, 0(s0) \n"
+                             "li t0, '\\n' \n"
+                             "sb t0, 0(s0) \n"
+                             "li t0, 0x800 \n"
+                             "csrw mie, t0 \n"      // MEIE.
+                             "csrsi mstatus, 0x8 \n"
+                             "li t0, 1 \n"
+                             "sb t0, 1(s0) \n"      // IER: received data.
+                             "spin: \n"
+                             "j spin \n"
+                             "lui t1, 0xc200 \n"    // The handler.
+                             "lw a0, 4(t1) \n"      // Claim.
+                             "lbu a1, 0(s0) \n"
+                             "lbu a2, 5(s0) \n";    // LSR.
+        const std::string binFile = buildRVBinary(code, "test_uart");
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            std::array<int, 2> input, output;
+            REQUIRE(pipe(input.data()) == 0);
+            REQUIRE(pipe(output.data()) == 0);
+            REQUIRE(write(input[1], "x", 1) == 1);
+            {
+                Emulator emulator(binFile, engine);
+                CPU &cpu = emulator.getCPU();
+                cpu.getUart().setInput(input[0]);
+                cpu.getUart().setOutput(output[1]);
+                emulator.run();
+                REQUIRE(cpu.getRegValueByName("a0") == UART_IRQ);
+                REQUIRE(cpu.getRegValueByName("a1") == 'x');
+                REQUIRE(cpu.getRegValueByName("a2") == 0x60);    // Nothing left to read.
+                REQUIRE(cpu.getUart().getBytesSent() == 3);
+                REQUIRE(cpu.getUart().getHostWrites() == 1);
+            }
+
+            std::array<char, 8> sent {};
+            REQUIRE(read(output[0], sent.data(), sent.size()) == 3);
+            REQUIRE(std::string_view(sent.data(), 3) == "Hi\n");
+            for (int fd : {input[0], input[1], output[0], output[1]})
+                close(fd);
+        }
+    }
+
+    TEST_CASE("RVTests-virtio-blk", "Test virtio-blk requests on an image with an overlay")
+    {
+        const std::string binFile = buildRVBinary(start + "addi a0, zero, 1 \n", "test_virtio");
+
+        // Four sectors of 'a', 'b', 'c' and 'd'.
+        const std::string image = "test_virtio.img", overlay = "test_virtio.overlay";
+        std::filesystem::remove(overlay);
+        {
+            std::ofstream out(image, std::ios::binary | std::ios::trunc);
+            for (char fill : {'a', 'b', 'c', 'd'})
+                out << std::string(DiskImage::SECTOR_SIZE, fill);
+        }
+
+        // The queue, the request headers and status bytes, then the data buffers.
+        constexpr AddrType queue = DRAM_BASE + 0x1'0000, avail = queue + 0x100;
+        constexpr AddrType used = queue + 0x200, headers = queue + 0x400;
+        constexpr AddrType status = queue + 0x500, buffers = queue + 0x1000;
+
+        auto setUp = [](CPU &cpu) {
+            auto reg = [&cpu](AddrType offset, u32 value) {
+                cpu.writeMemory<u32>(VIRTIO_BASE + offset, value);
+            };
+            REQUIRE(cpu.readMemory<u32>(VIRTIO_BASE) == 0x7472'6976);
+            REQUIRE(cpu.readMemory<u32>(VIRTIO_BASE + 0x8) == 2);
+            REQUIRE(cpu.readMemory<u64>(VIRTIO_BASE + 0x100) == 4);    // Capacity.
+            reg(0x70, 3);                                               // ACKNOWLEDGE, DRIVER.
+            reg(0x24, 1);
+            reg(0x20, 1);                                               // VIRTIO_F_VERSION_1.
+            reg(0x70, 11);                                              // FEATURES_OK.
+            REQUIRE(cpu.readMemory<u32>(VIRTIO_BASE + 0x70) == 11);
+            reg(0x38, 8);
+            reg(0x80, queue);
+            reg(0x90, avail);
+            reg(0xa0, used);
+            reg(0x44, 1);
+            reg(0x70, 15);                                              // DRIVER_OK.
+        };
+
+        // Makes request slot available: its header, the data and the status byte.
+        auto request = [](CPU &cpu, u16 slot, u32 type, u64 sector, AddrType data, u32 len) {
+            const AddrType header = headers + 16 * slot;
+            cpu.writeMemory<u32>(header, type);
+            cpu.writeMemory<u64>(header + 8, sector);
+            const u16 head = 3 * slot;
+            const std::array<std::tuple<AddrType, u32, u16>, 3> descs = {{
+                {header, 16, 1},
+                {data, len, type == 0 ? 3 : 1},    // Written by the device when reading.
+                {status + slot, 1, 2},
+            }};
+            for (u16 idx = 0; idx < 3; ++idx)
+            {
+                const AddrType desc             = queue + 16 * (head + idx);
+                const auto &[addr, size, flags] = descs[idx];
+                cpu.writeMemory<u64>(desc, addr);
+                cpu.writeMemory<u32>(desc + 8, size);
+                cpu.writeMemory<u16>(desc + 12, flags);
+                cpu.writeMemory<u16>(desc + 14, head + idx + 1);
+            }
+            cpu.writeMemory<u16>(avail + 4 + 2 * slot, head);
+            cpu.writeMemory<u16>(avail + 2, slot + 1);
+        };
+
+        {
+            Emulator emulator(binFile, ExecEngine::Interpreter);
+            CPU &cpu = emulator.getCPU();
+            cpu.attachDisk({image, overlay});
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            setUp(cpu);
+
+            // Writes 'z' over sector 1, then reads it back.
+            for (u32 idx = 0; idx < DiskImage::SECTOR_SIZE; ++idx)
+                cpu.writeMemory<u8>(buffers + idx, 'z');
+            request(cpu, 0, 1, 1, buffers, DiskImage::SECTOR_SIZE);
+            request(cpu, 1, 0, 1, buffers + 0x1000, DiskImage::SECTOR_SIZE);
+            cpu.writeMemory<u32>(VIRTIO_BASE + 0x50, 0);
+            cpu.getDisk()->drain();
+
+            REQUIRE(cpu.readMemory<u16>(used + 2) == 2);
+            REQUIRE(cpu.readMemory<u32>(used + 4) == 0);
+            REQUIRE(cpu.readMemory<u32>(used + 8) == 1);
+            REQUIRE(cpu.readMemory<u32>(used + 12) == 3);
+            REQUIRE(cpu.readMemory<u32>(used + 16) == DiskImage::SECTOR_SIZE + 1);
+            REQUIRE(cpu.readMemory<u16>(status) == 0);
+            REQUIRE(cpu.readMemory<u64>(buffers + 0x1000 + 504) == 0x7a7a'7a7a'7a7a'7a7a);
+            REQUIRE(cpu.readMemory<u32>(VIRTIO_BASE + 0x60) == 1);
+            REQUIRE((cpu.getCSRs().read(MIP) & MASK_MEIP) == 0);    // Source 1 is disabled.
+
+            const BlockStats stats = cpu.getDisk()->getStats();
+            REQUIRE(stats.reads == 1);
+            REQUIRE(stats.writes == 1);
+            REQUIRE(stats.bytesRead == DiskImage::SECTOR_SIZE);
+            REQUIRE(stats.bytesWritten == DiskImage::SECTOR_SIZE);
+            REQUIRE(stats.errors == 0);
+        }
+
+        // The image is unchanged, the overlay keeps the write for the next run.
+        std::string sector(DiskImage::SECTOR_SIZE, 0);
+        std::ifstream(image, std::ios::binary)
+            .seekg(DiskImage::SECTOR_SIZE)
+            .read(sector.data(), sector.size());
+        REQUIRE(sector == std::string(DiskImage::SECTOR_SIZE, 'b'));
+
+        Emulator emulator(binFile, ExecEngine::Interpreter);
+        CPU &cpu = emulator.getCPU();
+        cpu.attachDisk({image, overlay});
+        setUp(cpu);
+        request(cpu, 0, 0, 1, buffers, 2 * DiskImage::SECTOR_SIZE);
+        cpu.writeMemory<u32>(VIRTIO_BASE + 0x50, 0);
+        cpu.getDisk()->drain();
+        REQUIRE(cpu.readMemory<u8>(status) == 0);
+        REQUIRE(cpu.readMemory<u8>(buffers + DiskImage::SECTOR_SIZE - 1) == 'z');
+        REQUIRE(cpu.readMemory<u8>(buffers + DiskImage::SECTOR_SIZE) == 'c');
+        REQUIRE(cpu.getDisk()->getDisk().describe() == std::string("image with an overlay"));
+
+        // Past the end of the disk.
+        request(cpu, 1, 0, 4, buffers, DiskImage::SECTOR_SIZE);
+        cpu.writeMemory<u32>(VIRTIO_BASE + 0x50, 0);
+        cpu.getDisk()->drain();
+        REQUIRE(cpu.readMemory<u8>(status + 1) == 1);
+        REQUIRE(cpu.getDisk()->getStats().errors == 1);
+
+        // The guest notifies and waits: the request completes on the I/O thread, whose
+        // interrupt ends the wfi.
+        const std::string code = "li t0, 0x800 \n"
+                                 "csrw mie, t0 \n"         // MEIE, with mstatus.MIE clear.
+                                 "lui t1, 0x10001 \n"
+                                 "sw zero, 0x50(t1) \n"    // QueueNotify.
+                                 "wfi \n"
+                                 "csrr a0, mip \n"
+                                 "lw a1, 0x60(t1) \n";    // InterruptStatus.
+        const std::string waitFile = buildRVBinary(code, "test_virtio_wait");
+        for (auto engine : {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit})
+        {
+            Emulator waiting(waitFile, engine);
+            CPU &hart = waiting.getCPU();
+            hart.attachDisk({image, overlay});
+            setUp(hart);
+            hart.writeMemory<u32>(PLIC_BASE + 4, 1);         // Priority of source 1.
+            hart.writeMemory<u32>(PLIC_BASE + 0x2000, 2);    // Enabled for the machine context.
+            request(hart, 0, 0, 2, buffers, DiskImage::SECTOR_SIZE);
+            REQUIRE(waiting.run() == StopReason::ProgramEnd);
+            REQUIRE((*hart.getRegValueByName("a0") & MASK_MEIP) != 0);
+            REQUIRE(hart.getRegValueByName("a1") == 1);
+            REQUIRE(hart.readMemory<u8>(status) == 0);
+            REQUIRE(hart.readMemory<u8>(buffers) == 'c');
+        }
+    }
+
+    TEST_CASE("RVTests-harts", "Test harts sharing DRAM and waking each other through msip")
+    {
+        // Hart 0 sends an IPI to the others, which each store their id in a slot of a table
+        // hart 0 waits on and sums.
+        const std::string code = "csrr a0, mhartid \n"
+                                 "lui t1, 0x2000 \n"       // CLINT.
+                                 "li s0, 0x80010000 \n"    // The table.
+                                 "bnez a0, secondary \n"
+                                 "li t0, 1 \n"
+                                 "sw t0, 4(t1) \n"
+                                 "sw t0, 8(t1) \n"
+                                 "sw t0, 12(t1) \n"
+                                 "li a1, 0 \n"
+                                 "li t3, 1 \n"
+                                 "li t4, 4 \n"
+                                 "collect: \n"
+                                 "slli t2, t3, 2 \n"
+                                 "add t2, t2, s0 \n"
+                                 "wait: \n"
+                                 "lw t5, 0(t2) \n"
+                                 "beqz t5, wait \n"
+                                 "add a1, a1, t5 \n"
+                                 "addi t3, t3, 1 \n"
+                                 "bne t3, t4, collect \n"
+                                 "j end \n"
+                                 "secondary: \n"
+                                 "li t0, 8 \n"
+                                 "csrw mie, t0 \n"         // MSIE, with mstatus.MIE clear.
+                                 "sleep: \n"
+                                 "wfi \n"
+                                 "csrr t0, mip \n"
+                                 "andi t0, t0, 8 \n"
+                                 "beqz t0, sleep \n"
+                                 "slli t2, a0, 2 \n"
+                                 "add t5, t2, t1 \n"
+                                 "sw zero, 0(t5) \n"       // Its own msip.
+                                 "lw a2, 0(t5) \n"
+                                 "add t5, t2, s0 \n"
+                                 "sw a0, 0(t5) \n"
+                                 "end: \n";
+        const std::string binFile = buildRVBinary(code, "test_harts");
+
+        for (auto engine :
+             {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit, ExecEngine::Tiered})
+        {
+            Emulator emulator(binFile, engine, {}, 4);
+            REQUIRE(emulator.getHartCount() == 4);
+            REQUIRE(emulator.getCPU().getEvents().getMode() == TimeMode::Host);
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            REQUIRE(emulator.getCPU().getRegValueByName("a1") == 1 + 2 + 3);
+            for (u32 hart = 1; hart < 4; ++hart)
+            {
+                CPU &cpu = emulator.getCPU(hart);
+                REQUIRE(cpu.getRegValueByName("mhartid") == hart);
+                REQUIRE(cpu.getRegValueByName("sp")
+                        == *emulator.getCPU().getRegValueByName("sp") - hart * HART_STACK_SIZE);
+                REQUIRE(cpu.getRegValueByName("a2") == 0);
+                REQUIRE((cpu.getCSRs().read(MIP) & MASK_MSIP) == 0);
+            }
+        }
+
+        // A hart waiting for an interrupt that never comes is stopped, wherever it is by then.
+        const std::string parkFile = buildRVBinary("csrr a0, mhartid \n"
+                                                   "beqz a0, end \n"
+                                                   "park: \n"
+                                                   "wfi \n"
+                                                   "j park \n"
+                                                   "end: \n",
+                                                   "test_harts_park");
+        Emulator emulator(parkFile, ExecEngine::Interpreter, {}, 2);
+        emulator.start();
+        emulator.stop();
+        const std::vector<StopReason> reasons = emulator.join();
+        REQUIRE(reasons.size() == 2);
+        REQUIRE(reasons[1] == StopReason::Stopped);
+        REQUIRE(emulator.getCPU(1).getPC() < emulator.getCPU(1).getLastInstAddr());
+
+        // The stop is not kept: hart 0 ends the program again.
+        REQUIRE(emulator.getCPU().run() == StopReason::ProgramEnd);
+    }
+
+    TEST_CASE("RVTests-atomics", "Test lr/sc and the AMOs, alone and on harts racing")
+    {
+        SECTION("AMOs return the old value and store the result")
+        {
+            const std::string code = "li s0, 0x80010000 \n"
+                                     "addi s1, s0, 8 \n"
+                                     "li t0, -5 \n"
+                                     "li t1, 3 \n"
+                                     "sw t0, 0(s0) \n"
+                                     "amoadd.w a0, t1, (s0) \n"
+                                     "amomin.w a1, t1, (s0) \n"     // Signed: keeps -2.
+                                     "amominu.w a2, t1, (s0) \n"    // Unsigned: 3.
+                                     "amomax.w a3, t0, (s0) \n"
+                                     "amomaxu.w.aqrl a4, t0, (s0) \n"
+                                     "lw a5, 0(s0) \n"
+                                     "li t2, 0xf0f \n"
+                                     "li t3, 0xff \n"
+                                     "sd t2, 0(s1) \n"
+                                     "amoand.d s2, t3, (s1) \n"
+                                     "amoor.d.aq s3, t2, (s1) \n"
+                                     "amoxor.d.rl s4, t3, (s1) \n"
+                                     "amoswap.d s5, t0, (s1) \n"
+                                     "ld s6, 0(s1) \n";
+            Emulator emulator(buildRVBinary(code, "test_amo"), ExecEngine::Interpreter);
+            REQUIRE(emulator.run() == StopReason::ProgramEnd);
+            CPU &cpu = emulator.getCPU();
+
+            REQUIRE(cpu.getRegValueByName("a0") == static_cast<u64>(-5));
+            REQUIRE(cpu.getRegValueByName("a1") == static_cast<u64>(-2));
+            REQUIRE(cpu.getRegValueByName("a2") == static_cast<u64>(-2));
+            REQUIRE(cpu.getRegValueByName("a3") == 3);
+            REQUIRE(cpu.getRegValueByName("a4") == 3);
+            REQUIRE(cpu.getRegValueByName("a5") == static_cast<u64>(-5));
+            REQUIRE(cpu.getRegValueByName("s2") == 0xf0f);
+            REQUIRE(cpu.getRegValueByName("s3") == 0xf);
+            REQUIRE(cpu.getRegValueByName("s4") == 0xf0f);
+            REQUIRE(cpu.getRegValueByName("s5") == 0xff0);
+            REQUIRE(cpu.getRegValueByName("s6") == static_cast<u64>(-5));
+        }
+
+        SECTION("sc only stores to what lr reserved, if it still holds the value loaded")
+        {
+            const std::string code = "li s0, 0x80010000 \n"
+                                     "li t0, 7 \n"
+                                     "sd t0, 0(s0) \n"
+                                     "lr.d t1, (s0) \n"
+                                     "addi t1, t1, 1 \n"
+                                     "sc.d a0, t1, (s0) \n"    // Stores 8.
+                                     "sc.d a1, t1, (s0) \n"    // No reservation left.
+                                     "lr.w t2, (s0) \n"
+                                     "sw zero, 0(s0) \n"
+                                     "sc.w a2, t2, (s0) \n"    // The value changed.
+                                     "lr.w t2, (s0) \n"
+                                     "addi s1, s0, 4 \n"
+                                     "sc.w a3, t2, (s1) \n"    // Not the reserved word.
+                                     "ld a4, 0(s0) \n";
+            const std::string binFile = buildRVBinary(code, "test_lrsc");
+            for (auto engine : {ExecEngine::Interpreter, ExecEngine::Threaded, ExecEngine::Jit})
+            {
+                Emulator emulator(binFile, engine);
+                REQUIRE(emulator.run() == StopReason::ProgramEnd);
+                CPU &cpu = emulator.getCPU();
+
+                REQUIRE(cpu.getRegValueByName("t1") == 8);
+                REQUIRE(cpu.getRegValueByName("a0") == 0);
+                REQUIRE(cpu.getRegValueByName("a1") == 1);
+                REQUIRE(cpu.getRegValueByName("a2") == 1);
+                REQUIRE(cpu.getRegValueByName("a3") == 1);
+                REQUIRE(cpu.getRegValueByName("a4") == 0);
+            }
+        }
+
+        SECTION("A misaligned AMO raises an exception")
+        {
+            const std::string code = "li s0, 0x80010002 \n"
+                                     "amoadd.w a0, zero, (s0) \n";
+            Emulator emulator(buildRVBinary(code, "test_amo_misaligned"), ExecEngine::Interpreter);
+            REQUIRE(emulator.run() == StopReason::Exception);
+        }
+
+        SECTION("Harts racing on counters lose no update")
+        {
+            // Every hart adds 1000 to a counter with amoadd and to another one through lr/sc,
+            // then checks in; hart 0 waits for all of them and reads the counters.
+            const std::string code = "li s0, 0x80010000 \n"
+                                     "addi s1, s0, 8 \n"
+                                     "addi s2, s0, 16 \n"
+                                     "li t0, 1000 \n"
+                                     "li t1, 1 \n"
+                                     "loop: \n"
+                                     "amoadd.w zero, t1, (s0) \n"
+                                     "retry: \n"
+                                     "lr.d.aq t2, (s1) \n"
+                                     "addi t2, t2, 1 \n"
+                                     "sc.d.rl t3, t2, (s1) \n"
+                                     "bnez t3, retry \n"
+                                     "addi t0, t0, -1 \n"
+                                     "bnez t0, loop \n"
+                                     "amoadd.w.aqrl zero, t1, (s2) \n"
+                                     "csrr a0, mhartid \n"
+                                     "bnez a0, end \n"
+                                     "li t4, 4 \n"
+                                     "wait: \n"
+                                     "lw t5, 0(s2) \n"
+                                     "bne t5, t4, wait \n"
+                                     "fence \n"
+                                     "lw a1, 0(s0) \n"
+                                     "ld a2, 0(s1) \n"
+                                     "end: \n";
+            const std::string binFile = buildRVBinary(code, "test_amo_harts");
+
+            for (auto engine : {ExecEngine::Interpreter,
+                                ExecEngine::Threaded,
+                                ExecEngine::Jit,
+                                ExecEngine::Tiered})
+            {
+                Emulator emulator(binFile, engine, {}, 4);
+                REQUIRE(emulator.run() == StopReason::ProgramEnd);
+                REQUIRE(emulator.getCPU().getRegValueByName("a1") == 4000);
+                REQUIRE(emulator.getCPU().getRegValueByName("a2") == 4000);
+            }
+        }
+    }
 }    // namespace rvemu
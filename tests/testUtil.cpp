@@ -8,6 +8,7 @@
 #include <fmt/ostream.h>
 #include <fstream>
 #include <stdexcept>
+#include <utility>
 
 namespace rvemu
 {
@@ -20,15 +21,16 @@ namespace rvemu
             throw std::runtime_error("Failed to generate RV assembly. Command: " + command);
     }
 
-    void generateRVObj(const std::string &assembly)
+    void generateRVObj(const std::string &assembly, AddrType textAddr)
     {
         std::size_t dotPos = assembly.find_last_of(".");
         std::string baseName =
             (dotPos == std::string::npos) ? assembly : assembly.substr(0, dotPos);
 
         std::string command = "clang "
-                              "-Wl,-Ttext=0x0 "
-                              "-nostdlib "
+                              "-Wl,-Ttext="
+                              + fmt::format("{:#x} ", textAddr)
+                              + "-nostdlib "
                               "--target=riscv64 "
                               "-march=rv64g "
                               "-mno-relax"
@@ -49,7 +51,7 @@ namespace rvemu
             fmt::print(std::cerr, "Failed to generate RV binary from object {}\n", obj);
     }
 
-    const CPU &rvHelper(const std::string &code, const std::string &testname, std::size_t nClock)
+    std::string buildRVBinary(const std::string &code, const std::string &testname)
     {
         std::string filename = testname + ".s";
         std::ofstream file(filename);
@@ -62,11 +64,35 @@ namespace rvemu
         generateRVObj(filename.c_str());
         generateRVBinary(testname.c_str());
 
-        std::string binFile = testname + ".bin";
-        rvemu::Emulator rvEmulator(binFile);
+        return testname + ".bin";
+    }
+
+    std::string buildRVElf(const std::string &code, const std::string &testname)
+    {
+        std::string filename = testname + ".s";
+        std::ofstream file(filename);
+        if (!file.is_open())
+            LOG(ERROR, "Failed to create assembly file.");
+
+        file << code;
+        file.close();
+
+        generateRVObj(filename, DRAM_BASE);
+        return testname;
+    }
+
+    const CPU rvHelper(const std::string &code,
+                       const std::string &testname,
+                       std::size_t nClock,
+                       ExecEngine engine,
+                       const TierConfig &tiers)
+    {
+        std::string binFile = buildRVBinary(code, testname);
+        rvemu::Emulator rvEmulator(binFile, engine);
+        rvEmulator.getCPU().setTierConfig(tiers);
         rvEmulator.runEmulator();
         fmt::print(fg(colors[DEBUG]), "{:=^100}\n", "Debug");
 
-        return rvEmulator.getCPU();
+        return std::move(rvEmulator.getCPU());
     }
 }    // namespace rvemu
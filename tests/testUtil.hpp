@@ -9,8 +9,17 @@ namespace rvemu
     const std::string start = ".global _start \n _start: \n";
 
     void generateRVAssembly(const std::string &csrc);
-    void generateRVObj(const std::string &assembly);
+    // Assembles and links the code with its text at textAddr.
+    void generateRVObj(const std::string &assembly, AddrType textAddr = 0);
     void generateRVBinary(const std::string &obj);
-    const CPU &rvHelper(const std::string &code, const std::string &testname, std::size_t nclock);
+    // Assembles the code into a flat binary and returns its path.
+    std::string buildRVBinary(const std::string &code, const std::string &testname);
+    // Assembles the code into an ELF executable linked at DRAM_BASE and returns its path.
+    std::string buildRVElf(const std::string &code, const std::string &testname);
+    const CPU rvHelper(const std::string &code,
+                       const std::string &testname,
+                       std::size_t nclock,
+                       ExecEngine engine       = ExecEngine::Interpreter,
+                       const TierConfig &tiers = {});
 
 }    // namespace rvemu
@@ -0,0 +1,41 @@
+#include "../src/ElfLoader.hpp"
+#include "../src/trace/TraceDecoder.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Prints a binary trace written with --trace-file as text, naming the pcs after the symbols
+// of the traced ELF program if given.
+int main(int argc, char **argv)
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " trace_file [elf_file]\n";
+        return EXIT_FAILURE;
+    }
+
+    rvemu::SymbolTable symbols;
+    if (argc == 3)
+    {
+        std::ifstream elf(argv[2], std::ios::binary);
+        const std::vector<char> bytes {std::istreambuf_iterator<char>(elf), {}};
+        symbols = rvemu::ElfLoader::readSymbols(std::as_bytes(std::span(bytes)));
+    }
+
+    std::ifstream trace(argv[1], std::ios::binary);
+    if (!trace.is_open())
+    {
+        std::cerr << "Error: cannot open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!rvemu::TraceDecoder::render(trace, std::cout, argc == 3 ? &symbols : nullptr))
+    {
+        std::cerr << "Error: " << argv[1] << " is not a complete trace" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}